@@ -0,0 +1,56 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== This sample times the SDK's performance sensitive helpers against the stock
+//== implementations.  No cameras are needed, all input is synthetic.
+//=================================================================================-----
+
+#include <stdio.h>
+#include <string.h>
+
+#include "benchmarks.h"
+
+struct sBenchmark
+{
+    const char *Name;
+    void      (*Run)();
+};
+
+static const sBenchmark gBenchmarks[] =
+{
+    { "serializer", SerializerBenchmark },
+    { "rasterize",  RasterizeBenchmark },
+    { "segments",   SegmentBenchmark },
+    { "overlay",    OverlayBenchmark },
+    { "unpack",     UnpackBenchmark },
+};
+
+static const int gBenchmarkCount = sizeof( gBenchmarks ) / sizeof( gBenchmarks[0] );
+
+int main(int argc, char* argv[])
+{
+    printf("==============================================================================\n");
+    printf("== Camera Library Benchmarks                         NaturalPoint OptiTrack ==\n");
+    printf("==============================================================================\n\n");
+
+    //== Run everything, or only the benchmarks named on the command line ==--
+
+    for(int i=0; i<gBenchmarkCount; i++)
+    {
+        bool selected = (argc<2);
+
+        for(int j=1; j<argc; j++)
+            if(strcmp(argv[j], gBenchmarks[i].Name)==0)
+                selected = true;
+
+        if(!selected)
+            continue;
+
+        printf("%s:\n", gBenchmarks[i].Name);
+        gBenchmarks[i].Run();
+        printf("\n");
+    }
+
+    return 0;
+}
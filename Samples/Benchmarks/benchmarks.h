@@ -0,0 +1,50 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== Shared timing helpers for the benchmark sample.
+//==
+//== The benchmarks need C++11 (Visual Studio 2013 or later), so they build from their own
+//== Benchmarks.sln rather than the Visual Studio 2008 CameraSDKSamples.sln.
+//=================================================================================-----
+
+#ifndef __BENCHMARKS_H__
+#define __BENCHMARKS_H__
+
+#include <stdio.h>
+#include <chrono>
+
+//== Simple wall clock stopwatch ==--
+
+class cStopwatch
+{
+public:
+    cStopwatch() { Restart(); }
+
+    void   Restart() { mStart = std::chrono::steady_clock::now(); }
+    double Milliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - mStart ).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point mStart;
+};
+
+inline void ReportResult( const char *Name, double Milliseconds, double Baseline = 0 )
+{
+    if( Baseline > 0 )
+        printf( "  %-44s %10.2f ms  (%5.2fx)\n", Name, Milliseconds, Baseline / Milliseconds );
+    else
+        printf( "  %-44s %10.2f ms\n", Name, Milliseconds );
+}
+
+//== Benchmarks ==--
+
+void SerializerBenchmark();
+void RasterizeBenchmark();
+void SegmentBenchmark();
+void OverlayBenchmark();
+void UnpackBenchmark();
+
+#endif
@@ -0,0 +1,84 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== Draws 4000 marker overlays (a filled circle inside a ring) on a 1280x1024
+//== 32 bit bitmap, immediately with the Bitmap primitives and batched through
+//== cOverlayBuffer, both opaque and half transparent.
+//=================================================================================-----
+
+#include <vector>
+
+#include "benchmarks.h"
+#include "cameralibrary.h"
+#include "overlaybuffer.h"
+
+using namespace CameraLibrary;
+
+namespace
+{
+    const int kWidth       = 1280;
+    const int kHeight      = 1024;
+    const int kMarkerCount = 4000;
+    const int kRepeatCount = 20;
+
+    struct sMarker
+    {
+        int X;
+        int Y;
+    };
+}
+
+void OverlayBenchmark()
+{
+    std::vector<sMarker> markers( kMarkerCount );
+
+    unsigned int seed = 1;
+    for( size_t i = 0; i < markers.size(); i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        markers[i].X = (int) ( ( seed >> 8 ) % kWidth );
+        markers[i].Y = (int) ( ( seed >> 4 ) % kHeight );
+    }
+
+    std::vector<unsigned char> bits( kWidth * 4 * kHeight );
+    Bitmap bitmap( kWidth, kHeight, kWidth * 4, Bitmap::ThirtyTwoBit, &bits[0] );
+
+    const PIXEL fill = PIXELCOLOR(0,255,0);
+    const PIXEL ring = PIXELCOLOR(255,0,0);
+
+    printf( "  %d markers on %dx%d, average of %d runs\n", kMarkerCount, kWidth, kHeight, kRepeatCount );
+
+    cStopwatch timer;
+    for( int i = 0; i < kRepeatCount; i++ )
+    {
+        for( size_t j = 0; j < markers.size(); j++ )
+        {
+            bitmap.FillCircle( markers[j].X, markers[j].Y, 4, fill );
+            bitmap.Circle( markers[j].X, markers[j].Y, 7, ring );
+        }
+    }
+    double immediate = timer.Milliseconds() / kRepeatCount;
+    ReportResult( "Bitmap::FillCircle + Circle", immediate );
+
+    cOverlayBuffer overlay;
+
+    for( int alpha = 255; alpha >= 128; alpha -= 127 )
+    {
+        timer.Restart();
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            overlay.Clear();
+            for( size_t j = 0; j < markers.size(); j++ )
+            {
+                overlay.FillCircle( markers[j].X, markers[j].Y, 4, fill, alpha );
+                overlay.Circle( markers[j].X, markers[j].Y, 7, ring );
+            }
+            overlay.Render( &bitmap );
+        }
+
+        char name[64];
+        sprintf( name, "cOverlayBuffer, fill alpha %d", alpha );
+        ReportResult( name, timer.Milliseconds() / kRepeatCount, immediate );
+    }
+}
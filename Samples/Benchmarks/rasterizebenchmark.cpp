@@ -0,0 +1,111 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== Expands a 2048x2048 grayscale image into 32, 16 and 8 bit buffers with padded
+//== spans, comparing the scalar row kernels with every SIMD level this CPU runs,
+//== then reduces it to thumbnails with the box filter of Core::cBoxDownsample.
+//=================================================================================-----
+
+#include <vector>
+#include <string.h>
+
+#include "benchmarks.h"
+#include "Core/GrayscaleExpand.h"
+#include "Core/BoxDownsample.h"
+
+namespace
+{
+    const int kWidth       = 2048;
+    const int kHeight      = 2048;
+    const int kRepeatCount = 50;
+
+    double TimeExpand( const std::vector<unsigned char> &Image, std::vector<unsigned char> &Target, int Span,
+                       int BitsPerPixel, Core::eSIMDLevel Level )
+    {
+        cStopwatch timer;
+
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            Core::cGrayscaleExpand::Expand( &Image[0], kWidth, kWidth, kHeight, &Target[0], Span, BitsPerPixel, Level );
+        }
+
+        return timer.Milliseconds() / kRepeatCount;
+    }
+}
+
+void RasterizeBenchmark()
+{
+    std::vector<unsigned char> image( kWidth * kHeight );
+
+    unsigned int seed = 1;
+    for( size_t i = 0; i < image.size(); i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (unsigned char) ( seed >> 24 );
+    }
+
+    const Core::eSIMDLevel levels[] = { Core::SIMDNEON, Core::SIMDSSE2, Core::SIMDAVX2 };
+    const int depths[] = { 32, 16, 8 };
+
+    printf( "  %dx%d grayscale, average of %d runs, best level %s\n", kWidth, kHeight, kRepeatCount,
+        Core::SIMDLevelName( Core::BestSIMDLevel() ) );
+
+    for( int d = 0; d < 3; d++ )
+    {
+        const int bytes = depths[d] / 8;
+        const int span  = kWidth * bytes + 64;      //== padded rows, as in a texture buffer ==--
+
+        std::vector<unsigned char> reference( span * kHeight );
+        std::vector<unsigned char> target( span * kHeight );
+
+        char name[64];
+        sprintf( name, "%2d bit scalar", depths[d] );
+        double scalar = TimeExpand( image, reference, span, depths[d], Core::SIMDScalar );
+        ReportResult( name, scalar );
+
+        for( int l = 0; l < 3; l++ )
+        {
+            if( depths[d] == 8 || !Core::IsSIMDLevelSupported( levels[l] ) )
+            {
+                continue;
+            }
+
+            double simd = TimeExpand( image, target, span, depths[d], levels[l] );
+
+            bool match = true;
+            for( int y = 0; y < kHeight && match; y++ )
+            {
+                match = memcmp( &reference[y * span], &target[y * span], kWidth * bytes ) == 0;
+            }
+
+            sprintf( name, "%2d bit %s%s", depths[d], Core::SIMDLevelName( levels[l] ), match ? "" : " (MISMATCH)" );
+            ReportResult( name, simd, scalar );
+        }
+    }
+
+    //== thumbnails: cost should follow the output size, not the full size expand ==--
+
+    std::vector<unsigned char> full( kWidth * 4 * kHeight );
+    double fullSize = TimeExpand( image, full, kWidth * 4, 32, Core::BestSIMDLevel() );
+
+    const int factors[] = { 2, 4, 8, 16 };
+
+    for( int f = 0; f < 4; f++ )
+    {
+        const int width  = kWidth  / factors[f];
+        const int height = kHeight / factors[f];
+
+        std::vector<unsigned char> thumbnail( width * 4 * height );
+
+        cStopwatch timer;
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            Core::cBoxDownsample::Downsample( &image[0], kWidth, width, height, factors[f], &thumbnail[0], width * 4, 32 );
+        }
+
+        char name[64];
+        sprintf( name, "32 bit 1/%d box filter (%dx%d)", factors[f], width, height );
+        ReportResult( name, timer.Milliseconds() / kRepeatCount, fullSize );
+    }
+}
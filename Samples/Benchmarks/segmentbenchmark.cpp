@@ -0,0 +1,104 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== Draws a full frame of segments (kMaxSegmentsPerFrame runs) into a 1280x1024
+//== bitmap at each color depth, comparing Bitmap::HorizontalLine and Bitmap::Clear
+//== with the span fills of cFrameRasterizer.
+//=================================================================================-----
+
+#include <vector>
+#include <string.h>
+
+#include "benchmarks.h"
+#include "cameralibrary.h"
+#include "framerasterizer.h"
+
+using namespace CameraLibrary;
+
+namespace
+{
+    const int kWidth       = 1280;
+    const int kHeight      = 1024;
+    const int kRepeatCount = 200;
+
+    struct sRun
+    {
+        int StartX;
+        int StartY;
+        int Length;
+    };
+}
+
+void SegmentBenchmark()
+{
+    std::vector<sRun> runs( kMaxSegmentsPerFrame );
+
+    unsigned int seed = 1;
+    for( size_t i = 0; i < runs.size(); i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        runs[i].StartX = (int) ( ( seed >> 8 ) % ( kWidth - 24 ) );
+        runs[i].StartY = (int) ( ( seed >> 4 ) % kHeight );
+        runs[i].Length = 3 + (int) ( ( seed >> 20 ) % 20 );
+    }
+
+    const Bitmap::ColorDepth depths[] = { Bitmap::ThirtyTwoBit, Bitmap::TwentyFourBit, Bitmap::SixteenBit, Bitmap::EightBit };
+    const PIXEL color = PIXELCOLOR(255,255,255);
+
+    printf( "  %d segments on %dx%d, average of %d runs, best level %s\n", kMaxSegmentsPerFrame, kWidth, kHeight,
+        kRepeatCount, Core::SIMDLevelName( Core::BestSIMDLevel() ) );
+
+    for( int d = 0; d < 4; d++ )
+    {
+        const int span = kWidth * ( depths[d] / 8 );
+
+        std::vector<unsigned char> reference( span * kHeight );
+        std::vector<unsigned char> target( span * kHeight );
+
+        Bitmap referenceBitmap( kWidth, kHeight, span, depths[d], &reference[0] );
+        Bitmap targetBitmap( kWidth, kHeight, span, depths[d], &target[0] );
+
+        char name[64];
+
+        cStopwatch timer;
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            referenceBitmap.Clear();
+        }
+        double clear = timer.Milliseconds() / kRepeatCount;
+        sprintf( name, "%2d bit Bitmap::Clear", (int) depths[d] );
+        ReportResult( name, clear );
+
+        timer.Restart();
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            cFrameRasterizer::Clear( &targetBitmap );
+        }
+        sprintf( name, "%2d bit cFrameRasterizer::Clear", (int) depths[d] );
+        ReportResult( name, timer.Milliseconds() / kRepeatCount, clear );
+
+        timer.Restart();
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            for( size_t j = 0; j < runs.size(); j++ )
+            {
+                referenceBitmap.HorizontalLine( runs[j].StartX, runs[j].StartY, runs[j].StartX + runs[j].Length - 1, color );
+            }
+        }
+        double line = timer.Milliseconds() / kRepeatCount;
+        sprintf( name, "%2d bit Bitmap::HorizontalLine", (int) depths[d] );
+        ReportResult( name, line );
+
+        timer.Restart();
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            cFrameRasterizer::FillRuns( &targetBitmap, &runs[0], (int) runs.size(), color );
+        }
+        double fill = timer.Milliseconds() / kRepeatCount;
+
+        bool match = ( reference == target );
+        sprintf( name, "%2d bit cFrameRasterizer::FillRuns%s", (int) depths[d], match ? "" : " (MISMATCH)" );
+        ReportResult( name, fill, line );
+    }
+}
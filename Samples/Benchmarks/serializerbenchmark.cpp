@@ -0,0 +1,105 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== Serializes 10,000 frames through cICameraFrame::Save into the stock block
+//== serializer and into the arena serializer, cold and reused.
+//=================================================================================-----
+
+#include <vector>
+
+#include "benchmarks.h"
+#include "inputmanagertestpattern.h"
+#include "Core/Serializer.h"
+#include "Core/ArenaSerializer.h"
+
+using namespace CameraLibrary;
+
+namespace
+{
+    const int kFrameCount  = 10000;
+    const int kRepeatCount = 5;
+
+    //== Save every frame into the serializer, return the elapsed time ==--
+
+    double SaveFrames( Core::cISerializer *Serializer, const std::vector<cTestPatternFrame> &Frames )
+    {
+        cStopwatch timer;
+
+        for( size_t i = 0; i < Frames.size(); i++ )
+        {
+            Frames[i].Save( Serializer );
+        }
+
+        return timer.Milliseconds();
+    }
+}
+
+void SerializerBenchmark()
+{
+    //== Synthesize a segment mode take ==--
+
+    sTestPatternSettings settings;
+    settings.VideoMode   = Core::SegmentMode;
+    settings.MarkerCount = 30;
+
+    cTestPatternGenerator generator;
+    generator.Initialize( settings, 0 );
+
+    std::vector<cTestPatternFrame> frames( kFrameCount );
+
+    for( int i = 0; i < kFrameCount; i++ )
+    {
+        generator.Generate( frames[i] );
+    }
+
+    double stock    = 0;
+    double arena    = 0;
+    double reserved = 0;
+    double reused   = 0;
+    unsigned long long size = 0;
+
+    for( int repeat = 0; repeat < kRepeatCount; repeat++ )
+    {
+        //== Stock serializer, grows from 16 bytes by doubling blocks ==--
+
+        Core::cSerializer *serializer = Core::cSerializer::Create();
+        stock += SaveFrames( serializer, frames );
+        size   = serializer->Size();
+        Core::cSerializer::Destroy( serializer );
+
+        //== Arena serializer, grows a block at a time ==--
+        {
+            Core::cArenaSerializer grow;
+            arena += SaveFrames( &grow, frames );
+        }
+
+        //== Arena serializer with the capacity reserved up front ==--
+        {
+            Core::cArenaSerializer exact( size );
+            reserved += SaveFrames( &exact, frames );
+        }
+    }
+
+    //== Arena serializer cleared and refilled, no allocation after the first pass ==--
+
+    Core::cArenaSerializer reuse( size );
+
+    for( int repeat = 0; repeat < kRepeatCount; repeat++ )
+    {
+        reuse.Clear();
+        reused += SaveFrames( &reuse, frames );
+    }
+
+    stock    /= kRepeatCount;
+    arena    /= kRepeatCount;
+    reserved /= kRepeatCount;
+    reused   /= kRepeatCount;
+
+    printf( "  %d frames, %llu bytes, average of %d runs\n", kFrameCount, size, kRepeatCount );
+
+    ReportResult( "cSerializer", stock );
+    ReportResult( "cArenaSerializer", arena, stock );
+    ReportResult( "cArenaSerializer (reserved)", reserved, stock );
+    ReportResult( "cArenaSerializer (cleared and reused)", reused, stock );
+}
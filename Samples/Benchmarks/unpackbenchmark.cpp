@@ -0,0 +1,103 @@
+//=================================================================================-----
+//== NaturalPoint 2010
+//== Camera Library SDK Sample
+//==
+//== Unpacks a full 1280x1024 frame of Precision and BitPackedPrecision samples
+//== with a grayscale floor, comparing an unpack followed by a separate floor
+//== sweep with the fused scalar kernels and every SIMD level this CPU runs.
+//=================================================================================-----
+
+#include <vector>
+#include <string.h>
+
+#include "benchmarks.h"
+#include "Core/PrecisionUnpack.h"
+
+namespace
+{
+    const int kSampleCount = 1280 * 1024;
+    const int kFloor       = 24;
+    const int kRepeatCount = 100;
+
+    double TimeUnpack( Core::eVideoMode Mode, const std::vector<unsigned char> &Packed, std::vector<unsigned char> &Samples,
+                       Core::eSIMDLevel Level )
+    {
+        cStopwatch timer;
+
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            Core::cPrecisionUnpack::Unpack( Mode, &Packed[0], (int) Packed.size(), &Samples[0], kSampleCount, kFloor, Level );
+        }
+
+        return timer.Milliseconds() / kRepeatCount;
+    }
+
+    //== the two pass baseline: unpack without a floor, then sweep the floor over the samples ==--
+
+    double TimeTwoPass( Core::eVideoMode Mode, const std::vector<unsigned char> &Packed, std::vector<unsigned char> &Samples )
+    {
+        cStopwatch timer;
+
+        for( int i = 0; i < kRepeatCount; i++ )
+        {
+            Core::cPrecisionUnpack::Unpack( Mode, &Packed[0], (int) Packed.size(), &Samples[0], kSampleCount, 0, Core::SIMDScalar );
+
+            for( int j = 0; j < kSampleCount; j++ )
+            {
+                if( Samples[j] < kFloor )
+                {
+                    Samples[j] = 0;
+                }
+            }
+        }
+
+        return timer.Milliseconds() / kRepeatCount;
+    }
+}
+
+void UnpackBenchmark()
+{
+    const Core::eVideoMode modes[] = { Core::PrecisionMode, Core::BitPackedPrecisionMode };
+    const char *modeNames[] = { "Precision", "BitPacked" };
+    const Core::eSIMDLevel levels[] = { Core::SIMDNEON, Core::SIMDSSE2, Core::SIMDSSSE3, Core::SIMDAVX2 };
+
+    printf( "  %d samples, floor %d, average of %d runs, best level %s\n", kSampleCount, kFloor, kRepeatCount,
+        Core::SIMDLevelName( Core::BestSIMDLevel() ) );
+
+    for( int m = 0; m < 2; m++ )
+    {
+        std::vector<unsigned char> packed( Core::cPrecisionUnpack::PackedSize( modes[m], kSampleCount ) );
+
+        unsigned int seed = 1;
+        for( size_t i = 0; i < packed.size(); i++ )
+        {
+            seed = seed * 1103515245 + 12345;
+            packed[i] = (unsigned char) ( seed >> 24 );
+        }
+
+        std::vector<unsigned char> reference( kSampleCount );
+        std::vector<unsigned char> samples( kSampleCount );
+
+        char name[64];
+        sprintf( name, "%s unpack + floor sweep", modeNames[m] );
+        double twoPass = TimeTwoPass( modes[m], packed, reference );
+        ReportResult( name, twoPass );
+
+        sprintf( name, "%s fused scalar", modeNames[m] );
+        ReportResult( name, TimeUnpack( modes[m], packed, reference, Core::SIMDScalar ), twoPass );
+
+        for( int l = 0; l < 4; l++ )
+        {
+            if( !Core::IsSIMDLevelSupported( levels[l] ) )
+            {
+                continue;
+            }
+
+            double simd = TimeUnpack( modes[m], packed, samples, levels[l] );
+            bool match  = memcmp( &reference[0], &samples[0], kSampleCount ) == 0;
+
+            sprintf( name, "%s fused %s%s", modeNames[m], Core::SIMDLevelName( levels[l] ), match ? "" : " (MISMATCH)" );
+            ReportResult( name, simd, twoPass );
+        }
+    }
+}
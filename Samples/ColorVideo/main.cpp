@@ -44,7 +44,7 @@
 
 #include "cameralibrary.h"     //== Camera Library header file ======================---
 #include "supportcode.h"       //== Boiler-plate code for application window init ===---
-#include "videodecoder.h"      //== libav h.264 decoder implementation ==============---
+#include "modulevideodecoder.h" //== libav h.264 decoder module =====================---
 
 using namespace CameraLibrary; 
 
@@ -103,7 +103,7 @@ int main(int argc, char* argv[])
     //== Color Video Mode ==--
 
     camera->SetVideoType( Core::VideoMode );                     //== Select Color Video ==============---
-    camera->AttachModule( new cModuleVideoDecompressorLibav() ); //== create & attach video decoder ==--
+    camera->AttachModule( new cModuleVideoDecoder() );           //== create & attach video decoder ==--
     camera->SetLateDecompression( true );
 
     //== Set camera settings ==--
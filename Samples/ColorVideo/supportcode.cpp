@@ -14,7 +14,6 @@
 #include "math.h"
 #include "stdio.h"
 #include "supportcode.h"
-#include "videodecoder.h"
 
 int         gWindowWidth ;
 int         gWindowHeight;
@@ -0,0 +1,459 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <string>
+#include <vector>
+#include <mutex>
+#include <string.h>
+#include <stdlib.h>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/ISerializer.h"
+#include "Core/UID.h"
+
+namespace Core
+{
+    const long kArenaSerializerDefaultBlockSize = 64*1024; //== 64KB blocks, rounded to a power of two ==--
+
+    /// <summary>
+    /// Pool of fixed size memory blocks shared by one or more cArenaSerializers. Blocks are never
+    /// returned to the heap until the arena is destroyed, so serializers that are repeatedly filled
+    /// and released stop allocating once the pool has warmed up. Thread safe.
+    /// </summary>
+    class cSerializerArena
+    {
+    public:
+        cSerializerArena( long blockSize = kArenaSerializerDefaultBlockSize ) : mBlockSize( 1 ), mShift( 0 )
+        {
+            while( mBlockSize < (size_t) ( blockSize > 16 ? blockSize : 16 ) )
+            {
+                mBlockSize <<= 1;
+                mShift++;
+            }
+        }
+
+        /// <summary>All blocks must have been released back to the arena before it is destroyed.</summary>
+        ~cSerializerArena()
+        {
+            for( size_t i = 0; i < mFree.size(); ++i )
+            {
+                free( mFree[ i ] );
+            }
+        }
+
+        size_t          BlockSize() const { return mBlockSize; }
+        int             BlockShift() const { return mShift; }
+
+        /// <summary>
+        /// Fetch a block from the pool, allocating a new one if the pool is empty. Returns null if
+        /// the allocation fails.
+        /// </summary>
+        unsigned char * Acquire()
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                if( !mFree.empty() )
+                {
+                    unsigned char *block = mFree.back();
+                    mFree.pop_back();
+                    return block;
+                }
+            }
+            return (unsigned char*) malloc( mBlockSize );
+        }
+
+        void            Release( unsigned char *block )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            mFree.push_back( block );
+        }
+
+        /// <summary>
+        /// Pre-allocate blocks so later serialization does not touch the heap. Returns false if the
+        /// heap ran out before the pool reached 'blockCount' blocks.
+        /// </summary>
+        bool            Reserve( size_t blockCount )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            while( mFree.size() < blockCount )
+            {
+                unsigned char *block = (unsigned char*) malloc( mBlockSize );
+                if( !block )
+                {
+                    return false;
+                }
+                mFree.push_back( block );
+            }
+            return true;
+        }
+
+        size_t          FreeBlocks()
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return mFree.size();
+        }
+
+    private:
+        cSerializerArena( const cSerializerArena& );
+        cSerializerArena& operator=( const cSerializerArena& );
+
+        size_t          mBlockSize;
+        int             mShift;
+        std::vector<unsigned char*> mFree;
+        std::mutex      mLock;
+    };
+
+    /// <summary>
+    /// Serializer variant that stores its contents in fixed size arena blocks instead of a chain of
+    /// doubling blocks. Growing never copies existing data, Reserve() allocates the full capacity
+    /// up front, and Clear() keeps every block so a serializer can be reused without allocating.
+    /// Values are stored in native byte order. int, short, long long, float, double, unsigned char
+    /// and cUID (high 64 bits, then low 64 bits) are stored at their natural size. The remaining
+    /// types use an encoding of this class's own:
+    ///   long         32 bits, so streams are the same size on LLP64 and LP64 platforms.
+    ///   bool         one byte, 0 or 1.
+    ///   std::string  32 bit character count followed by the characters, no terminator.
+    ///   std::wstring 32 bit character count followed by 32 bits per character.
+    /// cSerializer's encoding of these four types is internal to the library and is not guaranteed
+    /// to match, so streams that contain them must be read back with a cArenaSerializer or a
+    /// cMappedFileReader, not a cSerializer. Streams of fixed size types and raw data are
+    /// interchangeable with cSerializer.
+    /// </summary>
+    class cArenaSerializer : public cISerializer
+    {
+    public:
+        /// <summary>Create a serializer with its own private arena.</summary>
+        cArenaSerializer( unsigned long long reserve = 0, long blockSize = kArenaSerializerDefaultBlockSize )
+            : mArena( new cSerializerArena( blockSize ) ), mOwnsArena( true )
+        {
+            Initialize( reserve );
+        }
+
+        /// <summary>Create a serializer drawing its blocks from a shared arena.</summary>
+        cArenaSerializer( cSerializerArena &arena, unsigned long long reserve = 0 )
+            : mArena( &arena ), mOwnsArena( false )
+        {
+            Initialize( reserve );
+        }
+
+        virtual ~cArenaSerializer()
+        {
+            Release();
+            if( mOwnsArena )
+            {
+                delete mArena;
+            }
+        }
+
+        /// <summary>
+        /// Make sure at least 'size' bytes can be written without acquiring more blocks. Returns
+        /// false if the arena could not supply enough blocks; the blocks it did supply are kept.
+        /// </summary>
+        bool            Reserve( unsigned long long size )
+        {
+            while( Capacity() < size )
+            {
+                unsigned char *block = mArena->Acquire();
+                if( !block )
+                {
+                    return false;
+                }
+                mBlocks.push_back( block );
+            }
+            return true;
+        }
+
+        unsigned long long Capacity() const { return (unsigned long long) mBlocks.size() << mShift; }
+
+        /// <summary>Empty the serializer and hand every block back to the arena.</summary>
+        void            Release()
+        {
+            for( size_t i = 0; i < mBlocks.size(); ++i )
+            {
+                mArena->Release( mBlocks[ i ] );
+            }
+            mBlocks.clear();
+            mPosition = 0;
+            mSize = 0;
+        }
+
+        /// <summary>Direct access to the contents, e.g. to write them out without an extra copy.</summary>
+        int             BlockCount() const { return (int) ( ( mSize + mMask ) >> mShift ); }
+        const unsigned char * Block( int index ) const { return mBlocks[ index ]; }
+        unsigned long long BlockDataSize( int index ) const
+        {
+            unsigned long long start = (unsigned long long) index << mShift;
+            return ( mSize - start < mBlockSize ) ? mSize - start : mBlockSize;
+        }
+
+        //==============================================================================================
+        // Included interfaces
+        //==============================================================================================
+
+        // cISerializer
+        virtual void    WriteData( const cISerializer &data )
+        {
+            const cArenaSerializer *arena = dynamic_cast<const cArenaSerializer*>( &data );
+
+            if( arena == this )
+            {
+                //== appending to ourselves would read blocks as they are being written ==--
+
+                std::vector<unsigned char> copy( (size_t) mSize );
+                unsigned long long position = mPosition;
+
+                mPosition = 0;
+                ReadData( copy.data(), copy.size() );
+                mPosition = position;
+                WriteData( copy.data(), copy.size() );
+                return;
+            }
+
+            if( arena )
+            {
+                int blockCount = arena->BlockCount();
+
+                Reserve( mPosition + arena->mSize );
+                for( int i = 0; i < blockCount; ++i )
+                {
+                    WriteData( arena->Block( i ), arena->BlockDataSize( i ) );
+                }
+                return;
+            }
+
+            //== generic serializers are streamed through their reader interface ==--
+
+            cISerializer &source = const_cast<cISerializer&>( data );
+            unsigned long long position = source.Tell();
+            unsigned char buffer[ 4096 ];
+
+            Reserve( mPosition + source.Size() );
+            source.Seek( 0 );
+            while( !source.IsEOF() )
+            {
+                unsigned long long count = source.ReadData( buffer, sizeof( buffer ) );
+                if( count == 0 )
+                {
+                    break;
+                }
+                WriteData( buffer, count );
+            }
+            source.Seek( position );
+        }
+
+        /// <summary>Empties the serializer but keeps its capacity.</summary>
+        virtual void    Clear()
+        {
+            mPosition = 0;
+            mSize = 0;
+        }
+
+        // cIWriter
+
+        /// <summary>Returns the number of bytes written, which is short only if memory ran out.</summary>
+        virtual unsigned long long WriteData( const unsigned char *buffer, unsigned long long bufferSize )
+        {
+            if( !Reserve( mPosition + bufferSize ) )
+            {
+                unsigned long long capacity = Capacity();
+                bufferSize = ( capacity > mPosition ) ? capacity - mPosition : 0;
+            }
+
+            unsigned long long remaining = bufferSize;
+
+            while( remaining > 0 )
+            {
+                size_t offset = (size_t) ( mPosition & mMask );
+                size_t count  = mBlockSize - offset;
+                if( count > remaining )
+                {
+                    count = (size_t) remaining;
+                }
+                memcpy( mBlocks[ (size_t) ( mPosition >> mShift ) ] + offset, buffer, count );
+                buffer += count;
+                remaining -= count;
+                Advance( count );
+            }
+
+            return bufferSize;
+        }
+        virtual void    WriteInt( int val )             { Put( val ); }
+        virtual void    WriteLongLong( long long val )  { Put( val ); }
+        virtual void    WriteLong( long val )           { Put( (int) val ); }
+        virtual void    WriteShort( short val )         { Put( val ); }
+        virtual void    WriteDouble( double val )       { Put( val ); }
+        virtual void    WriteFloat( float val )         { Put( val ); }
+        virtual void    WriteBool( bool val )           { Put( (unsigned char) ( val ? 1 : 0 ) ); }
+        virtual void    WriteByte( unsigned char val )  { Put( val ); }
+        virtual void    WriteString( const std::string &str )
+        {
+            Put( (int) str.size() );
+            WriteData( (const unsigned char*) str.data(), str.size() );
+        }
+        virtual void    WriteWString( const std::wstring &str )
+        {
+            Put( (int) str.size() );
+            for( size_t i = 0; i < str.size(); ++i )
+            {
+                Put( (int) str[ i ] );
+            }
+        }
+        virtual void    WriteUID( const cUID &id )
+        {
+            Put( id.HighBits() );
+            Put( id.LowBits() );
+        }
+
+        // cIReader
+        virtual unsigned long long ReadData( unsigned char *buffer, unsigned long long bufferSize )
+        {
+            unsigned long long remaining = ( mSize > mPosition ) ? mSize - mPosition : 0;
+            if( bufferSize > remaining )
+            {
+                bufferSize = remaining;
+            }
+
+            remaining = bufferSize;
+
+            while( remaining > 0 )
+            {
+                size_t offset = (size_t) ( mPosition & mMask );
+                size_t count  = mBlockSize - offset;
+                if( count > remaining )
+                {
+                    count = (size_t) remaining;
+                }
+                memcpy( buffer, mBlocks[ (size_t) ( mPosition >> mShift ) ] + offset, count );
+                buffer += count;
+                remaining -= count;
+                mPosition += count;
+            }
+
+            return bufferSize;
+        }
+        virtual int     ReadInt()                       { return Get<int>(); }
+        virtual long long ReadLongLong()                { return Get<long long>(); }
+        virtual long    ReadLong ()                     { return (long) Get<int>(); }
+        virtual short   ReadShort()                     { return Get<short>(); }
+        virtual double  ReadDouble()                    { return Get<double>(); }
+        virtual float   ReadFloat()                     { return Get<float>(); }
+        virtual bool    ReadBool()                      { return Get<unsigned char>() != 0; }
+        virtual unsigned char ReadByte()                { return Get<unsigned char>(); }
+        virtual bool    IsEOF() const                   { return mPosition >= mSize; }
+        virtual std::string ReadString()
+        {
+            int length = Get<int>();
+            std::string str;
+            if( length > 0 && (unsigned long long) length <= mSize - mPosition )
+            {
+                str.resize( length );
+                ReadData( (unsigned char*) &str[ 0 ], length );
+            }
+            return str;
+        }
+        virtual std::wstring ReadWString()
+        {
+            int length = Get<int>();
+            std::wstring str;
+            if( length > 0 && (unsigned long long) length * sizeof( int ) <= mSize - mPosition )
+            {
+                str.resize( length );
+                for( int i = 0; i < length; ++i )
+                {
+                    str[ i ] = (wchar_t) Get<int>();
+                }
+            }
+            return str;
+        }
+        virtual cUID    ReadUID()
+        {
+            cUID::uint64 high = Get<cUID::uint64>();
+            cUID::uint64 low  = Get<cUID::uint64>();
+            return cUID( high, low );
+        }
+
+        // cIStream
+        virtual unsigned long long Tell() const         { return mPosition; }
+        virtual bool    Seek( unsigned long long pos )
+        {
+            if( pos > mSize )
+            {
+                return false;
+            }
+            mPosition = pos;
+            return true;
+        }
+        virtual unsigned long long Size() const         { return mSize; }
+
+    private:
+        cArenaSerializer( const cArenaSerializer& );
+        cArenaSerializer& operator=( const cArenaSerializer& );
+
+        void            Initialize( unsigned long long reserve )
+        {
+            mBlockSize = mArena->BlockSize();
+            mShift     = mArena->BlockShift();
+            mMask      = mBlockSize - 1;
+            mPosition  = 0;
+            mSize      = 0;
+            Reserve( reserve );
+        }
+
+        void            Advance( size_t count )
+        {
+            mPosition += count;
+            if( mPosition > mSize )
+            {
+                mSize = mPosition;
+            }
+        }
+
+        //== fast path: the value fits in an already acquired block ==--
+
+        template<typename T> void Put( const T &val )
+        {
+            size_t offset = (size_t) ( mPosition & mMask );
+            size_t block  = (size_t) ( mPosition >> mShift );
+
+            if( offset + sizeof( T ) <= mBlockSize && block < mBlocks.size() )
+            {
+                memcpy( mBlocks[ block ] + offset, &val, sizeof( T ) );
+                Advance( sizeof( T ) );
+            }
+            else
+            {
+                WriteData( (const unsigned char*) &val, sizeof( T ) );
+            }
+        }
+
+        template<typename T> T Get()
+        {
+            T val = T();
+            size_t offset = (size_t) ( mPosition & mMask );
+
+            if( offset + sizeof( T ) <= mBlockSize && mPosition + sizeof( T ) <= mSize )
+            {
+                memcpy( &val, mBlocks[ (size_t) ( mPosition >> mShift ) ] + offset, sizeof( T ) );
+                mPosition += sizeof( T );
+            }
+            else
+            {
+                ReadData( (unsigned char*) &val, sizeof( T ) );
+            }
+            return val;
+        }
+
+        cSerializerArena *  mArena;
+        bool                mOwnsArena;
+        std::vector<unsigned char*> mBlocks;
+        size_t              mBlockSize;
+        size_t              mMask;
+        int                 mShift;
+        unsigned long long  mPosition;
+        unsigned long long  mSize;
+    };
+}
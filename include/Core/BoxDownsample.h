@@ -0,0 +1,227 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <vector>
+#include <string.h>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/GrayscaleExpand.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Integer factor box filter for 8 bit grayscale images. Each output pixel is the rounded mean
+    /// of a factor x factor block of source pixels, so a region is reduced in one pass that reads
+    /// every source pixel once and writes only output pixels. Output rows go through the
+    /// cGrayscaleExpand row kernels, giving the same 8, 16, 24 and 32 bit formats as Expand().
+    /// </summary>
+    class cBoxDownsample
+    {
+    public:
+        /// <summary>Largest output size for a source region at a factor.</summary>
+        static int OutputSize( int sourceSize, int factor )
+        {
+            return ( factor > 0 && sourceSize > 0 ) ? sourceSize / factor : 0;
+        }
+
+        /// <summary>Smallest factor that fits a width x height region into a targetWidth x targetHeight target.</summary>
+        static int FitFactor( int width, int height, int targetWidth, int targetHeight )
+        {
+            if( targetWidth <= 0 || targetHeight <= 0 )
+            {
+                return 0;
+            }
+            int factorX = ( width  + targetWidth  - 1 ) / targetWidth;
+            int factorY = ( height + targetHeight - 1 ) / targetHeight;
+            int factor  = ( factorX > factorY ) ? factorX : factorY;
+            return ( factor < 1 ) ? 1 : factor;
+        }
+
+        /// <summary>
+        /// Reduce the outputWidth*factor x outputHeight*factor pixels at 'source' into an
+        /// outputWidth x outputHeight image at 'destination'. Returns false for unsupported depths.
+        /// </summary>
+        static bool Downsample( const unsigned char *source, int sourceSpan, int outputWidth, int outputHeight, int factor,
+                                unsigned char *destination, int destinationSpan, int bitsPerPixel,
+                                eSIMDLevel level = BestSIMDLevel() )
+        {
+            cGrayscaleExpand::RowKernel kernel = cGrayscaleExpand::Kernel( bitsPerPixel, level );
+            if( !kernel || factor < 1 )
+            {
+                return false;
+            }
+
+            if( factor == 1 )
+            {
+                return cGrayscaleExpand::Expand( source, sourceSpan, outputWidth, outputHeight,
+                                                 destination, destinationSpan, bitsPerPixel, level );
+            }
+
+            if( outputWidth <= 0 || outputHeight <= 0 )
+            {
+                return true;
+            }
+
+            std::vector<unsigned int>   wideSums;
+            std::vector<unsigned short> sums;
+            std::vector<unsigned char>  row( outputWidth );
+
+            //== 16 bit sums hold blocks of up to 16x16 and vectorize twice as wide ==--
+
+            if( factor <= kMaxShortFactor )
+            {
+                sums.resize( (size_t) outputWidth * factor );
+            }
+            else
+            {
+                wideSums.resize( (size_t) outputWidth * factor );
+            }
+
+            for( int y = 0; y < outputHeight; ++y )
+            {
+                const unsigned char *block = source + (size_t) y * factor * sourceSpan;
+                if( factor <= kMaxShortFactor )
+                {
+                    Row( block, sourceSpan, outputWidth, factor, &sums[ 0 ], &row[ 0 ] );
+                }
+                else
+                {
+                    Row( block, sourceSpan, outputWidth, factor, &wideSums[ 0 ], &row[ 0 ] );
+                }
+                kernel( &row[ 0 ], destination + (size_t) y * destinationSpan, outputWidth );
+            }
+            return true;
+        }
+
+        static const int kMaxShortFactor = 16;
+
+        /// <summary>
+        /// Reduce 'factor' source rows into one 8 bit row of 'count' pixels. 'sums' is scratch space
+        /// for count * factor column sums; 16 bit sums are only valid up to kMaxShortFactor.
+        /// </summary>
+        template<typename SumType>
+        static void Row( const unsigned char *source, int sourceSpan, int count, int factor,
+                         SumType *sums, unsigned char *destination )
+        {
+            const int width = count * factor;
+
+            //== column sums first ==--
+
+            memset( sums, 0, width * sizeof( SumType ) );
+            for( int r = 0; r < factor; ++r )
+            {
+                AddRow( source + (size_t) r * sourceSpan, sums, width );
+            }
+
+            //== then each block, divided by a shift when the block area is a power of two ==--
+
+            const unsigned int area = (unsigned int) ( factor * factor );
+            const unsigned int half = area / 2;
+            int shift = -1;
+            if( ( area & ( area - 1 ) ) == 0 )
+            {
+                for( shift = 0; ( 1u << shift ) < area; ++shift ) { }
+            }
+
+            int x = Blocks( sums, count, factor, half, shift, destination );
+
+            for( ; x < count; ++x )
+            {
+                const SumType *block = sums + x * factor;
+                unsigned int total = half;
+                for( int i = 0; i < factor; ++i )
+                {
+                    total += block[ i ];
+                }
+                destination[ x ] = (unsigned char) ( shift >= 0 ? total >> shift : total / area );
+            }
+        }
+
+    private:
+        //== Vector block sums, returns the number of outputs written ==--
+
+        static int Blocks( const unsigned int *, int, int, unsigned int, int, unsigned char * )
+        {
+            return 0;
+        }
+
+        static int Blocks( const unsigned short *sums, int count, int factor, unsigned int half, int shift,
+                           unsigned char *destination )
+        {
+            int x = 0;
+#if defined( CORE_SIMD_SSE2 )
+            //== power of two factors up to 8: pairwise sums with madd, repacked to 16 bits per level
+            //== (an 8x8 block sums to at most 16320, inside the signed 16 bit range of packs) ==--
+
+            if( shift < 0 || factor > 8 )
+            {
+                return 0;
+            }
+
+            const __m128i ones  = _mm_set1_epi16( 1 );
+            const __m128i round = _mm_set1_epi16( (short) half );
+            const __m128i bits  = _mm_cvtsi32_si128( shift );
+
+            for( ; x + 8 <= count; x += 8 )
+            {
+                __m128i level[ 8 ];
+                const unsigned short *block = sums + x * factor;
+                for( int i = 0; i < factor; ++i )
+                {
+                    level[ i ] = _mm_loadu_si128( (const __m128i*) ( block + 8 * i ) );
+                }
+                for( int n = factor; n > 1; n /= 2 )
+                {
+                    for( int i = 0; i < n / 2; ++i )
+                    {
+                        level[ i ] = _mm_packs_epi32( _mm_madd_epi16( level[ 2 * i ], ones ),
+                                                      _mm_madd_epi16( level[ 2 * i + 1 ], ones ) );
+                    }
+                }
+                __m128i totals = _mm_srl_epi16( _mm_add_epi16( level[ 0 ], round ), bits );
+                _mm_storel_epi64( (__m128i*) ( destination + x ), _mm_packus_epi16( totals, totals ) );
+            }
+#endif
+            return x;
+        }
+
+        static void AddRow( const unsigned char *line, unsigned int *sums, int width )
+        {
+            for( int x = 0; x < width; ++x )
+            {
+                sums[ x ] += line[ x ];
+            }
+        }
+
+        static void AddRow( const unsigned char *line, unsigned short *sums, int width )
+        {
+            int x = 0;
+#if defined( CORE_SIMD_SSE2 )
+            const __m128i zero = _mm_setzero_si128();
+            for( ; x + 16 <= width; x += 16 )
+            {
+                __m128i pixels = _mm_loadu_si128( (const __m128i*) ( line + x ) );
+                __m128i low    = _mm_loadu_si128( (const __m128i*) ( sums + x ) );
+                __m128i high   = _mm_loadu_si128( (const __m128i*) ( sums + x + 8 ) );
+                _mm_storeu_si128( (__m128i*) ( sums + x ),     _mm_add_epi16( low,  _mm_unpacklo_epi8( pixels, zero ) ) );
+                _mm_storeu_si128( (__m128i*) ( sums + x + 8 ), _mm_add_epi16( high, _mm_unpackhi_epi8( pixels, zero ) ) );
+            }
+#elif defined( CORE_SIMD_NEON )
+            for( ; x + 16 <= width; x += 16 )
+            {
+                uint8x16_t pixels = vld1q_u8( line + x );
+                vst1q_u16( sums + x,     vaddw_u8( vld1q_u16( sums + x ),     vget_low_u8( pixels ) ) );
+                vst1q_u16( sums + x + 8, vaddw_u8( vld1q_u16( sums + x + 8 ), vget_high_u8( pixels ) ) );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                sums[ x ] = (unsigned short) ( sums[ x ] + line[ x ] );
+            }
+        }
+    };
+}
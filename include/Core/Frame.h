@@ -67,7 +67,9 @@ namespace Core
             Packet,
             ObjectOnly,
             Original,
-            TinyObjectOnly
+            TinyObjectOnly,
+            TestPattern         //== synthetic frames of cTestPatternFrame (inputmanagertestpattern.h), never
+                                //== produced or loaded by the library ==--
         };
 
         virtual eCompressedFrameTypes CompressionType() const = 0;
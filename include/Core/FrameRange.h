@@ -1,2 +1,82 @@
-//== Placeholder: No public interface ==--
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
 
+// Local includes
+#include "Core/BuildConfig.h"
+
+namespace Core
+{
+    /// <summary>An inclusive range of frame IDs { Start()..End() }. A range with End() < Start() is empty.</summary>
+    class cFrameRange
+    {
+    public:
+        /// <summary>An empty range.</summary>
+        cFrameRange() : mStart( 0 ), mEnd( -1 ) { }
+
+        /// <summary>The frames start..end inclusive.</summary>
+        cFrameRange( int start, int end ) : mStart( start ), mEnd( end ) { }
+
+        int             Start() const { return mStart; }
+        int             End() const { return mEnd; }
+
+        void            SetStart( int start ) { mStart = start; }
+        void            SetEnd( int end ) { mEnd = end; }
+
+        bool            IsEmpty() const { return mEnd < mStart; }
+
+        /// <summary>Number of frames in the range.</summary>
+        long long       FrameCount() const { return IsEmpty() ? 0 : (long long) mEnd - mStart + 1; }
+
+        bool            Contains( int frameID ) const { return frameID >= mStart && frameID <= mEnd; }
+
+        bool            Contains( const cFrameRange &other ) const
+        {
+            return other.IsEmpty() || ( !IsEmpty() && other.mStart >= mStart && other.mEnd <= mEnd );
+        }
+
+        /// <summary>True if the ranges share at least one frame.</summary>
+        bool            Overlaps( const cFrameRange &other ) const
+        {
+            return !IsEmpty() && !other.IsEmpty() && other.mStart <= mEnd && other.mEnd >= mStart;
+        }
+
+        /// <summary>True if the ranges overlap or sit directly next to each other, i.e. their union is one range.</summary>
+        bool            Touches( const cFrameRange &other ) const
+        {
+            return !IsEmpty() && !other.IsEmpty()
+                && (long long) other.mStart <= (long long) mEnd + 1 && (long long) other.mEnd + 1 >= (long long) mStart;
+        }
+
+        /// <summary>Frames common to both ranges.</summary>
+        cFrameRange     Intersection( const cFrameRange &other ) const
+        {
+            return cFrameRange( mStart > other.mStart ? mStart : other.mStart, mEnd < other.mEnd ? mEnd : other.mEnd );
+        }
+
+        /// <summary>Smallest range containing both ranges.</summary>
+        cFrameRange     Bounds( const cFrameRange &other ) const
+        {
+            if( IsEmpty() )
+            {
+                return other;
+            }
+            if( other.IsEmpty() )
+            {
+                return *this;
+            }
+            return cFrameRange( mStart < other.mStart ? mStart : other.mStart, mEnd > other.mEnd ? mEnd : other.mEnd );
+        }
+
+        bool            operator==( const cFrameRange &other ) const
+        {
+            return ( IsEmpty() && other.IsEmpty() ) || ( mStart == other.mStart && mEnd == other.mEnd );
+        }
+        bool            operator!=( const cFrameRange &other ) const { return !( *this == other ); }
+
+    private:
+        int             mStart;
+        int             mEnd;
+    };
+}
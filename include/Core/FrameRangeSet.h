@@ -1,2 +1,176 @@
-//== Placeholder: No public interface ==--
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
 
+// System includes
+#include <vector>
+#include <algorithm>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/FrameRange.h"
+
+namespace Core
+{
+    /// <summary>
+    /// A set of frame IDs stored as sorted, disjoint, non-adjacent cFrameRanges. Adding or removing
+    /// a range merges/splits its neighbours so the set stays canonical; membership and range
+    /// lookups are binary searches over the ranges.
+    /// </summary>
+    class cFrameRangeSet
+    {
+    public:
+        cFrameRangeSet() { }
+        cFrameRangeSet( const cFrameRange &range ) { Add( range ); }
+
+        void            Clear() { mRanges.clear(); }
+        bool            IsEmpty() const { return mRanges.empty(); }
+
+        int             RangeCount() const { return (int) mRanges.size(); }
+        const cFrameRange & Range( int index ) const { return mRanges[ index ]; }
+
+        /// <summary>Total number of frames in the set.</summary>
+        long long       FrameCount() const
+        {
+            long long count = 0;
+            for( size_t i = 0; i < mRanges.size(); ++i )
+            {
+                count += mRanges[ i ].FrameCount();
+            }
+            return count;
+        }
+
+        /// <summary>Smallest single range containing the whole set.</summary>
+        cFrameRange     Bounds() const
+        {
+            return mRanges.empty() ? cFrameRange() : cFrameRange( mRanges.front().Start(), mRanges.back().End() );
+        }
+
+        /// <summary>Add frames to the set, merging with any ranges they overlap or adjoin.</summary>
+        void            Add( const cFrameRange &range )
+        {
+            if( range.IsEmpty() )
+            {
+                return;
+            }
+
+            //== first range that could touch the new one, i.e. ends no earlier than range.Start() - 1 ==--
+
+            std::vector<cFrameRange>::iterator first = std::lower_bound( mRanges.begin(), mRanges.end(), range,
+                []( const cFrameRange &a, const cFrameRange &b ) { return (long long) a.End() + 1 < (long long) b.Start(); } );
+
+            std::vector<cFrameRange>::iterator last = first;
+            cFrameRange merged = range;
+
+            while( last != mRanges.end() && last->Touches( merged ) )
+            {
+                merged = merged.Bounds( *last );
+                ++last;
+            }
+
+            if( first == last )
+            {
+                mRanges.insert( first, merged );
+            }
+            else
+            {
+                *first = merged;
+                mRanges.erase( first + 1, last );
+            }
+        }
+
+        void            Add( const cFrameRangeSet &other )
+        {
+            for( size_t i = 0; i < other.mRanges.size(); ++i )
+            {
+                Add( other.mRanges[ i ] );
+            }
+        }
+
+        /// <summary>Remove frames from the set, splitting a range if the removed frames are in its middle.</summary>
+        void            Remove( const cFrameRange &range )
+        {
+            if( range.IsEmpty() )
+            {
+                return;
+            }
+
+            std::vector<cFrameRange>::iterator first = std::lower_bound( mRanges.begin(), mRanges.end(), range,
+                []( const cFrameRange &a, const cFrameRange &b ) { return a.End() < b.Start(); } );
+
+            std::vector<cFrameRange>::iterator last = first;
+            while( last != mRanges.end() && last->Overlaps( range ) )
+            {
+                ++last;
+            }
+            if( first == last )
+            {
+                return;
+            }
+
+            //== at most two partial ranges survive, the head of the first and the tail of the last ==--
+
+            cFrameRange head( first->Start(), range.Start() - 1 );
+            cFrameRange tail( range.End() + 1, ( last - 1 )->End() );
+            if( range.Start() == first->Start() )
+            {
+                head = cFrameRange();
+            }
+            if( range.End() == ( last - 1 )->End() )
+            {
+                tail = cFrameRange();
+            }
+
+            first = mRanges.erase( first, last );
+            if( !tail.IsEmpty() )
+            {
+                first = mRanges.insert( first, tail );
+            }
+            if( !head.IsEmpty() )
+            {
+                mRanges.insert( first, head );
+            }
+        }
+
+        /// <summary>Index of the range containing the frame, or -1.</summary>
+        int             Find( int frameID ) const
+        {
+            std::vector<cFrameRange>::const_iterator it = std::lower_bound( mRanges.begin(), mRanges.end(), frameID,
+                []( const cFrameRange &a, int frame ) { return a.End() < frame; } );
+
+            if( it != mRanges.end() && it->Contains( frameID ) )
+            {
+                return (int) ( it - mRanges.begin() );
+            }
+            return -1;
+        }
+
+        bool            Contains( int frameID ) const { return Find( frameID ) >= 0; }
+
+        /// <summary>The part of the set that lies within a range.</summary>
+        cFrameRangeSet  Intersection( const cFrameRange &range ) const
+        {
+            cFrameRangeSet result;
+            if( range.IsEmpty() )
+            {
+                return result;
+            }
+
+            std::vector<cFrameRange>::const_iterator it = std::lower_bound( mRanges.begin(), mRanges.end(), range,
+                []( const cFrameRange &a, const cFrameRange &b ) { return a.End() < b.Start(); } );
+
+            for( ; it != mRanges.end() && it->Start() <= range.End(); ++it )
+            {
+                result.mRanges.push_back( it->Intersection( range ) );
+            }
+            return result;
+        }
+
+        bool            operator==( const cFrameRangeSet &other ) const { return mRanges == other.mRanges; }
+        bool            operator!=( const cFrameRangeSet &other ) const { return !( *this == other ); }
+
+    private:
+        std::vector<cFrameRange> mRanges;
+    };
+}
@@ -0,0 +1,228 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <string.h>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/SIMD.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Expands 8 bit grayscale images into display buffers. Rows may have any span (in bytes) on
+    /// either side. Target formats:
+    ///   32 bit  gray in R, G and B, 255 alpha (matches PIXELCOLORA( g, g, g, 255 ))
+    ///   24 bit  gray in R, G and B
+    ///   16 bit  RGB 5:6:5
+    ///   8 bit   straight copy
+    /// Row kernels are picked per eSIMDLevel; by default the best level of the running CPU.
+    /// </summary>
+    class cGrayscaleExpand
+    {
+    public:
+        typedef void ( *RowKernel )( const unsigned char *source, unsigned char *destination, int count );
+
+        /// <summary>Row kernel for a target depth at a SIMD level (falling back to the next lower level
+        /// implemented), or null for unsupported depths.</summary>
+        static RowKernel Kernel( int bitsPerPixel, eSIMDLevel level = BestSIMDLevel() )
+        {
+            switch( bitsPerPixel )
+            {
+            case 8:
+                return Row8;
+            case 16:
+#if defined( CORE_SIMD_AVX2 )
+                if( level >= SIMDAVX2 && IsSIMDLevelSupported( SIMDAVX2 ) ) return Row16AVX2;
+#endif
+#if defined( CORE_SIMD_SSE2 )
+                if( level >= SIMDSSE2 ) return Row16SSE2;
+#endif
+#if defined( CORE_SIMD_NEON )
+                if( level >= SIMDNEON ) return Row16NEON;
+#endif
+                return Row16;
+            case 24:
+                return Row24;
+            case 32:
+#if defined( CORE_SIMD_AVX2 )
+                if( level >= SIMDAVX2 && IsSIMDLevelSupported( SIMDAVX2 ) ) return Row32AVX2;
+#endif
+#if defined( CORE_SIMD_SSE2 )
+                if( level >= SIMDSSE2 ) return Row32SSE2;
+#endif
+#if defined( CORE_SIMD_NEON )
+                if( level >= SIMDNEON ) return Row32NEON;
+#endif
+                return Row32;
+            default:
+                return nullptr;
+            }
+        }
+
+        /// <summary>Expand a width x height image. Returns false for unsupported target depths.</summary>
+        static bool Expand( const unsigned char *source, int sourceSpan, int width, int height,
+                            unsigned char *destination, int destinationSpan, int bitsPerPixel,
+                            eSIMDLevel level = BestSIMDLevel() )
+        {
+            RowKernel kernel = Kernel( bitsPerPixel, level );
+            if( !kernel )
+            {
+                return false;
+            }
+
+            for( int y = 0; y < height; ++y )
+            {
+                kernel( source + (long long) y * sourceSpan, destination + (long long) y * destinationSpan, width );
+            }
+            return true;
+        }
+
+        //== scalar kernels, also used for the tails of the vector kernels ==--
+
+        static void Row8( const unsigned char *source, unsigned char *destination, int count )
+        {
+            memcpy( destination, source, count );
+        }
+
+        static void Row16( const unsigned char *source, unsigned char *destination, int count )
+        {
+            unsigned short *out = reinterpret_cast<unsigned short*>( destination );
+            for( int i = 0; i < count; ++i )
+            {
+                unsigned int g = source[ i ];
+                out[ i ] = (unsigned short) ( ( ( g >> 3 ) << 11 ) | ( ( g >> 2 ) << 5 ) | ( g >> 3 ) );
+            }
+        }
+
+        static void Row24( const unsigned char *source, unsigned char *destination, int count )
+        {
+            for( int i = 0; i < count; ++i )
+            {
+                destination[ 0 ] = destination[ 1 ] = destination[ 2 ] = source[ i ];
+                destination += 3;
+            }
+        }
+
+        static void Row32( const unsigned char *source, unsigned char *destination, int count )
+        {
+            for( int i = 0; i < count; ++i )
+            {
+                unsigned int g = source[ i ];
+                unsigned int pixel = g | ( g << 8 ) | ( g << 16 ) | 0xFF000000u;
+                memcpy( destination + 4 * i, &pixel, 4 );
+            }
+        }
+
+#if defined( CORE_SIMD_SSE2 )
+        static void Row16SSE2( const unsigned char *source, unsigned char *destination, int count )
+        {
+            const __m128i zero = _mm_setzero_si128();
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                __m128i g  = _mm_loadu_si128( (const __m128i*) ( source + i ) );
+                _mm_storeu_si128( (__m128i*) ( destination + 2 * i ),      Pack565( _mm_unpacklo_epi8( g, zero ) ) );
+                _mm_storeu_si128( (__m128i*) ( destination + 2 * i + 16 ), Pack565( _mm_unpackhi_epi8( g, zero ) ) );
+            }
+            Row16( source + i, destination + 2 * i, count - i );
+        }
+
+        static void Row32SSE2( const unsigned char *source, unsigned char *destination, int count )
+        {
+            const __m128i alpha = _mm_set1_epi8( (char) 0xFF );
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                //== (g | g << 8) and (g | 255 << 8) interleaved as 16 bit pairs give g, g, g, 255 ==--
+
+                __m128i g  = _mm_loadu_si128( (const __m128i*) ( source + i ) );
+                __m128i gg = _mm_unpacklo_epi8( g, g );
+                __m128i ga = _mm_unpacklo_epi8( g, alpha );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i ),      _mm_unpacklo_epi16( gg, ga ) );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i + 16 ), _mm_unpackhi_epi16( gg, ga ) );
+                gg = _mm_unpackhi_epi8( g, g );
+                ga = _mm_unpackhi_epi8( g, alpha );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i + 32 ), _mm_unpacklo_epi16( gg, ga ) );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i + 48 ), _mm_unpackhi_epi16( gg, ga ) );
+            }
+            Row32( source + i, destination + 4 * i, count - i );
+        }
+#endif
+
+#if defined( CORE_SIMD_AVX2 )
+        CORE_TARGET_AVX2 static void Row16AVX2( const unsigned char *source, unsigned char *destination, int count )
+        {
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                __m256i g = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) ( source + i ) ) );
+                __m256i r = _mm256_srli_epi16( g, 3 );
+                __m256i p = _mm256_or_si256( _mm256_or_si256( _mm256_slli_epi16( r, 11 ),
+                                                              _mm256_slli_epi16( _mm256_srli_epi16( g, 2 ), 5 ) ), r );
+                _mm256_storeu_si256( (__m256i*) ( destination + 2 * i ), p );
+            }
+            Row16( source + i, destination + 2 * i, count - i );
+        }
+
+        CORE_TARGET_AVX2 static void Row32AVX2( const unsigned char *source, unsigned char *destination, int count )
+        {
+            //== each lane replicates four source bytes into four pixels, alpha is or'ed in ==--
+
+            const __m256i low   = _mm256_setr_epi8(  0, 0, 0, -1,  1, 1, 1, -1,  2, 2, 2, -1,  3, 3, 3, -1,
+                                                     4, 4, 4, -1,  5, 5, 5, -1,  6, 6, 6, -1,  7, 7, 7, -1 );
+            const __m256i high  = _mm256_setr_epi8(  8, 8, 8, -1,  9, 9, 9, -1, 10,10,10, -1, 11,11,11, -1,
+                                                    12,12,12, -1, 13,13,13, -1, 14,14,14, -1, 15,15,15, -1 );
+            const __m256i alpha = _mm256_set1_epi32( (int) 0xFF000000u );
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                __m256i g = _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i*) ( source + i ) ) );
+                _mm256_storeu_si256( (__m256i*) ( destination + 4 * i ),      _mm256_or_si256( _mm256_shuffle_epi8( g, low ), alpha ) );
+                _mm256_storeu_si256( (__m256i*) ( destination + 4 * i + 32 ), _mm256_or_si256( _mm256_shuffle_epi8( g, high ), alpha ) );
+            }
+            Row32SSE2( source + i, destination + 4 * i, count - i );
+        }
+#endif
+
+#if defined( CORE_SIMD_NEON )
+        static void Row16NEON( const unsigned char *source, unsigned char *destination, int count )
+        {
+            int i = 0;
+            for( ; i + 8 <= count; i += 8 )
+            {
+                uint16x8_t g = vmovl_u8( vld1_u8( source + i ) );
+                uint16x8_t r = vshrq_n_u16( g, 3 );
+                vst1q_u16( reinterpret_cast<unsigned short*>( destination + 2 * i ),
+                           vorrq_u16( vorrq_u16( vshlq_n_u16( r, 11 ), vshlq_n_u16( vshrq_n_u16( g, 2 ), 5 ) ), r ) );
+            }
+            Row16( source + i, destination + 2 * i, count - i );
+        }
+
+        static void Row32NEON( const unsigned char *source, unsigned char *destination, int count )
+        {
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                uint8x16x4_t pixels;
+                pixels.val[ 0 ] = pixels.val[ 1 ] = pixels.val[ 2 ] = vld1q_u8( source + i );
+                pixels.val[ 3 ] = vdupq_n_u8( 0xFF );
+                vst4q_u8( destination + 4 * i, pixels );
+            }
+            Row32( source + i, destination + 4 * i, count - i );
+        }
+#endif
+
+    private:
+#if defined( CORE_SIMD_SSE2 )
+        static __m128i Pack565( __m128i g )
+        {
+            __m128i r = _mm_srli_epi16( g, 3 );
+            return _mm_or_si128( _mm_or_si128( _mm_slli_epi16( r, 11 ), _mm_slli_epi16( _mm_srli_epi16( g, 2 ), 5 ) ), r );
+        }
+#endif
+    };
+}
@@ -8,6 +8,7 @@
 
 // Local includes
 #include "Core/IBasicStream.h"
+#include "Core/StreamArray.h"
 #include "Core/BuildConfig.h"
 
 namespace Core
@@ -39,6 +40,12 @@ namespace Core
 
         virtual unsigned char ReadByte() = 0;
 
+        /// <summary>Read up to 'count' values in one call, returns the number of values read.</summary>
+        template<typename T> unsigned long long ReadArray( T *values, unsigned long long count )
+        {
+            return cStreamArray<T>::Read( *this, values, count );
+        }
+
         //==============================================================================================
         // Included interfaces
         //==============================================================================================
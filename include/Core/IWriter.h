@@ -8,6 +8,7 @@
 
 // Local includes
 #include "Core/IBasicStream.h"
+#include "Core/StreamArray.h"
 #include "Core/BuildConfig.h"
 
 namespace Core
@@ -37,6 +38,12 @@ namespace Core
 
         virtual void    WriteByte( unsigned char val ) = 0;
 
+        /// <summary>Write 'count' values in one call, see cStreamArray for the supported types.</summary>
+        template<typename T> void WriteArray( const T *values, unsigned long long count )
+        {
+            cStreamArray<T>::Write( *this, values, count );
+        }
+
         //==============================================================================================
         // Included interfaces
         //==============================================================================================
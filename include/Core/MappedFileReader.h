@@ -0,0 +1,220 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <string>
+#include <string.h>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/IReader.h"
+#include "Core/UID.h"
+#include "Core/MemoryMappedFile.h"
+
+namespace Core
+{
+    const unsigned long long kMappedReaderDefaultPrefetch = 8*1024*1024; //== read-ahead window ==--
+
+    /// <summary>
+    /// cIReader over a memory-mapped file (or any caller owned memory span). Reads copy straight out
+    /// of the mapping, and Peek() hands out pointers into it so callers can parse records in place
+    /// without copying at all. The mapping is advised for sequential access and the next window is
+    /// prefetched as the read position advances, whichever read, Skip() or Seek() moves it.
+    /// Values are expected in native byte order. long, bool, std::string and std::wstring are decoded
+    /// with cArenaSerializer's encoding (see ArenaSerializer.h), not cSerializer's, so files holding
+    /// those types must have been written by a cArenaSerializer. Streams of fixed size types and raw
+    /// data can come from either serializer.
+    /// </summary>
+    class cMappedFileReader : public cIReader
+    {
+    public:
+        cMappedFileReader() : mData( nullptr ), mSize( 0 ), mPosition( 0 ), mPrefetchWindow( 0 ), mPrefetchEnd( 0 ) { }
+        virtual ~cMappedFileReader() { Close(); }
+
+        /// <summary>Map a file for reading.</summary>
+        bool            Open( const char *filename, unsigned long long prefetchWindow = kMappedReaderDefaultPrefetch )
+        {
+            Close();
+
+            if( !mFile.Open( filename ) )
+            {
+                return false;
+            }
+
+            mFile.Advise( cMemoryMappedFile::AccessSequential );
+
+            mData           = mFile.Data();
+            mSize           = mFile.Size();
+            mPrefetchWindow = prefetchWindow;
+            mPrefetchEnd    = 0;
+            UpdatePrefetch();
+
+            return true;
+        }
+
+        /// <summary>Read from a memory span owned by the caller, which must outlive the reader.</summary>
+        void            Attach( const unsigned char *data, unsigned long long size )
+        {
+            Close();
+            mData = data;
+            mSize = size;
+        }
+
+        void            Close()
+        {
+            mFile.Close();
+            mData        = nullptr;
+            mSize        = 0;
+            mPosition    = 0;
+            mPrefetchEnd = 0;
+        }
+
+        bool            IsOpen() const { return mData != nullptr; }
+
+        /// <summary>Pointer to the next 'size' bytes without advancing, or null if fewer remain.</summary>
+        const unsigned char * Peek( unsigned long long size ) const
+        {
+            return ( size <= mSize - mPosition ) ? mData + mPosition : nullptr;
+        }
+
+        /// <summary>Advance past 'size' bytes, typically after parsing them through Peek().</summary>
+        bool            Skip( unsigned long long size )
+        {
+            if( size > mSize - mPosition )
+            {
+                return false;
+            }
+            mPosition += size;
+            UpdatePrefetch();
+            return true;
+        }
+
+        const unsigned char * Data() const { return mData; }
+        unsigned long long Remaining() const { return mSize - mPosition; }
+
+        /// <summary>Non-virtual typed read for callers holding the concrete reader.</summary>
+        template<typename T> T Read()
+        {
+            T val = T();
+            if( sizeof( T ) <= mSize - mPosition )
+            {
+                memcpy( &val, mData + mPosition, sizeof( T ) );
+                mPosition += sizeof( T );
+            }
+            else
+            {
+                mPosition = mSize;
+            }
+            UpdatePrefetch();
+            return val;
+        }
+
+        //==============================================================================================
+        // Included interfaces
+        //==============================================================================================
+
+        // cIReader
+        virtual unsigned long long ReadData( unsigned char *buffer, unsigned long long bufferSize )
+        {
+            if( bufferSize > mSize - mPosition )
+            {
+                bufferSize = mSize - mPosition;
+            }
+            memcpy( buffer, mData + mPosition, (size_t) bufferSize );
+            mPosition += bufferSize;
+            UpdatePrefetch();
+            return bufferSize;
+        }
+        virtual int     ReadInt()                       { return Read<int>(); }
+        virtual long long ReadLongLong()                { return Read<long long>(); }
+        virtual long    ReadLong ()                     { return (long) Read<int>(); }
+        virtual short   ReadShort()                     { return Read<short>(); }
+        virtual double  ReadDouble()                    { return Read<double>(); }
+        virtual float   ReadFloat()                     { return Read<float>(); }
+        virtual bool    ReadBool()                      { return Read<unsigned char>() != 0; }
+        virtual unsigned char ReadByte()                { return Read<unsigned char>(); }
+        virtual bool    IsEOF() const                   { return mPosition >= mSize; }
+        virtual std::string ReadString()
+        {
+            int length = Read<int>();
+            if( length <= 0 || (unsigned long long) length > mSize - mPosition )
+            {
+                return std::string();
+            }
+            std::string str( (const char*) mData + mPosition, length );
+            mPosition += length;
+            UpdatePrefetch();
+            return str;
+        }
+        virtual std::wstring ReadWString()
+        {
+            int length = Read<int>();
+            std::wstring str;
+            if( length > 0 && (unsigned long long) length * sizeof( int ) <= mSize - mPosition )
+            {
+                str.resize( length );
+                for( int i = 0; i < length; ++i )
+                {
+                    str[ i ] = (wchar_t) Read<int>();
+                }
+            }
+            return str;
+        }
+        virtual cUID    ReadUID()
+        {
+            cUID::uint64 high = Read<cUID::uint64>();
+            cUID::uint64 low  = Read<cUID::uint64>();
+            return cUID( high, low );
+        }
+
+        // cIStream
+        virtual unsigned long long Tell() const         { return mPosition; }
+        virtual bool    Seek( unsigned long long pos )
+        {
+            if( pos > mSize )
+            {
+                return false;
+            }
+            mPosition = pos;
+            mPrefetchEnd = 0;
+            UpdatePrefetch();
+            return true;
+        }
+        virtual unsigned long long Size() const         { return mSize; }
+
+    private:
+        cMappedFileReader( const cMappedFileReader& );
+        cMappedFileReader& operator=( const cMappedFileReader& );
+
+        //== keep at least half a window of read-ahead in flight.  Called after every read, so the
+        //== common case of a position well inside the window is tested first ==--
+
+        void            UpdatePrefetch()
+        {
+            if( mPosition + mPrefetchWindow / 2 < mPrefetchEnd || mPrefetchWindow == 0 || !mFile.IsOpen()
+                || mPrefetchEnd >= mSize )
+            {
+                return;
+            }
+
+            unsigned long long start = ( mPrefetchEnd > mPosition ) ? mPrefetchEnd : mPosition;
+            unsigned long long end   = mPosition + mPrefetchWindow;
+            if( end > mSize )
+            {
+                end = mSize;
+            }
+
+            mFile.Prefetch( start, end - start );
+            mPrefetchEnd = end;
+        }
+
+        cMemoryMappedFile   mFile;
+        const unsigned char * mData;
+        unsigned long long  mSize;
+        unsigned long long  mPosition;
+        unsigned long long  mPrefetchWindow;
+        unsigned long long  mPrefetchEnd;
+    };
+}
@@ -0,0 +1,217 @@
+//======================================================================================================
+// Copyright 2018, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Local includes
+#include "Core/BuildConfig.h"
+
+namespace Core
+{
+    /// <summary>
+    /// A platform-neutral, read-only view of an entire file mapped into the address space. Pages are
+    /// faulted in by the operating system on first access, so opening a multi-gigabyte file is cheap
+    /// and data is never copied into an intermediate buffer.
+    /// </summary>
+    class cMemoryMappedFile
+    {
+    public:
+        enum eAccessPattern
+        {
+            AccessNormal = 0,
+            AccessSequential,
+            AccessRandom
+        };
+
+        cMemoryMappedFile() : mData( nullptr ), mSize( 0 )
+#ifdef WIN32
+            , mFile( INVALID_HANDLE_VALUE ), mMapping( nullptr )
+#else
+            , mFile( -1 )
+#endif
+        {
+        }
+
+        ~cMemoryMappedFile()
+        {
+            Close();
+        }
+
+        /// <summary>
+        /// Map the named file. When copyOnWrite is set the view is writable, but writes land in private
+        /// pages and never reach the file. This allows handing mapped buffers to code that takes a
+        /// non-const pointer.
+        /// </summary>
+        bool            Open( const char *filename, bool copyOnWrite = false )
+        {
+            Close();
+
+#ifdef WIN32
+            mFile = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL, nullptr );
+            if( mFile == INVALID_HANDLE_VALUE )
+            {
+                return false;
+            }
+
+            LARGE_INTEGER size;
+            if( !GetFileSizeEx( mFile, &size ) || size.QuadPart == 0 )
+            {
+                Close();
+                return false;
+            }
+            mSize = (unsigned long long) size.QuadPart;
+
+            mMapping = CreateFileMappingA( mFile, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr );
+            if( mMapping == nullptr )
+            {
+                Close();
+                return false;
+            }
+
+            mData = (unsigned char*) MapViewOfFile( mMapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0 );
+#else
+            mFile = open( filename, O_RDONLY );
+            if( mFile < 0 )
+            {
+                return false;
+            }
+
+            struct stat info;
+            if( fstat( mFile, &info ) != 0 || info.st_size == 0 )
+            {
+                Close();
+                return false;
+            }
+            mSize = (unsigned long long) info.st_size;
+
+            void *view = mmap( nullptr, (size_t) mSize, copyOnWrite ? ( PROT_READ | PROT_WRITE ) : PROT_READ,
+                MAP_PRIVATE, mFile, 0 );
+            mData = ( view == MAP_FAILED ) ? nullptr : (unsigned char*) view;
+#endif
+
+            if( mData == nullptr )
+            {
+                Close();
+                return false;
+            }
+
+            return true;
+        }
+
+        void            Close()
+        {
+#ifdef WIN32
+            if( mData )
+            {
+                UnmapViewOfFile( mData );
+            }
+            if( mMapping )
+            {
+                CloseHandle( mMapping );
+            }
+            if( mFile != INVALID_HANDLE_VALUE )
+            {
+                CloseHandle( mFile );
+            }
+            mMapping = nullptr;
+            mFile = INVALID_HANDLE_VALUE;
+#else
+            if( mData )
+            {
+                munmap( mData, (size_t) mSize );
+            }
+            if( mFile >= 0 )
+            {
+                close( mFile );
+            }
+            mFile = -1;
+#endif
+            mData = nullptr;
+            mSize = 0;
+        }
+
+        bool            IsOpen() const { return mData != nullptr; }
+
+        unsigned char * Data() const { return mData; }
+        unsigned long long Size() const { return mSize; }
+
+        /// <summary>Hint the expected access pattern for the whole mapping to the virtual memory system.</summary>
+        void            Advise( eAccessPattern pattern ) const
+        {
+#ifndef WIN32
+            if( mData )
+            {
+                int advice = MADV_NORMAL;
+                if( pattern == AccessSequential )
+                {
+                    advice = MADV_SEQUENTIAL;
+                }
+                else if( pattern == AccessRandom )
+                {
+                    advice = MADV_RANDOM;
+                }
+                madvise( mData, (size_t) mSize, advice );
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Ask the virtual memory system to start reading the given range in the background so that
+        /// a later access does not stall on a page fault.
+        /// </summary>
+        void            Prefetch( unsigned long long offset, unsigned long long length ) const
+        {
+            if( mData == nullptr || offset >= mSize )
+            {
+                return;
+            }
+            if( length > mSize - offset )
+            {
+                length = mSize - offset;
+            }
+
+#ifdef WIN32
+#if _WIN32_WINNT >= 0x0602
+            WIN32_MEMORY_RANGE_ENTRY range;
+            range.VirtualAddress = mData + offset;
+            range.NumberOfBytes = (SIZE_T) length;
+            PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+#endif
+#else
+            //== madvise requires a page aligned start address ==--
+            const unsigned long long pageSize = (unsigned long long) sysconf( _SC_PAGESIZE );
+            const unsigned long long alignedOffset = offset - ( offset % pageSize );
+            madvise( mData + alignedOffset, (size_t) ( length + offset - alignedOffset ), MADV_WILLNEED );
+#endif
+        }
+
+    private:
+        unsigned char * mData;
+        unsigned long long mSize;
+
+#ifdef WIN32
+        HANDLE          mFile;
+        HANDLE          mMapping;
+#else
+        int             mFile;
+#endif
+
+        // Disallow copy construction and assignment
+        cMemoryMappedFile( const cMemoryMappedFile& other );
+        cMemoryMappedFile& operator=( const cMemoryMappedFile& other );
+    };
+}
@@ -0,0 +1,334 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <string.h>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/Frame.h"
+#include "Core/SIMD.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Unpacks the per pixel intensities of Precision and BitPackedPrecision segment data into
+    /// 8 bit samples, applying the grayscale floor (Camera::SetGrayscaleFloor) in the same pass:
+    /// samples below the floor become 0.
+    ///
+    /// Sample format. The cameras' own precision packets are parsed inside the library
+    /// (ProcessPrecisionPacket) and their layout is not published, so this is the format these
+    /// kernels define; callers lay their sample data out this way:
+    ///   PrecisionMode           byte i is sample i.
+    ///   BitPackedPrecisionMode  6 bit samples, 4 per 3 bytes. Bytes 3k..3k+2 form the little
+    ///                           endian group g = b0 | b1 &lt;&lt; 8 | b2 &lt;&lt; 16 and sample 4k+j is
+    ///                           ( g &gt;&gt; 6j ) &amp; 63, i.e. (bit 7 .. bit 0)
+    ///                             byte 3k     s1[1:0] s0[5:0]
+    ///                             byte 3k+1   s2[3:0] s1[5:2]
+    ///                             byte 3k+2   s3[5:0] s2[5:4]
+    ///                           n samples take ceil( 6n / 8 ) bytes; unused bits of the last
+    ///                           byte are ignored. Samples are widened to 8 bits as
+    ///                           ( s &lt;&lt; 2 ) | ( s &gt;&gt; 4 ), so 0 stays 0 and 63 becomes 255.
+    ///
+    /// The SSSE3 and AVX2 kernels gather each 3 byte group into a 32 bit lane with one pshufb and
+    /// are chosen at run time; the NEON kernel deinterleaves the groups with vld3. All kernels
+    /// produce identical output.
+    /// </summary>
+    class cPrecisionUnpack
+    {
+    public:
+        typedef void ( *UnpackKernel )( const unsigned char *packed, unsigned char *samples, int count, int floor );
+
+        /// <summary>Bytes holding 'count' samples in a mode, -1 for modes without packed samples.</summary>
+        static int PackedSize( eVideoMode mode, int count )
+        {
+            switch( mode )
+            {
+            case PrecisionMode:
+                return count;
+            case BitPackedPrecisionMode:
+                return (int) ( ( (long long) count * 6 + 7 ) / 8 );
+            default:
+                return -1;
+            }
+        }
+
+        static UnpackKernel Kernel( eVideoMode mode, eSIMDLevel level = BestSIMDLevel() )
+        {
+            switch( mode )
+            {
+            case PrecisionMode:
+#if defined( CORE_SIMD_AVX2 )
+                if( level >= SIMDAVX2 && IsSIMDLevelSupported( SIMDAVX2 ) ) return Unpack8AVX2;
+#endif
+#if defined( CORE_SIMD_SSE2 )
+                if( level >= SIMDSSE2 ) return Unpack8SSE2;
+#endif
+#if defined( CORE_SIMD_NEON )
+                if( level >= SIMDNEON ) return Unpack8NEON;
+#endif
+                return Unpack8;
+            case BitPackedPrecisionMode:
+#if defined( CORE_SIMD_AVX2 )
+                if( level >= SIMDAVX2 && IsSIMDLevelSupported( SIMDAVX2 ) ) return Unpack6AVX2;
+#endif
+#if defined( CORE_SIMD_SSSE3 )
+                if( level >= SIMDSSSE3 && IsSIMDLevelSupported( SIMDSSSE3 ) ) return Unpack6SSSE3;
+#endif
+#if defined( CORE_SIMD_NEON )
+                if( level >= SIMDNEON ) return Unpack6NEON;
+#endif
+                return Unpack6;
+            default:
+                return nullptr;
+            }
+        }
+
+        /// <summary>
+        /// Unpack 'count' samples. Returns the packed bytes consumed, or -1 if the mode has no
+        /// packed samples or 'packedSize' is too small.
+        /// </summary>
+        static int Unpack( eVideoMode mode, const unsigned char *packed, int packedSize, unsigned char *samples, int count,
+                           int floor = 0, eSIMDLevel level = BestSIMDLevel() )
+        {
+            int needed = PackedSize( mode, count );
+            UnpackKernel kernel = Kernel( mode, level );
+
+            if( needed < 0 || !kernel || packedSize < needed )
+            {
+                return -1;
+            }
+
+            kernel( packed, samples, count, floor );
+            return needed;
+        }
+
+        //== scalar kernels, also used for the tails of the vector kernels ==--
+
+        static void Unpack8( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            for( int i = 0; i < count; ++i )
+            {
+                samples[ i ] = ( packed[ i ] >= floor ) ? packed[ i ] : 0;
+            }
+        }
+
+        static void Unpack6( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            int i = 0;
+            for( ; i + 4 <= count; i += 4, packed += 3 )
+            {
+                unsigned int group = packed[ 0 ] | ( packed[ 1 ] << 8 ) | ( packed[ 2 ] << 16 );
+                samples[ i ]     = Widen( group & 63, floor );
+                samples[ i + 1 ] = Widen( ( group >> 6 ) & 63, floor );
+                samples[ i + 2 ] = Widen( ( group >> 12 ) & 63, floor );
+                samples[ i + 3 ] = Widen( group >> 18, floor );
+            }
+
+            //== last partial group, reading only the bytes it occupies ==--
+
+            unsigned int group = 0;
+            for( int b = 0; b < ( ( count - i ) * 6 + 7 ) / 8; ++b )
+            {
+                group |= (unsigned int) packed[ b ] << ( 8 * b );
+            }
+            for( int s = 0; i < count; ++i, ++s )
+            {
+                samples[ i ] = Widen( ( group >> ( 6 * s ) ) & 63, floor );
+            }
+        }
+
+#if defined( CORE_SIMD_SSE2 )
+        static void Unpack8SSE2( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            floor = ( floor < 0 ) ? 0 : floor;
+
+            if( floor > 255 )
+            {
+                memset( samples, 0, count );
+                return;
+            }
+
+            const __m128i limit = _mm_set1_epi8( (char) floor );
+            const __m128i all   = _mm_set1_epi8( (char) 0xFF );
+
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                //== keep samples where max( sample, floor ) == sample ==--
+
+                __m128i v = _mm_loadu_si128( (const __m128i*) ( packed + i ) );
+                __m128i keep = floor > 0 ? _mm_cmpeq_epi8( _mm_max_epu8( v, limit ), v ) : all;
+                _mm_storeu_si128( (__m128i*) ( samples + i ), _mm_and_si128( v, keep ) );
+            }
+            Unpack8( packed + i, samples + i, count - i, floor );
+        }
+#endif
+
+#if defined( CORE_SIMD_SSSE3 )
+        CORE_TARGET_SSSE3 static void Unpack6SSSE3( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            floor = ( floor < 0 ) ? 0 : floor;
+
+            //== bytes 3k, 3k+1, 3k+2 into dword k, then each 6 bit field moved to its own byte ==--
+
+            const __m128i gather = _mm_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+            const __m128i field0 = _mm_set1_epi32( 0x0000003F );
+            const __m128i field1 = _mm_set1_epi32( 0x00003F00 );
+            const __m128i field2 = _mm_set1_epi32( 0x003F0000 );
+            const __m128i field3 = _mm_set1_epi32( 0x3F000000 );
+            const __m128i high   = _mm_set1_epi8( (char) 0xFC );
+            const __m128i low    = _mm_set1_epi8( 0x03 );
+            const __m128i limit  = _mm_set1_epi8( (char) ( floor > 255 ? 255 : floor ) );
+            const bool    zero   = floor > 255;
+
+            //== each iteration reads 16 bytes, i.e. 4 beyond the 12 it consumes ==--
+
+            int i = 0;
+            int bytes = PackedSize( BitPackedPrecisionMode, count );
+            for( ; i + 16 <= count && 3 * ( i / 4 ) + 16 <= bytes; i += 16 )
+            {
+                __m128i v = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*) ( packed + 3 * ( i / 4 ) ) ), gather );
+
+                __m128i s = _mm_or_si128( _mm_or_si128( _mm_and_si128( v, field0 ),
+                                                        _mm_and_si128( _mm_slli_epi32( v, 2 ), field1 ) ),
+                                          _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 4 ), field2 ),
+                                                        _mm_and_si128( _mm_slli_epi32( v, 6 ), field3 ) ) );
+
+                //== widen ( s << 2 ) | ( s >> 4 ) per byte, then the floor ==--
+
+                s = _mm_or_si128( _mm_and_si128( _mm_slli_epi16( s, 2 ), high ),
+                                  _mm_and_si128( _mm_srli_epi16( s, 4 ), low ) );
+                s = zero ? _mm_setzero_si128() : _mm_and_si128( s, _mm_cmpeq_epi8( _mm_max_epu8( s, limit ), s ) );
+
+                _mm_storeu_si128( (__m128i*) ( samples + i ), s );
+            }
+            Unpack6( packed + 3 * ( i / 4 ), samples + i, count - i, floor );
+        }
+#endif
+
+#if defined( CORE_SIMD_AVX2 )
+        CORE_TARGET_AVX2 static void Unpack8AVX2( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            floor = ( floor < 0 ) ? 0 : floor;
+
+            if( floor > 255 )
+            {
+                memset( samples, 0, count );
+                return;
+            }
+
+            const __m256i limit = _mm256_set1_epi8( (char) floor );
+
+            int i = 0;
+            for( ; i + 32 <= count; i += 32 )
+            {
+                __m256i v = _mm256_loadu_si256( (const __m256i*) ( packed + i ) );
+                _mm256_storeu_si256( (__m256i*) ( samples + i ), _mm256_and_si256( v, _mm256_cmpeq_epi8( _mm256_max_epu8( v, limit ), v ) ) );
+            }
+            Unpack8( packed + i, samples + i, count - i, floor );
+        }
+
+        CORE_TARGET_AVX2 static void Unpack6AVX2( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            floor = ( floor < 0 ) ? 0 : floor;
+
+            //== per 128 bit lane: bytes 3k, 3k+1, 3k+2 into dword k, then each 6 bit field moved to its own byte ==--
+
+            const __m256i gather = _mm256_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                     0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+            const __m256i field0 = _mm256_set1_epi32( 0x0000003F );
+            const __m256i field1 = _mm256_set1_epi32( 0x00003F00 );
+            const __m256i field2 = _mm256_set1_epi32( 0x003F0000 );
+            const __m256i field3 = _mm256_set1_epi32( 0x3F000000 );
+            const __m256i high   = _mm256_set1_epi8( (char) 0xFC );
+            const __m256i low    = _mm256_set1_epi8( 0x03 );
+            const __m256i limit  = _mm256_set1_epi8( (char) ( floor > 255 ? 255 : floor ) );
+            const bool    zero   = floor > 255;
+
+            //== each iteration reads 16 bytes from packed + 12, i.e. 4 beyond the 24 it consumes ==--
+
+            int i = 0;
+            int bytes = PackedSize( BitPackedPrecisionMode, count );
+            for( ; i + 32 <= count && 3 * ( i / 4 ) + 28 <= bytes; i += 32 )
+            {
+                const unsigned char *group = packed + 3 * ( i / 4 );
+
+                __m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*) group ) ),
+                                                     _mm_loadu_si128( (const __m128i*) ( group + 12 ) ), 1 );
+                v = _mm256_shuffle_epi8( v, gather );
+
+                __m256i s = _mm256_or_si256( _mm256_or_si256( _mm256_and_si256( v, field0 ),
+                                                              _mm256_and_si256( _mm256_slli_epi32( v, 2 ), field1 ) ),
+                                             _mm256_or_si256( _mm256_and_si256( _mm256_slli_epi32( v, 4 ), field2 ),
+                                                              _mm256_and_si256( _mm256_slli_epi32( v, 6 ), field3 ) ) );
+
+                //== widen ( s << 2 ) | ( s >> 4 ) per byte, then the floor ==--
+
+                s = _mm256_or_si256( _mm256_and_si256( _mm256_slli_epi16( s, 2 ), high ),
+                                     _mm256_and_si256( _mm256_srli_epi16( s, 4 ), low ) );
+                s = zero ? _mm256_setzero_si256() : _mm256_and_si256( s, _mm256_cmpeq_epi8( _mm256_max_epu8( s, limit ), s ) );
+
+                _mm256_storeu_si256( (__m256i*) ( samples + i ), s );
+            }
+            Unpack6( packed + 3 * ( i / 4 ), samples + i, count - i, floor );
+        }
+#endif
+
+#if defined( CORE_SIMD_NEON )
+        static void Unpack8NEON( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            floor = ( floor < 0 ) ? 0 : floor;
+
+            const uint8x16_t limit = vdupq_n_u8( (unsigned char) ( floor > 255 ? 255 : floor ) );
+            const bool       zero  = floor > 255;
+
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                uint8x16_t v = vld1q_u8( packed + i );
+                vst1q_u8( samples + i, zero ? vdupq_n_u8( 0 ) : vandq_u8( v, vcgeq_u8( v, limit ) ) );
+            }
+            Unpack8( packed + i, samples + i, count - i, floor );
+        }
+
+        static void Unpack6NEON( const unsigned char *packed, unsigned char *samples, int count, int floor )
+        {
+            floor = ( floor < 0 ) ? 0 : floor;
+
+            const uint8x16_t limit = vdupq_n_u8( (unsigned char) ( floor > 255 ? 255 : floor ) );
+            const uint8x16_t mask  = vdupq_n_u8( 63 );
+            const bool       zero  = floor > 255;
+
+            int i = 0;
+            for( ; i + 64 <= count; i += 64 )
+            {
+                uint8x16x3_t bytes = vld3q_u8( packed + 3 * ( i / 4 ) );
+                uint8x16x4_t out;
+
+                out.val[ 0 ] = vandq_u8( bytes.val[ 0 ], mask );
+                out.val[ 1 ] = vorrq_u8( vshrq_n_u8( bytes.val[ 0 ], 6 ), vandq_u8( vshlq_n_u8( bytes.val[ 1 ], 2 ), mask ) );
+                out.val[ 2 ] = vorrq_u8( vshrq_n_u8( bytes.val[ 1 ], 4 ), vandq_u8( vshlq_n_u8( bytes.val[ 2 ], 4 ), mask ) );
+                out.val[ 3 ] = vshrq_n_u8( bytes.val[ 2 ], 2 );
+
+                for( int k = 0; k < 4; ++k )
+                {
+                    uint8x16_t s = vorrq_u8( vshlq_n_u8( out.val[ k ], 2 ), vshrq_n_u8( out.val[ k ], 4 ) );
+                    out.val[ k ] = zero ? vdupq_n_u8( 0 ) : vandq_u8( s, vcgeq_u8( s, limit ) );
+                }
+                vst4q_u8( samples + i, out );
+            }
+            Unpack6( packed + 3 * ( i / 4 ), samples + i, count - i, floor );
+        }
+#endif
+
+    private:
+        static unsigned char Widen( unsigned int sample, int floor )
+        {
+            int value = (int) ( ( sample << 2 ) | ( sample >> 4 ) );
+            return (unsigned char) ( ( value >= floor ) ? value : 0 );
+        }
+    };
+}
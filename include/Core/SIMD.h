@@ -0,0 +1,133 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// Local includes
+#include "Core/BuildConfig.h"
+
+//== Compile time SIMD selection.  Kernels test these and keep a scalar path for everything else;
+//== define CORE_DISABLE_SIMD to force the scalar paths (e.g. to validate them).
+
+#if !defined( CORE_DISABLE_SIMD )
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+    #define CORE_SIMD_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+#if ( defined( __ARM_NEON ) || defined( __ARM_NEON__ ) ) && ( defined( __aarch64__ ) || defined( _M_ARM64 ) )
+    #define CORE_SIMD_NEON 1
+    #include <arm_neon.h>
+#endif
+
+//== SSSE3 and AVX2 kernels are compiled alongside the baseline and only called after the runtime
+//== check below; CORE_TARGET_SSSE3 / CORE_TARGET_AVX2 mark them so GCC/Clang generate code for
+//== that instruction set in just those functions.
+
+#if defined( CORE_SIMD_SSE2 ) && ( defined( _MSC_VER ) || defined( __GNUC__ ) || defined( __clang__ ) )
+    #define CORE_SIMD_SSSE3 1
+    #define CORE_SIMD_AVX2 1
+    #include <immintrin.h>
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        #include <intrin.h>
+        #define CORE_TARGET_SSSE3
+        #define CORE_TARGET_AVX2
+    #else
+        #define CORE_TARGET_SSSE3 __attribute__(( target( "ssse3" ) ))
+        #define CORE_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+    #endif
+#endif
+
+#endif
+
+namespace Core
+{
+    /// <summary>Instruction sets a kernel can be run with, in increasing order of preference.</summary>
+    enum eSIMDLevel
+    {
+        SIMDScalar = 0,
+        SIMDNEON,
+        SIMDSSE2,
+        SIMDSSSE3,
+        SIMDAVX2
+    };
+
+    /// <summary>True if this build contains kernels for the level and the CPU running it supports them.</summary>
+    inline bool IsSIMDLevelSupported( eSIMDLevel level )
+    {
+        switch( level )
+        {
+        case SIMDScalar:
+            return true;
+#if defined( CORE_SIMD_NEON )
+        case SIMDNEON:
+            return true;
+#endif
+#if defined( CORE_SIMD_SSE2 )
+        case SIMDSSE2:
+            return true;
+#endif
+#if defined( CORE_SIMD_SSSE3 )
+        case SIMDSSSE3:
+        {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+            int info[ 4 ];
+            __cpuid( info, 1 );
+            return ( info[ 2 ] & ( 1 << 9 ) ) != 0;
+#else
+            return __builtin_cpu_supports( "ssse3" ) != 0;
+#endif
+        }
+#endif
+#if defined( CORE_SIMD_AVX2 )
+        case SIMDAVX2:
+        {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+            //== AVX2 needs the CPU feature and OS support for saving the YMM registers ==--
+
+            int info[ 4 ];
+            __cpuid( info, 0 );
+            if( info[ 0 ] < 7 )
+            {
+                return false;
+            }
+            __cpuid( info, 1 );
+            if( ( info[ 2 ] & ( 1 << 27 ) ) == 0 || ( _xgetbv( 0 ) & 6 ) != 6 )
+            {
+                return false;
+            }
+            __cpuidex( info, 7, 0 );
+            return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+            return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+        }
+#endif
+        default:
+            return false;
+        }
+    }
+
+    /// <summary>Best level supported here, detected once. CORE_DISABLE_SIMD builds always report SIMDScalar.</summary>
+    inline eSIMDLevel BestSIMDLevel()
+    {
+        static const eSIMDLevel best = IsSIMDLevelSupported( SIMDAVX2 )  ? SIMDAVX2
+                                     : IsSIMDLevelSupported( SIMDSSSE3 ) ? SIMDSSSE3
+                                     : IsSIMDLevelSupported( SIMDSSE2 ) ? SIMDSSE2
+                                     : IsSIMDLevelSupported( SIMDNEON ) ? SIMDNEON : SIMDScalar;
+        return best;
+    }
+
+    inline const char * SIMDLevelName( eSIMDLevel level )
+    {
+        switch( level )
+        {
+        case SIMDNEON: return "NEON";
+        case SIMDSSE2: return "SSE2";
+        case SIMDSSSE3: return "SSSE3";
+        case SIMDAVX2: return "AVX2";
+        default:       return "Scalar";
+        }
+    }
+}
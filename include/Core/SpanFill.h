@@ -0,0 +1,325 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <string.h>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/SIMD.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Fills or blends runs of pixels with one value using wide stores. Runs of at least one vector are
+    /// written with unaligned vector stores, the last of which overlaps the previous one instead of
+    /// falling back to a scalar tail, so short segment runs cost only a couple of stores.
+    /// </summary>
+    class cSpanFill
+    {
+    public:
+        static void Fill8( unsigned char *destination, int count, unsigned char value )
+        {
+            if( count > 0 )
+            {
+                memset( destination, value, count );
+            }
+        }
+
+        static void Fill16( unsigned char *destination, int count, unsigned short value )
+        {
+#if defined( CORE_SIMD_SSE2 )
+            if( count >= 8 )
+            {
+                FillVector( destination, count * 2, _mm_set1_epi16( (short) value ) );
+                return;
+            }
+#elif defined( CORE_SIMD_NEON )
+            if( count >= 8 )
+            {
+                FillVector( destination, count * 2, vreinterpretq_u8_u16( vdupq_n_u16( value ) ) );
+                return;
+            }
+#endif
+            for( int i = 0; i < count; ++i )
+            {
+                memcpy( destination + 2 * i, &value, 2 );
+            }
+        }
+
+        static void Fill24( unsigned char *destination, int count, const unsigned char *rgb )
+        {
+            int i = 0;
+#if defined( CORE_SIMD_SSE2 ) || defined( CORE_SIMD_NEON )
+            if( count >= 16 )
+            {
+                //== 16 pixels are exactly three vectors of the repeating 3 byte pattern ==--
+
+                unsigned char pattern[ 49 ];
+                const unsigned char word[ 4 ] = { rgb[ 0 ], rgb[ 1 ], rgb[ 2 ], rgb[ 0 ] };
+                for( int j = 0; j < 16; ++j )
+                {
+                    memcpy( pattern + 3 * j, word, 4 );
+                }
+#if defined( CORE_SIMD_SSE2 )
+                const __m128i p0 = _mm_loadu_si128( (const __m128i*) ( pattern ) );
+                const __m128i p1 = _mm_loadu_si128( (const __m128i*) ( pattern + 16 ) );
+                const __m128i p2 = _mm_loadu_si128( (const __m128i*) ( pattern + 32 ) );
+                for( ; i + 16 <= count; i += 16 )
+                {
+                    _mm_storeu_si128( (__m128i*) ( destination + 3 * i ),      p0 );
+                    _mm_storeu_si128( (__m128i*) ( destination + 3 * i + 16 ), p1 );
+                    _mm_storeu_si128( (__m128i*) ( destination + 3 * i + 32 ), p2 );
+                }
+#else
+                const uint8x16_t p0 = vld1q_u8( pattern );
+                const uint8x16_t p1 = vld1q_u8( pattern + 16 );
+                const uint8x16_t p2 = vld1q_u8( pattern + 32 );
+                for( ; i + 16 <= count; i += 16 )
+                {
+                    vst1q_u8( destination + 3 * i,      p0 );
+                    vst1q_u8( destination + 3 * i + 16, p1 );
+                    vst1q_u8( destination + 3 * i + 32, p2 );
+                }
+#endif
+            }
+#endif
+
+            //== 4 byte stores 3 bytes apart, each overwriting the previous store's spare byte ==--
+
+            if( i < count )
+            {
+                const unsigned char word[ 4 ] = { rgb[ 0 ], rgb[ 1 ], rgb[ 2 ], rgb[ 0 ] };
+                for( ; i < count - 1; ++i )
+                {
+                    memcpy( destination + 3 * i, word, 4 );
+                }
+                destination[ 3 * i ]     = rgb[ 0 ];
+                destination[ 3 * i + 1 ] = rgb[ 1 ];
+                destination[ 3 * i + 2 ] = rgb[ 2 ];
+            }
+        }
+
+        static void Fill32( unsigned char *destination, int count, unsigned int value )
+        {
+#if defined( CORE_SIMD_SSE2 )
+            if( count >= 4 )
+            {
+                FillVector( destination, count * 4, _mm_set1_epi32( (int) value ) );
+                return;
+            }
+#elif defined( CORE_SIMD_NEON )
+            if( count >= 4 )
+            {
+                FillVector( destination, count * 4, vreinterpretq_u8_u32( vdupq_n_u32( value ) ) );
+                return;
+            }
+#endif
+            for( int i = 0; i < count; ++i )
+            {
+                memcpy( destination + 4 * i, &value, 4 );
+            }
+        }
+
+        /// <summary>Fill 'count' pixels of 'bytesPerPixel' (1-4) bytes each with the pixel at 'pixel'.</summary>
+        static void Fill( unsigned char *destination, int count, int bytesPerPixel, const unsigned char *pixel )
+        {
+            switch( bytesPerPixel )
+            {
+            case 1:
+                Fill8( destination, count, pixel[ 0 ] );
+                break;
+            case 2:
+            {
+                unsigned short value;
+                memcpy( &value, pixel, 2 );
+                Fill16( destination, count, value );
+                break;
+            }
+            case 3:
+                Fill24( destination, count, pixel );
+                break;
+            case 4:
+            {
+                unsigned int value;
+                memcpy( &value, pixel, 4 );
+                Fill32( destination, count, value );
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        /// <summary>One pixel repeated over 48 bytes, a whole number of 1, 2, 3 and 4 byte pixels.</summary>
+        struct sPattern
+        {
+            unsigned char   Bytes[ 48 ];
+            int             BytesPerPixel;
+        };
+
+        static void MakePattern( const unsigned char *pixel, int bytesPerPixel, sPattern &pattern )
+        {
+            pattern.BytesPerPixel = bytesPerPixel;
+            for( int j = 0, k = 0; j < 48; ++j )
+            {
+                pattern.Bytes[ j ] = pixel[ k ];
+                k = ( k + 1 >= bytesPerPixel ) ? 0 : k + 1;
+            }
+        }
+
+        /// <summary>
+        /// Blend 'count' pixels towards the pixel at 'pixel' by alpha (0-255): out = (p * a + d * (255 - a)) / 255,
+        /// rounded. 8, 24 and 32 bit pixels blend byte by byte; 16 bit pixels are RGB 5:6:5 and blend per field.
+        /// Callers blending many runs of one color should make its sPattern once and use the overload below.
+        /// </summary>
+        static void Blend( unsigned char *destination, int count, int bytesPerPixel, const unsigned char *pixel, int alpha )
+        {
+            sPattern pattern;
+            MakePattern( pixel, bytesPerPixel, pattern );
+            Blend( destination, count, pattern, alpha );
+        }
+
+        static void Blend( unsigned char *destination, int count, const sPattern &pattern, int alpha )
+        {
+            const int bytesPerPixel = pattern.BytesPerPixel;
+            const unsigned char *pixel = pattern.Bytes;
+
+            if( alpha >= 255 )
+            {
+                Fill( destination, count, bytesPerPixel, pixel );
+                return;
+            }
+            if( alpha <= 0 || count <= 0 )
+            {
+                return;
+            }
+
+            if( bytesPerPixel == 2 )
+            {
+                Blend565( destination, count, pixel, alpha );
+                return;
+            }
+            if( bytesPerPixel < 1 || bytesPerPixel > 4 )
+            {
+                return;
+            }
+
+            const int bytes = count * bytesPerPixel;
+            int i = 0;
+#if defined( CORE_SIMD_SSE2 ) || defined( CORE_SIMD_NEON )
+            if( bytes >= 16 )
+            {
+#if defined( CORE_SIMD_SSE2 )
+                const __m128i zero    = _mm_setzero_si128();
+                const __m128i weight  = _mm_set1_epi16( (short) alpha );
+                const __m128i inverse = _mm_set1_epi16( (short) ( 255 - alpha ) );
+                const __m128i round   = _mm_set1_epi16( 128 );
+                const __m128i source[ 3 ] =
+                {
+                    _mm_loadu_si128( (const __m128i*) ( pixel ) ),
+                    _mm_loadu_si128( (const __m128i*) ( pixel + 16 ) ),
+                    _mm_loadu_si128( (const __m128i*) ( pixel + 32 ) )
+                };
+                for( int k = 0; i + 16 <= bytes; i += 16, k = ( k == 2 ) ? 0 : k + 1 )
+                {
+                    __m128i d  = _mm_loadu_si128( (const __m128i*) ( destination + i ) );
+                    __m128i lo = BlendHalf( _mm_unpacklo_epi8( source[ k ], zero ), _mm_unpacklo_epi8( d, zero ), weight, inverse, round );
+                    __m128i hi = BlendHalf( _mm_unpackhi_epi8( source[ k ], zero ), _mm_unpackhi_epi8( d, zero ), weight, inverse, round );
+                    _mm_storeu_si128( (__m128i*) ( destination + i ), _mm_packus_epi16( lo, hi ) );
+                }
+#else
+                const uint8x8_t  weight  = vdup_n_u8( (unsigned char) alpha );
+                const uint8x8_t  inverse = vdup_n_u8( (unsigned char) ( 255 - alpha ) );
+                const uint16x8_t round   = vdupq_n_u16( 128 );
+                const uint8x16_t source[ 3 ] = { vld1q_u8( pixel ), vld1q_u8( pixel + 16 ), vld1q_u8( pixel + 32 ) };
+                for( int k = 0; i + 16 <= bytes; i += 16, k = ( k == 2 ) ? 0 : k + 1 )
+                {
+                    uint8x16_t d  = vld1q_u8( destination + i );
+                    uint16x8_t lo = vaddq_u16( vmlal_u8( vmull_u8( vget_low_u8( source[ k ] ),  weight ), vget_low_u8( d ),  inverse ), round );
+                    uint16x8_t hi = vaddq_u16( vmlal_u8( vmull_u8( vget_high_u8( source[ k ] ), weight ), vget_high_u8( d ), inverse ), round );
+                    vst1q_u8( destination + i, vcombine_u8( vshrn_n_u16( vsraq_n_u16( lo, lo, 8 ), 8 ),
+                                                            vshrn_n_u16( vsraq_n_u16( hi, hi, 8 ), 8 ) ) );
+                }
+#endif
+            }
+#endif
+            for( int k = i % bytesPerPixel; i < bytes; ++i )
+            {
+                destination[ i ] = BlendByte( pixel[ k ], destination[ i ], alpha );
+                k = ( k + 1 == bytesPerPixel ) ? 0 : k + 1;
+            }
+        }
+
+    private:
+        static unsigned char BlendByte( unsigned int source, unsigned int destination, int alpha )
+        {
+            unsigned int t = source * alpha + destination * ( 255 - alpha ) + 128;
+            return (unsigned char) ( ( t + ( t >> 8 ) ) >> 8 );
+        }
+
+        static void Blend565( unsigned char *destination, int count, const unsigned char *pixel, int alpha )
+        {
+            unsigned short value;
+            memcpy( &value, pixel, 2 );
+
+            const unsigned int r = value >> 11, g = ( value >> 5 ) & 63, b = value & 31;
+
+            for( int i = 0; i < count; ++i )
+            {
+                unsigned short d;
+                memcpy( &d, destination + 2 * i, 2 );
+                unsigned int dr = d >> 11, dg = ( d >> 5 ) & 63, db = d & 31;
+                d = (unsigned short) ( ( BlendByte( r, dr, alpha ) << 11 ) | ( BlendByte( g, dg, alpha ) << 5 ) | BlendByte( b, db, alpha ) );
+                memcpy( destination + 2 * i, &d, 2 );
+            }
+        }
+
+#if defined( CORE_SIMD_SSE2 )
+        static __m128i BlendHalf( __m128i source, __m128i destination, __m128i weight, __m128i inverse, __m128i round )
+        {
+            __m128i t = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( source, weight ), _mm_mullo_epi16( destination, inverse ) ), round );
+            return _mm_srli_epi16( _mm_add_epi16( t, _mm_srli_epi16( t, 8 ) ), 8 );
+        }
+#endif
+
+        //== bytes >= 16, and a whole number of pixels so the overlapping last store rewrites the same values ==--
+
+#if defined( CORE_SIMD_SSE2 )
+        static void FillVector( unsigned char *destination, int bytes, __m128i value )
+        {
+            int i = 0;
+            for( ; i + 64 <= bytes; i += 64 )
+            {
+                _mm_storeu_si128( (__m128i*) ( destination + i ),      value );
+                _mm_storeu_si128( (__m128i*) ( destination + i + 16 ), value );
+                _mm_storeu_si128( (__m128i*) ( destination + i + 32 ), value );
+                _mm_storeu_si128( (__m128i*) ( destination + i + 48 ), value );
+            }
+            for( ; i + 16 <= bytes; i += 16 )
+            {
+                _mm_storeu_si128( (__m128i*) ( destination + i ), value );
+            }
+            if( i < bytes )
+            {
+                _mm_storeu_si128( (__m128i*) ( destination + bytes - 16 ), value );
+            }
+        }
+#elif defined( CORE_SIMD_NEON )
+        static void FillVector( unsigned char *destination, int bytes, uint8x16_t value )
+        {
+            int i = 0;
+            for( ; i + 16 <= bytes; i += 16 )
+            {
+                vst1q_u8( destination + i, value );
+            }
+            if( i < bytes )
+            {
+                vst1q_u8( destination + bytes - 16, value );
+            }
+        }
+#endif
+    };
+}
@@ -0,0 +1,124 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// Local includes
+#include "Core/BuildConfig.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Bulk array transfer used by cIWriter::WriteArray and cIReader::ReadArray. Every Core stream
+    /// stores scalars in host byte order, so arrays of fixed size types have the same layout in
+    /// memory as in the stream and move with a single WriteData/ReadData call. Types whose stream
+    /// size differs from their memory size (bool) go through the scalar calls one element at a time,
+    /// and long is stored as 32 bits.
+    /// Other types are intentionally left undefined.
+    /// </summary>
+    template<typename T> struct cStreamArray;
+
+    template<typename T> struct cStreamArrayContiguous
+    {
+        template<class W> static void Write( W &writer, const T *values, unsigned long long count )
+        {
+            if( count > 0 )
+            {
+                writer.WriteData( reinterpret_cast<const unsigned char*>( values ), count * sizeof( T ) );
+            }
+        }
+
+        template<class R> static unsigned long long Read( R &reader, T *values, unsigned long long count )
+        {
+            if( count == 0 )
+            {
+                return 0;
+            }
+            return reader.ReadData( reinterpret_cast<unsigned char*>( values ), count * sizeof( T ) ) / sizeof( T );
+        }
+    };
+
+    template<> struct cStreamArray<char>               : cStreamArrayContiguous<char> { };
+    template<> struct cStreamArray<signed char>        : cStreamArrayContiguous<signed char> { };
+    template<> struct cStreamArray<unsigned char>      : cStreamArrayContiguous<unsigned char> { };
+    template<> struct cStreamArray<short>              : cStreamArrayContiguous<short> { };
+    template<> struct cStreamArray<unsigned short>     : cStreamArrayContiguous<unsigned short> { };
+    template<> struct cStreamArray<int>                : cStreamArrayContiguous<int> { };
+    template<> struct cStreamArray<unsigned int>       : cStreamArrayContiguous<unsigned int> { };
+    template<> struct cStreamArray<long long>          : cStreamArrayContiguous<long long> { };
+    template<> struct cStreamArray<unsigned long long> : cStreamArrayContiguous<unsigned long long> { };
+    template<> struct cStreamArray<float>              : cStreamArrayContiguous<float> { };
+    template<> struct cStreamArray<double>             : cStreamArrayContiguous<double> { };
+
+    template<> struct cStreamArray<bool>
+    {
+        template<class W> static void Write( W &writer, const bool *values, unsigned long long count )
+        {
+            for( unsigned long long i = 0; i < count; ++i )
+            {
+                writer.WriteBool( values[ i ] );
+            }
+        }
+
+        template<class R> static unsigned long long Read( R &reader, bool *values, unsigned long long count )
+        {
+            for( unsigned long long i = 0; i < count; ++i )
+            {
+                if( reader.IsEOF() )
+                {
+                    return i;
+                }
+                values[ i ] = reader.ReadBool();
+            }
+            return count;
+        }
+    };
+
+    /// <summary>
+    /// long arrays are stored as 32 bit values, the same encoding as cArenaSerializer::WriteLong and
+    /// ReadLong, so an array reads back element by element with ReadLong and vice versa. The stream
+    /// is identical on LLP64 and LP64 platforms; on LP64 values outside the int range are truncated,
+    /// as they are by WriteLong.
+    /// </summary>
+    template<> struct cStreamArray<long>
+    {
+        template<class W> static void Write( W &writer, const long *values, unsigned long long count )
+        {
+            int buffer[ 256 ];
+
+            while( count > 0 )
+            {
+                int chunk = ( count < 256 ) ? (int) count : 256;
+                for( int i = 0; i < chunk; ++i )
+                {
+                    buffer[ i ] = (int) values[ i ];
+                }
+                cStreamArrayContiguous<int>::Write( writer, buffer, chunk );
+                values += chunk;
+                count  -= chunk;
+            }
+        }
+
+        template<class R> static unsigned long long Read( R &reader, long *values, unsigned long long count )
+        {
+            int buffer[ 256 ];
+            unsigned long long total = 0;
+
+            while( total < count )
+            {
+                int chunk = ( count - total < 256 ) ? (int) ( count - total ) : 256;
+                int read   = (int) cStreamArrayContiguous<int>::Read( reader, buffer, chunk );
+                for( int i = 0; i < read; ++i )
+                {
+                    values[ total + i ] = (long) buffer[ i ];
+                }
+                total += read;
+                if( read < chunk )
+                {
+                    break;
+                }
+            }
+            return total;
+        }
+    };
+}
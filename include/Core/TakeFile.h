@@ -0,0 +1,542 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <vector>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/IWriter.h"
+#include "Core/IReader.h"
+#include "Core/TimeCode.h"
+#include "Core/Frame.h"
+#include "Core/ArenaSerializer.h"
+#include "Core/TakeIndex.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Indexed take file of frame blocks:
+    ///
+    ///   int   Magic, Version
+    ///   ...   blocks, any cameras interleaved
+    ///   ...   cTakeIndex
+    ///   long long IndexOffset, int Magic   (trailer)
+    ///
+    /// A block holds consecutive frames of one camera, each saved with cICameraFrame::Save:
+    ///
+    ///   int   BlockMagic, Serial, FrameCount, RecordSize
+    ///   per frame: int FrameID, double TimeStamp, long long HardwareTimeStamp, int RecordOffset
+    ///   RecordSize bytes of frame records
+    ///
+    /// The frame table lets a reader find a frame within a block without loading every record.
+    /// A take whose trailer is missing (e.g. the recording was interrupted) is still readable;
+    /// cTakeReader rebuilds the index by scanning the block headers.
+    /// </summary>
+    const int kTakeFileMagic          = 0x4B54504E; //== 'NPTK' ==--
+    const int kTakeFileVersion        = 1;
+    const int kTakeBlockMagic         = 0x4254504E; //== 'NPTB' ==--
+    const int kTakeDefaultBlockFrames = 256;
+    const unsigned long long kTakeFileTrailerSize = sizeof( long long ) + sizeof( int );
+
+    /// <summary>Frame table entry of a take block.</summary>
+    struct sTakeFrame
+    {
+        int       FrameID;
+        double    TimeStamp;
+        long long HardwareTimeStamp;
+        int       RecordOffset;     //== within the block's frame records ==--
+    };
+
+    /// <summary>Writes camera frames into an indexed take.</summary>
+    class cTakeWriter
+    {
+    public:
+        cTakeWriter( int blockFrames = kTakeDefaultBlockFrames ) : mBlockFrames( ( blockFrames > 0 ) ? blockFrames : 1 ), mStream( nullptr ) { }
+
+        ~cTakeWriter()
+        {
+            Clear();
+        }
+
+        /// <summary>Start a take. The stream must stay valid until End().</summary>
+        void            Begin( cIWriter *stream, int timeCodeRate = 30 )
+        {
+            Clear();
+            mStream = stream;
+            mIndex.Clear();
+            mIndex.SetTimeCodeRate( timeCodeRate );
+
+            mStream->WriteInt( kTakeFileMagic );
+            mStream->WriteInt( kTakeFileVersion );
+        }
+
+        /// <summary>Add a camera frame, frame IDs must increase per camera. Valid timecode is indexed.</summary>
+        void            AddFrame( const cICameraFrame &frame )
+        {
+            cCameraStream &camera = Camera( frame.Serial() );
+
+            sTakeFrame entry;
+            entry.FrameID           = frame.FrameID();
+            entry.TimeStamp         = frame.TimeStamp();
+            entry.HardwareTimeStamp = frame.HardwareTimeStamp();
+            entry.RecordOffset      = (int) camera.Records.Size();
+
+            if( camera.Frames.empty() )
+            {
+                camera.Block.FirstFrameID           = entry.FrameID;
+                camera.Block.FirstHardwareTimeStamp = entry.HardwareTimeStamp;
+                camera.Block.FirstTimeStamp         = entry.TimeStamp;
+            }
+            camera.Block.LastFrameID           = entry.FrameID;
+            camera.Block.LastHardwareTimeStamp = entry.HardwareTimeStamp;
+            camera.Block.LastTimeStamp         = entry.TimeStamp;
+
+            camera.Frames.push_back( entry );
+            frame.Save( &camera.Records );
+
+            if( frame.IsTimeCodeValid() )
+            {
+                mIndex.AddTimeCode( camera.Serial, entry.FrameID, frame.TimeCode() );
+            }
+
+            if( (int) camera.Frames.size() >= mBlockFrames )
+            {
+                Flush( camera );
+            }
+        }
+
+        /// <summary>Write any pending blocks, the index and the trailer.</summary>
+        void            End()
+        {
+            if( !mStream )
+            {
+                return;
+            }
+
+            for( size_t i = 0; i < mCameras.size(); ++i )
+            {
+                Flush( *mCameras[ i ] );
+            }
+
+            long long indexOffset = (long long) mStream->Tell();
+            mIndex.Save( mStream );
+            mStream->WriteLongLong( indexOffset );
+            mStream->WriteInt( kTakeFileMagic );
+
+            mStream = nullptr;
+            Clear();
+        }
+
+        const cTakeIndex & Index() const { return mIndex; }
+
+    private:
+        //== pending block of one camera ==--
+
+        struct cCameraStream
+        {
+            int                     Serial;
+            std::vector<sTakeFrame> Frames;
+            cArenaSerializer        Records;
+            sTakeIndexBlock         Block;
+        };
+
+        cCameraStream & Camera( int serial )
+        {
+            for( size_t i = 0; i < mCameras.size(); ++i )
+            {
+                if( mCameras[ i ]->Serial == serial )
+                {
+                    return *mCameras[ i ];
+                }
+            }
+            mCameras.push_back( new cCameraStream() );
+            mCameras.back()->Serial = serial;
+            return *mCameras.back();
+        }
+
+        void            Flush( cCameraStream &camera )
+        {
+            if( camera.Frames.empty() )
+            {
+                return;
+            }
+
+            camera.Block.Offset     = mStream->Tell();
+            camera.Block.FrameCount = (int) camera.Frames.size();
+
+            mStream->WriteInt( kTakeBlockMagic );
+            mStream->WriteInt( camera.Serial );
+            mStream->WriteInt( camera.Block.FrameCount );
+            mStream->WriteInt( (int) camera.Records.Size() );
+
+            for( size_t i = 0; i < camera.Frames.size(); ++i )
+            {
+                mStream->WriteInt( camera.Frames[ i ].FrameID );
+                mStream->WriteDouble( camera.Frames[ i ].TimeStamp );
+                mStream->WriteLongLong( camera.Frames[ i ].HardwareTimeStamp );
+                mStream->WriteInt( camera.Frames[ i ].RecordOffset );
+            }
+            for( int i = 0; i < camera.Records.BlockCount(); ++i )
+            {
+                mStream->WriteData( camera.Records.Block( i ), camera.Records.BlockDataSize( i ) );
+            }
+
+            camera.Block.Size = mStream->Tell() - camera.Block.Offset;
+            mIndex.AddBlock( camera.Serial, camera.Block );
+
+            camera.Frames.clear();
+            camera.Records.Clear();
+        }
+
+        void            Clear()
+        {
+            for( size_t i = 0; i < mCameras.size(); ++i )
+            {
+                delete mCameras[ i ];
+            }
+            mCameras.clear();
+        }
+
+        int                         mBlockFrames;
+        cIWriter *                  mStream;
+        std::vector<cCameraStream*> mCameras;
+        cTakeIndex                  mIndex;
+    };
+
+    /// <summary>
+    /// Random access reader for indexed takes. Seeking by FrameID, time stamp, hardware time stamp
+    /// or timecode is a binary search of the index followed by loading one block and a binary
+    /// search of its frame table, and extracting a cFrameRangeSet only loads the blocks that
+    /// overlap it. The last loaded block is kept, so nearby seeks do not touch the stream again.
+    /// Frames are loaded into an instance made by the factory passed to Open().
+    /// </summary>
+    class cTakeReader
+    {
+    public:
+        cTakeReader() : mStream( nullptr ), mDataStart( 0 ), mFactory( nullptr ), mFrameData( nullptr ), mSerial( 0 ),
+            mBlock( -1 ), mFrame( -1 ), mLoadedFrame( -1 ), mBlocksLoaded( 0 ) { }
+
+        ~cTakeReader()
+        {
+            delete mFrameData;
+        }
+
+        /// <summary>Open a take. The stream and factory must stay valid while the reader is used.</summary>
+        bool            Open( cIReader *stream, const cICameraFrameFactory *factory )
+        {
+            delete mFrameData;
+
+            mStream       = stream;
+            mFactory      = factory;
+            mFrameData    = factory->CreateInstance();
+            mBlock        = -1;
+            mFrame        = -1;
+            mLoadedFrame  = -1;
+            mBlocksLoaded = 0;
+            mIndex.Clear();
+
+            mStream->Seek( 0 );
+            if( mStream->ReadInt() != kTakeFileMagic || mStream->ReadInt() != kTakeFileVersion )
+            {
+                return false;
+            }
+            mDataStart = mStream->Tell();
+
+            if( mStream->Size() >= mDataStart + kTakeFileTrailerSize )
+            {
+                mStream->Seek( mStream->Size() - kTakeFileTrailerSize );
+
+                unsigned long long indexOffset = (unsigned long long) mStream->ReadLongLong();
+
+                if( mStream->ReadInt() == kTakeFileMagic && indexOffset >= mDataStart
+                    && mStream->Seek( indexOffset ) && mIndex.Load( mStream ) )
+                {
+                    return true;
+                }
+            }
+
+            return Rebuild();
+        }
+
+        const cTakeIndex & Index() const { return mIndex; }
+
+        //== seeking, each positions the reader on the first stored frame at or after the target ==--
+
+        bool            SeekToFrame( int serial, int frameID )
+        {
+            return Load( serial, mIndex.FindFrame( serial, frameID ) )
+                && Position( LowerBound( [frameID]( const sTakeFrame &frame ) { return frame.FrameID < frameID; } ) );
+        }
+
+        bool            SeekToHardwareTimeStamp( int serial, long long hardwareTimeStamp )
+        {
+            return Load( serial, mIndex.FindHardwareTimeStamp( serial, hardwareTimeStamp ) )
+                && Position( LowerBound( [hardwareTimeStamp]( const sTakeFrame &frame ) { return frame.HardwareTimeStamp < hardwareTimeStamp; } ) );
+        }
+
+        bool            SeekToTime( int serial, double timeStamp )
+        {
+            return Load( serial, mIndex.FindTime( serial, timeStamp ) )
+                && Position( LowerBound( [timeStamp]( const sTakeFrame &frame ) { return frame.TimeStamp < timeStamp; } ) );
+        }
+
+        bool            SeekToTimeCode( int serial, const cTimeCode &timeCode )
+        {
+            int frameID;
+            return mIndex.FrameForTimeCode( serial, timeCode, frameID ) && SeekToFrame( serial, frameID );
+        }
+
+        //== current frame ==--
+
+        /// <summary>Frame table entry of the current frame.</summary>
+        const sTakeFrame & FrameInfo() const { return mFrames[ mFrame ]; }
+
+        /// <summary>
+        /// The current frame, loaded from its record on first use. Returns null if the record could
+        /// not be loaded. The instance is reused, it is only valid until the reader moves.
+        /// </summary>
+        const cICameraFrame * Frame()
+        {
+            if( mFrame < 0 )
+            {
+                return nullptr;
+            }
+            if( mLoadedFrame != mFrame )
+            {
+                if( !mRecords.Seek( (unsigned long long) mFrames[ mFrame ].RecordOffset ) || !mFrameData->Load( &mRecords ) )
+                {
+                    return nullptr;
+                }
+                mLoadedFrame = mFrame;
+            }
+            return mFrameData;
+        }
+
+        /// <summary>Advance to the next frame of the current camera, loading the next block when needed.</summary>
+        bool            Next()
+        {
+            if( mBlock < 0 )
+            {
+                return false;
+            }
+            if( mFrame + 1 < (int) mFrames.size() )
+            {
+                return Position( mFrame + 1 );
+            }
+            return Load( mSerial, mBlock + 1 ) && Position( 0 );
+        }
+
+        /// <summary>
+        /// Visit every stored frame of a camera that lies in a range set, in frame order. The visitor
+        /// is called as visitor( const cICameraFrame &frame ). Returns the number of frames visited.
+        /// </summary>
+        template<typename Visitor> int Extract( int serial, const cFrameRangeSet &frames, Visitor visitor )
+        {
+            int visited = 0;
+
+            mIndex.FindBlocks( serial, frames, mBlockList );
+
+            for( size_t b = 0; b < mBlockList.size(); ++b )
+            {
+                if( !Load( serial, mBlockList[ b ] ) )
+                {
+                    break;
+                }
+
+                const sTakeIndexBlock *block = mIndex.Block( serial, mBlockList[ b ] );
+                cFrameRangeSet inside = frames.Intersection( block->Frames() );
+
+                for( int r = 0; r < inside.RangeCount(); ++r )
+                {
+                    const int end = inside.Range( r ).End();
+                    const int start = inside.Range( r ).Start();
+
+                    for( int f = LowerBound( [start]( const sTakeFrame &frame ) { return frame.FrameID < start; } );
+                         f < (int) mFrames.size() && mFrames[ f ].FrameID <= end; ++f )
+                    {
+                        Position( f );
+                        if( const cICameraFrame *frame = Frame() )
+                        {
+                            visitor( *frame );
+                            ++visited;
+                        }
+                    }
+                }
+            }
+
+            return visited;
+        }
+
+        /// <summary>Blocks read from the stream since Open().</summary>
+        int             BlocksLoaded() const { return mBlocksLoaded; }
+
+    private:
+        bool            Position( int frame )
+        {
+            if( frame < 0 || frame >= (int) mFrames.size() )
+            {
+                return false;
+            }
+            mFrame = frame;
+            return true;
+        }
+
+        //== block header and frame table at the stream position, false if it is not a valid block ==--
+
+        bool            ReadBlockHeader( int &serial, int &recordSize )
+        {
+            if( mStream->Size() - mStream->Tell() < 4 * sizeof( int ) || mStream->ReadInt() != kTakeBlockMagic )
+            {
+                return false;
+            }
+
+            serial = mStream->ReadInt();
+            const int frameCount = mStream->ReadInt();
+            recordSize = mStream->ReadInt();
+
+            const unsigned long long entrySize = 2 * sizeof( int ) + sizeof( double ) + sizeof( long long );
+            if( frameCount <= 0 || recordSize < 0
+                || (unsigned long long) frameCount * entrySize + recordSize > mStream->Size() - mStream->Tell() )
+            {
+                return false;
+            }
+
+            mFrames.resize( frameCount );
+            for( int i = 0; i < frameCount; ++i )
+            {
+                sTakeFrame &entry       = mFrames[ i ];
+                entry.FrameID           = mStream->ReadInt();
+                entry.TimeStamp         = mStream->ReadDouble();
+                entry.HardwareTimeStamp = mStream->ReadLongLong();
+                entry.RecordOffset      = mStream->ReadInt();
+
+                if( entry.RecordOffset < 0 || entry.RecordOffset > recordSize )
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //== load a block of a camera unless it is already the current one ==--
+
+        bool            Load( int serial, int block )
+        {
+            if( block < 0 )
+            {
+                return false;
+            }
+            if( serial == mSerial && block == mBlock )
+            {
+                return true;
+            }
+
+            mBlock       = -1;
+            mFrame       = -1;
+            mLoadedFrame = -1;
+
+            const sTakeIndexBlock *entry = mIndex.Block( serial, block );
+
+            int blockSerial;
+            int recordSize;
+            if( !entry || !mStream->Seek( entry->Offset ) || !ReadBlockHeader( blockSerial, recordSize ) || blockSerial != serial )
+            {
+                return false;
+            }
+
+            mRecords.Clear();
+            unsigned char buffer[ 4096 ];
+            for( unsigned long long remaining = (unsigned long long) recordSize; remaining > 0; )
+            {
+                unsigned long long count = mStream->ReadData( buffer, ( remaining < sizeof( buffer ) ) ? remaining : sizeof( buffer ) );
+                if( count == 0 || mRecords.WriteData( buffer, count ) != count )
+                {
+                    return false;
+                }
+                remaining -= count;
+            }
+
+            mSerial = serial;
+            mBlock  = block;
+            mFrame  = 0;
+            mBlocksLoaded++;
+            return true;
+        }
+
+        template<typename Before> int LowerBound( Before before ) const
+        {
+            int first = 0;
+            int count = (int) mFrames.size();
+
+            while( count > 0 )
+            {
+                int step = count / 2;
+                if( before( mFrames[ first + step ] ) )
+                {
+                    first += step + 1;
+                    count -= step + 1;
+                }
+                else
+                {
+                    count = step;
+                }
+            }
+            return first;
+        }
+
+        //== unfinished take, read every block header once to recover the index (timecode is lost) ==--
+
+        bool            Rebuild()
+        {
+            mIndex.Clear();
+            mStream->Seek( mDataStart );
+
+            while( !mStream->IsEOF() )
+            {
+                unsigned long long offset = mStream->Tell();
+
+                int serial;
+                int recordSize;
+                if( !ReadBlockHeader( serial, recordSize ) || !mStream->Seek( mStream->Tell() + recordSize ) )
+                {
+                    break;
+                }
+
+                const sTakeFrame &first = mFrames.front();
+                const sTakeFrame &last  = mFrames.back();
+
+                sTakeIndexBlock block;
+                block.Offset                 = offset;
+                block.Size                   = mStream->Tell() - offset;
+                block.FrameCount             = (int) mFrames.size();
+                block.FirstFrameID           = first.FrameID;
+                block.LastFrameID            = last.FrameID;
+                block.FirstHardwareTimeStamp = first.HardwareTimeStamp;
+                block.LastHardwareTimeStamp  = last.HardwareTimeStamp;
+                block.FirstTimeStamp         = first.TimeStamp;
+                block.LastTimeStamp          = last.TimeStamp;
+                mIndex.AddBlock( serial, block );
+            }
+
+            mFrames.clear();
+            return mIndex.CameraCount() > 0;
+        }
+
+        cIReader *                  mStream;
+        unsigned long long          mDataStart;
+        const cICameraFrameFactory *mFactory;
+        cICameraFrame *             mFrameData;
+        cTakeIndex                  mIndex;
+        std::vector<sTakeFrame>     mFrames;
+        cArenaSerializer            mRecords;
+        std::vector<int>            mBlockList;
+        int                         mSerial;
+        int                         mBlock;
+        int                         mFrame;
+        int                         mLoadedFrame;
+        int                         mBlocksLoaded;
+    };
+}
@@ -0,0 +1,467 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <vector>
+#include <algorithm>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/IWriter.h"
+#include "Core/IReader.h"
+#include "Core/TimeCode.h"
+#include "Core/FrameRange.h"
+#include "Core/FrameRangeSet.h"
+#include "Core/TimeRange.h"
+
+namespace Core
+{
+    const int kTakeIndexVersion = 2;
+
+    /// <summary>One stored block of consecutive frames of a single camera.</summary>
+    struct sTakeIndexBlock
+    {
+        unsigned long long Offset;          //== stream position of the block ==--
+        unsigned long long Size;            //== stored size in bytes ==--
+        int       FrameCount;
+        int       FirstFrameID;
+        int       LastFrameID;
+        long long FirstHardwareTimeStamp;
+        long long LastHardwareTimeStamp;
+        double    FirstTimeStamp;
+        double    LastTimeStamp;
+
+        cFrameRange Frames() const { return cFrameRange( FirstFrameID, LastFrameID ); }
+        cTimeRange  Time() const { return cTimeRange( FirstTimeStamp, LastTimeStamp ); }
+    };
+
+    /// <summary>
+    /// First frame of a camera carrying a timecode value. Later frames up to the next anchor carry
+    /// the same timecode with the subframe counting up by one per frame.
+    /// </summary>
+    struct sTakeTimeCodeAnchor
+    {
+        int       FrameID;
+        long long TimeCodeFrames;           //== timecode as a frame count since 00:00:00:00 ==--
+        int       SubFrame;                 //== subframe of the anchor frame ==--
+    };
+
+    /// <summary>
+    /// Random access index over a take stored as blocks of frames. Per camera it keeps the blocks
+    /// in frame order, which makes FrameID, hardware time stamp and time stamp lookups binary
+    /// searches over the blocks; within a block the frame is found after loading just that block.
+    /// Timecode is kept per camera as one anchor per timecode value, at the first frame carrying it,
+    /// so cameras running faster than timecode (several frames per value, told apart by subframe)
+    /// are mapped correctly and timecode <-> FrameID is a binary search as well. Blocks and timecode
+    /// of a camera must be added with increasing frame IDs, and timecode is expected to increase
+    /// through the take.
+    /// </summary>
+    class cTakeIndex
+    {
+    public:
+        cTakeIndex() { Clear(); }
+
+        void            Clear()
+        {
+            mCameras.clear();
+            mTimeCodeRate = 30;
+            mDropFrame    = false;
+        }
+
+        //== building ==--
+
+        void            AddBlock( int serial, const sTakeIndexBlock &block )
+        {
+            Camera( serial ).Blocks.push_back( block );
+        }
+
+        /// <summary>Nominal timecode frames per second (e.g. 24, 25, 30), used to convert timecode to frame counts.</summary>
+        void            SetTimeCodeRate( int framesPerSecond ) { mTimeCodeRate = ( framesPerSecond > 0 ) ? framesPerSecond : 30; }
+        int             TimeCodeRate() const { return mTimeCodeRate; }
+        bool            IsDropFrame() const { return mDropFrame; }
+
+        /// <summary>Record the timecode of a camera frame. Only frames where the timecode value changes add an anchor.</summary>
+        void            AddTimeCode( int serial, int frameID, const cTimeCode &timeCode )
+        {
+            cCameraBlocks &camera = Camera( serial );
+
+            if( !timeCode.Valid() || ( !camera.Anchors.empty() && frameID <= camera.LastTimeCodeFrame ) )
+            {
+                return;
+            }
+
+            mDropFrame = timeCode.IsDropFrame();
+
+            long long frames = TimeCodeToFrames( timeCode );
+
+            if( camera.Anchors.empty() || camera.Anchors.back().TimeCodeFrames != frames )
+            {
+                sTakeTimeCodeAnchor anchor = { frameID, frames, timeCode.SubFrame() };
+                camera.Anchors.push_back( anchor );
+            }
+            camera.LastTimeCodeFrame = frameID;
+        }
+
+        //== cameras & blocks ==--
+
+        int             CameraCount() const { return (int) mCameras.size(); }
+        int             CameraSerial( int index ) const { return mCameras[ index ].Serial; }
+
+        int             BlockCount( int serial ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            return camera ? (int) camera->Blocks.size() : 0;
+        }
+
+        const sTakeIndexBlock * Block( int serial, int index ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            if( !camera || index < 0 || index >= (int) camera->Blocks.size() )
+            {
+                return nullptr;
+            }
+            return &camera->Blocks[ index ];
+        }
+
+        /// <summary>Frames stored for a camera.</summary>
+        cFrameRange     Frames( int serial ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            if( !camera || camera->Blocks.empty() )
+            {
+                return cFrameRange();
+            }
+            return cFrameRange( camera->Blocks.front().FirstFrameID, camera->Blocks.back().LastFrameID );
+        }
+
+        //== lookups, all return a block index or -1 ==--
+
+        /// <summary>Block holding the frame, or the first block after it if the frame itself was not stored.</summary>
+        int             FindFrame( int serial, int frameID ) const
+        {
+            return Search( serial, [frameID]( const sTakeIndexBlock &block ) { return block.LastFrameID < frameID; } );
+        }
+
+        /// <summary>Block holding the first frame at or after a hardware time stamp.</summary>
+        int             FindHardwareTimeStamp( int serial, long long hardwareTimeStamp ) const
+        {
+            return Search( serial, [hardwareTimeStamp]( const sTakeIndexBlock &block ) { return block.LastHardwareTimeStamp < hardwareTimeStamp; } );
+        }
+
+        /// <summary>Block holding the first frame at or after a time stamp (seconds).</summary>
+        int             FindTime( int serial, double timeStamp ) const
+        {
+            return Search( serial, [timeStamp]( const sTakeIndexBlock &block ) { return block.LastTimeStamp < timeStamp; } );
+        }
+
+        /// <summary>Indices of the blocks needed to read every frame of a range set, in stream order.</summary>
+        void            FindBlocks( int serial, const cFrameRangeSet &frames, std::vector<int> &blocks ) const
+        {
+            blocks.clear();
+
+            const cCameraBlocks *camera = FindCamera( serial );
+            if( !camera )
+            {
+                return;
+            }
+
+            for( int r = 0; r < frames.RangeCount(); ++r )
+            {
+                const cFrameRange &range = frames.Range( r );
+
+                int index = FindFrame( serial, range.Start() );
+                if( index < 0 )
+                {
+                    break;
+                }
+
+                //== neighbouring ranges can share a block ==--
+
+                if( !blocks.empty() && blocks.back() >= index )
+                {
+                    index = blocks.back() + 1;
+                }
+
+                for( ; index < (int) camera->Blocks.size() && camera->Blocks[ index ].FirstFrameID <= range.End(); ++index )
+                {
+                    blocks.push_back( index );
+                }
+            }
+        }
+
+        //== timecode ==--
+
+        bool            HasTimeCode( int serial ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            return camera && !camera->Anchors.empty();
+        }
+
+        /// <summary>
+        /// Camera frame carrying a timecode and subframe. A subframe at or before the one of the first
+        /// frame carrying the timecode gives that first frame. False if the camera has no frame with
+        /// the timecode, or too few frames for the subframe.
+        /// </summary>
+        bool            FrameForTimeCode( int serial, const cTimeCode &timeCode, int &frameID ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            if( !camera )
+            {
+                return false;
+            }
+
+            const std::vector<sTakeTimeCodeAnchor> &anchors = camera->Anchors;
+            long long frames = TimeCodeToFrames( timeCode );
+
+            std::vector<sTakeTimeCodeAnchor>::const_iterator it = std::lower_bound( anchors.begin(), anchors.end(), frames,
+                []( const sTakeTimeCodeAnchor &anchor, long long value ) { return anchor.TimeCodeFrames < value; } );
+
+            if( it == anchors.end() || it->TimeCodeFrames != frames )
+            {
+                return false;
+            }
+
+            long long candidate = it->FrameID + std::max( 0, timeCode.SubFrame() - it->SubFrame );
+            long long end       = ( it + 1 != anchors.end() ) ? ( it + 1 )->FrameID - 1 : camera->LastTimeCodeFrame;
+            if( candidate > end )
+            {
+                return false;
+            }
+            frameID = (int) candidate;
+            return true;
+        }
+
+        /// <summary>Timecode and subframe of a camera frame, invalid outside the frames that carried timecode.</summary>
+        cTimeCode       TimeCodeForFrame( int serial, int frameID ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            if( !camera || camera->Anchors.empty() || frameID > camera->LastTimeCodeFrame )
+            {
+                return cTimeCode();
+            }
+
+            const std::vector<sTakeTimeCodeAnchor> &anchors = camera->Anchors;
+
+            std::vector<sTakeTimeCodeAnchor>::const_iterator it = std::upper_bound( anchors.begin(), anchors.end(), frameID,
+                []( int value, const sTakeTimeCodeAnchor &anchor ) { return value < anchor.FrameID; } );
+
+            if( it == anchors.begin() )
+            {
+                return cTimeCode();
+            }
+            --it;
+
+            cTimeCode timeCode = FramesToTimeCode( it->TimeCodeFrames );
+            timeCode.mTimeCodeSubFrame = (unsigned int) ( it->SubFrame + ( frameID - it->FrameID ) );
+            return timeCode;
+        }
+
+        /// <summary>Timecode (hh:mm:ss:ff, with drop frame numbering when flagged) as a frame count.</summary>
+        long long       TimeCodeToFrames( const cTimeCode &timeCode ) const
+        {
+            long long minutes = 60LL * timeCode.Hours() + timeCode.Minutes();
+            long long frames  = ( minutes * 60 + timeCode.Seconds() ) * mTimeCodeRate + timeCode.Frame();
+
+            if( timeCode.IsDropFrame() )
+            {
+                frames -= DroppedFrames() * ( minutes - minutes / 10 );
+            }
+            return frames;
+        }
+
+        cTimeCode       FramesToTimeCode( long long frames ) const
+        {
+            if( mDropFrame )
+            {
+                //== re-insert the frame numbers skipped at the start of each minute but every tenth ==--
+
+                const long long drop      = DroppedFrames();
+                const long long perTen    = 600LL * mTimeCodeRate - 9 * drop;
+                const long long perMinute = 60LL * mTimeCodeRate - drop;
+                const long long tens      = frames / perTen;
+                const long long remainder = frames % perTen;
+
+                frames += 9 * drop * tens;
+                if( remainder > drop )
+                {
+                    frames += drop * ( ( remainder - drop ) / perMinute );
+                }
+            }
+
+            cTimeCode timeCode;
+            timeCode.mFrames            = (unsigned int) ( frames % mTimeCodeRate );
+            timeCode.mSeconds           = (unsigned int) ( ( frames / mTimeCodeRate ) % 60 );
+            timeCode.mMinutes           = (unsigned int) ( ( frames / ( 60LL * mTimeCodeRate ) ) % 60 );
+            timeCode.mHours             = (unsigned int) ( frames / ( 3600LL * mTimeCodeRate ) );
+            timeCode.mTimeCodeDropFrame = mDropFrame;
+            timeCode.mValid             = true;
+            return timeCode;
+        }
+
+        //== persistence ==--
+
+        void            Save( cIWriter *stream ) const
+        {
+            stream->WriteInt( kTakeIndexVersion );
+            stream->WriteInt( mTimeCodeRate );
+            stream->WriteBool( mDropFrame );
+
+            stream->WriteInt( (int) mCameras.size() );
+            for( size_t c = 0; c < mCameras.size(); ++c )
+            {
+                const std::vector<sTakeTimeCodeAnchor> &anchors = mCameras[ c ].Anchors;
+                const std::vector<sTakeIndexBlock> &blocks = mCameras[ c ].Blocks;
+
+                stream->WriteInt( mCameras[ c ].Serial );
+                stream->WriteInt( mCameras[ c ].LastTimeCodeFrame );
+
+                stream->WriteInt( (int) anchors.size() );
+                for( size_t i = 0; i < anchors.size(); ++i )
+                {
+                    stream->WriteInt( anchors[ i ].FrameID );
+                    stream->WriteLongLong( anchors[ i ].TimeCodeFrames );
+                    stream->WriteInt( anchors[ i ].SubFrame );
+                }
+
+                stream->WriteInt( (int) blocks.size() );
+                for( size_t i = 0; i < blocks.size(); ++i )
+                {
+                    stream->WriteLongLong( (long long) blocks[ i ].Offset );
+                    stream->WriteLongLong( (long long) blocks[ i ].Size );
+                    stream->WriteInt( blocks[ i ].FrameCount );
+                    stream->WriteInt( blocks[ i ].FirstFrameID );
+                    stream->WriteInt( blocks[ i ].LastFrameID );
+                    stream->WriteLongLong( blocks[ i ].FirstHardwareTimeStamp );
+                    stream->WriteLongLong( blocks[ i ].LastHardwareTimeStamp );
+                    stream->WriteDouble( blocks[ i ].FirstTimeStamp );
+                    stream->WriteDouble( blocks[ i ].LastTimeStamp );
+                }
+            }
+        }
+
+        bool            Load( cIReader *stream )
+        {
+            Clear();
+
+            if( stream->ReadInt() != kTakeIndexVersion )
+            {
+                return false;
+            }
+
+            SetTimeCodeRate( stream->ReadInt() );
+            mDropFrame = stream->ReadBool();
+
+            int cameraCount = stream->ReadInt();
+            if( cameraCount < 0 || (unsigned long long) cameraCount * 16 > stream->Size() - stream->Tell() )
+            {
+                return false;
+            }
+            mCameras.resize( cameraCount );
+            for( int c = 0; c < cameraCount; ++c )
+            {
+                mCameras[ c ].Serial            = stream->ReadInt();
+                mCameras[ c ].LastTimeCodeFrame = stream->ReadInt();
+
+                int anchorCount = stream->ReadInt();
+                if( anchorCount < 0 || (unsigned long long) anchorCount * 16 > stream->Size() - stream->Tell() )
+                {
+                    return false;
+                }
+
+                std::vector<sTakeTimeCodeAnchor> &anchors = mCameras[ c ].Anchors;
+                anchors.resize( anchorCount );
+                for( int i = 0; i < anchorCount; ++i )
+                {
+                    anchors[ i ].FrameID        = stream->ReadInt();
+                    anchors[ i ].TimeCodeFrames = stream->ReadLongLong();
+                    anchors[ i ].SubFrame       = stream->ReadInt();
+                }
+
+                int blockCount = stream->ReadInt();
+                if( blockCount < 0 || (unsigned long long) blockCount * 60 > stream->Size() - stream->Tell() )
+                {
+                    return false;
+                }
+
+                std::vector<sTakeIndexBlock> &blocks = mCameras[ c ].Blocks;
+                blocks.resize( blockCount );
+                for( int i = 0; i < blockCount; ++i )
+                {
+                    blocks[ i ].Offset                 = (unsigned long long) stream->ReadLongLong();
+                    blocks[ i ].Size                   = (unsigned long long) stream->ReadLongLong();
+                    blocks[ i ].FrameCount             = stream->ReadInt();
+                    blocks[ i ].FirstFrameID           = stream->ReadInt();
+                    blocks[ i ].LastFrameID            = stream->ReadInt();
+                    blocks[ i ].FirstHardwareTimeStamp = stream->ReadLongLong();
+                    blocks[ i ].LastHardwareTimeStamp  = stream->ReadLongLong();
+                    blocks[ i ].FirstTimeStamp         = stream->ReadDouble();
+                    blocks[ i ].LastTimeStamp          = stream->ReadDouble();
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        struct cCameraBlocks
+        {
+            cCameraBlocks() : Serial( 0 ), LastTimeCodeFrame( 0 ) { }
+
+            int                              Serial;
+            int                              LastTimeCodeFrame;
+            std::vector<sTakeIndexBlock>     Blocks;
+            std::vector<sTakeTimeCodeAnchor> Anchors;
+        };
+
+        //== 2 frame numbers are skipped per minute at 30fps, 4 at 60fps ==--
+
+        long long       DroppedFrames() const { return ( mTimeCodeRate + 14 ) / 15; }
+
+        cCameraBlocks & Camera( int serial )
+        {
+            for( size_t i = 0; i < mCameras.size(); ++i )
+            {
+                if( mCameras[ i ].Serial == serial )
+                {
+                    return mCameras[ i ];
+                }
+            }
+            mCameras.push_back( cCameraBlocks() );
+            mCameras.back().Serial = serial;
+            return mCameras.back();
+        }
+
+        const cCameraBlocks * FindCamera( int serial ) const
+        {
+            for( size_t i = 0; i < mCameras.size(); ++i )
+            {
+                if( mCameras[ i ].Serial == serial )
+                {
+                    return &mCameras[ i ];
+                }
+            }
+            return nullptr;
+        }
+
+        //== first block for which 'before' is false ==--
+
+        template<typename Before> int Search( int serial, Before before ) const
+        {
+            const cCameraBlocks *camera = FindCamera( serial );
+            if( !camera )
+            {
+                return -1;
+            }
+
+            std::vector<sTakeIndexBlock>::const_iterator it = std::partition_point( camera->Blocks.begin(), camera->Blocks.end(), before );
+
+            return ( it == camera->Blocks.end() ) ? -1 : (int) ( it - camera->Blocks.begin() );
+        }
+
+        std::vector<cCameraBlocks>       mCameras;
+        int                              mTimeCodeRate;
+        bool                             mDropFrame;
+    };
+}
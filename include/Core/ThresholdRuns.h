@@ -0,0 +1,176 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <vector>
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/SIMD.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Horizontal run of pixels at or above a threshold, with the sums needed for a weighted
+    /// centroid. Weight is the sum of the pixel weights and WeightX the sum of weight * x.
+    /// </summary>
+    struct sThresholdRun
+    {
+        int                 StartX;
+        int                 StartY;
+        int                 Length;
+        unsigned int        Weight;
+        unsigned long long  WeightX;
+    };
+
+    /// <summary>
+    /// Extracts runs of pixels >= threshold from 8 bit grayscale rows. Pixel weights are
+    /// pixel - threshold + 1 when intensity weighted, 1 otherwise. The vector kernels test 16
+    /// pixels at a time and skip (or extend a run over) uniform blocks; blocks containing a run
+    /// boundary are finished by the scalar kernel, so every level yields the same runs.
+    /// </summary>
+    class cThresholdRuns
+    {
+    public:
+        /// <summary>Append the runs of one row to 'runs'.</summary>
+        static void Extract( const unsigned char *row, int width, int y, int threshold, bool weighted,
+                             std::vector<sThresholdRun> &runs, eSIMDLevel level = BestSIMDLevel() )
+        {
+            if( threshold < 1 )
+            {
+                threshold = 1;
+            }
+            if( threshold > 255 )
+            {
+                return;
+            }
+
+            int x     = 0;
+            int start = -1;     //== start of the run in progress, -1 outside runs ==--
+
+#if defined( CORE_SIMD_SSE2 )
+            if( level >= SIMDSSE2 )
+            {
+                const __m128i limit = _mm_set1_epi8( (char) ( threshold - 1 ) );
+
+                for( ; x + 16 <= width; x += 16 )
+                {
+                    //== pixel >= threshold as max( pixel, threshold - 1 ) != threshold - 1 ==--
+
+                    __m128i pixels = _mm_loadu_si128( (const __m128i*) ( row + x ) );
+                    int     below  = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( pixels, limit ), limit ) );
+
+                    Block( row, x, y, threshold, weighted, below == 0xFFFF, below == 0, start, runs );
+                }
+            }
+#endif
+#if defined( CORE_SIMD_NEON )
+            if( level >= SIMDNEON )
+            {
+                const uint8x16_t limit = vdupq_n_u8( (unsigned char) threshold );
+
+                for( ; x + 16 <= width; x += 16 )
+                {
+                    uint8x16_t above = vcgeq_u8( vld1q_u8( row + x ), limit );
+
+                    Block( row, x, y, threshold, weighted, vmaxvq_u8( above ) == 0, vminvq_u8( above ) != 0, start, runs );
+                }
+            }
+#endif
+            Scalar( row, x, width, y, threshold, weighted, start, runs );
+
+            if( start >= 0 )
+            {
+                AddRun( row, start, width, y, threshold, weighted, runs );
+            }
+        }
+
+    private:
+        //== One 16 pixel block: nothing to do when it continues the current state, scalar otherwise ==--
+
+        static void Block( const unsigned char *row, int x, int y, int threshold, bool weighted, bool allBelow, bool allAbove,
+                           int &start, std::vector<sThresholdRun> &runs )
+        {
+            if( ( allBelow && start < 0 ) || ( allAbove && start >= 0 ) )
+            {
+                return;
+            }
+            Scalar( row, x, x + 16, y, threshold, weighted, start, runs );
+        }
+
+        static void Scalar( const unsigned char *row, int x, int end, int y, int threshold, bool weighted,
+                            int &start, std::vector<sThresholdRun> &runs )
+        {
+            for( ; x < end; ++x )
+            {
+                bool above = row[ x ] >= threshold;
+                if( above && start < 0 )
+                {
+                    start = x;
+                }
+                else if( !above && start >= 0 )
+                {
+                    AddRun( row, start, x, y, threshold, weighted, runs );
+                    start = -1;
+                }
+            }
+        }
+
+        static void AddRun( const unsigned char *row, int start, int end, int y, int threshold, bool weighted,
+                            std::vector<sThresholdRun> &runs )
+        {
+            sThresholdRun run;
+            run.StartX = start;
+            run.StartY = y;
+            run.Length = end - start;
+
+            if( weighted )
+            {
+                unsigned int       weight  = 0;
+                unsigned long long weightX = 0;
+                int                offset  = threshold - 1;
+                int                x       = start;
+
+#if defined( CORE_SIMD_SSE2 )
+                //== long runs: weights summed by psadbw, weight * x as x0 * sum + sum of weight * ( x - x0 ) ==--
+
+                const __m128i zero    = _mm_setzero_si128();
+                const __m128i bias    = _mm_set1_epi8( (char) offset );
+                const __m128i rampLow = _mm_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7 );
+                const __m128i rampHi  = _mm_setr_epi16( 8, 9, 10, 11, 12, 13, 14, 15 );
+
+                for( ; x + 16 <= end; x += 16 )
+                {
+                    __m128i w    = _mm_subs_epu8( _mm_loadu_si128( (const __m128i*) ( row + x ) ), bias );
+                    __m128i sum  = _mm_sad_epu8( w, zero );
+                    __m128i ramp = _mm_add_epi32( _mm_madd_epi16( _mm_unpacklo_epi8( w, zero ), rampLow ),
+                                                  _mm_madd_epi16( _mm_unpackhi_epi8( w, zero ), rampHi ) );
+                    ramp = _mm_add_epi32( ramp, _mm_shuffle_epi32( ramp, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+                    ramp = _mm_add_epi32( ramp, _mm_shuffle_epi32( ramp, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+
+                    unsigned int chunk = (unsigned int) ( _mm_cvtsi128_si32( sum ) + _mm_extract_epi16( sum, 4 ) );
+                    weight  += chunk;
+                    weightX += (unsigned long long) chunk * x + (unsigned int) _mm_cvtsi128_si32( ramp );
+                }
+#endif
+                for( ; x < end; ++x )
+                {
+                    unsigned int w = (unsigned int) ( row[ x ] - offset );
+                    weight  += w;
+                    weightX += (unsigned long long) w * x;
+                }
+                run.Weight  = weight;
+                run.WeightX = weightX;
+            }
+            else
+            {
+                run.Weight  = (unsigned int) run.Length;
+                run.WeightX = (unsigned long long) run.Length * ( start + end - 1 ) / 2;
+            }
+
+            runs.push_back( run );
+        }
+    };
+}
@@ -1,2 +1,65 @@
-//== Placeholder: No public interface ==--
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
 
+// Local includes
+#include "Core/BuildConfig.h"
+
+namespace Core
+{
+    /// <summary>
+    /// A closed interval of time { Start()..End() } in seconds, in the same time base as frame
+    /// time stamps. A range with End() < Start() is empty.
+    /// </summary>
+    class cTimeRange
+    {
+    public:
+        /// <summary>An empty range.</summary>
+        cTimeRange() : mStart( 0 ), mEnd( -1 ) { }
+
+        cTimeRange( double start, double end ) : mStart( start ), mEnd( end ) { }
+
+        double          Start() const { return mStart; }
+        double          End() const { return mEnd; }
+
+        void            SetStart( double start ) { mStart = start; }
+        void            SetEnd( double end ) { mEnd = end; }
+
+        bool            IsEmpty() const { return mEnd < mStart; }
+
+        double          Duration() const { return IsEmpty() ? 0 : mEnd - mStart; }
+
+        bool            Contains( double time ) const { return time >= mStart && time <= mEnd; }
+
+        /// <summary>True if the ranges share at least one instant.</summary>
+        bool            Overlaps( const cTimeRange &other ) const
+        {
+            return !IsEmpty() && !other.IsEmpty() && other.mStart <= mEnd && other.mEnd >= mStart;
+        }
+
+        /// <summary>Time common to both ranges.</summary>
+        cTimeRange      Intersection( const cTimeRange &other ) const
+        {
+            return cTimeRange( mStart > other.mStart ? mStart : other.mStart, mEnd < other.mEnd ? mEnd : other.mEnd );
+        }
+
+        /// <summary>Smallest range containing both ranges.</summary>
+        cTimeRange      Bounds( const cTimeRange &other ) const
+        {
+            if( IsEmpty() )
+            {
+                return other;
+            }
+            if( other.IsEmpty() )
+            {
+                return *this;
+            }
+            return cTimeRange( mStart < other.mStart ? mStart : other.mStart, mEnd > other.mEnd ? mEnd : other.mEnd );
+        }
+
+    private:
+        double          mStart;
+        double          mEnd;
+    };
+}
@@ -0,0 +1,147 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// System includes
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Local includes
+#include "Core/BuildConfig.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Small header-only pool of worker threads for data parallel loops. ParallelFor() hands out
+    /// indices from a shared counter to the workers and the calling thread alike, so a pool never
+    /// idles the caller and still makes progress with a single worker. One loop runs at a time;
+    /// ParallelFor() is meant to be called from one thread.
+    /// </summary>
+    class cWorkerPool
+    {
+    public:
+        /// <summary>Start 'threadCount' workers, or one less than the number of cores when zero
+        /// (the calling thread is the remaining one).</summary>
+        cWorkerPool( int threadCount = 0 ) : mBody( nullptr ), mCount( 0 ), mGeneration( 0 ), mActive( 0 ), mRunning( true )
+        {
+            mNext = 0;
+
+            if( threadCount <= 0 )
+            {
+                threadCount = (int) std::thread::hardware_concurrency() - 1;
+            }
+            for( int i = 0; i < threadCount; ++i )
+            {
+                mThreads.push_back( std::thread( &cWorkerPool::WorkerThread, this ) );
+            }
+        }
+
+        ~cWorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mWork.notify_all();
+            for( size_t i = 0; i < mThreads.size(); ++i )
+            {
+                mThreads[ i ].join();
+            }
+        }
+
+        int             ThreadCount() const { return (int) mThreads.size(); }
+
+        /// <summary>Run body( i ) for every i in [0, count) and return once all calls have finished.</summary>
+        void            ParallelFor( int count, const std::function<void( int )> &body )
+        {
+            if( count <= 0 )
+            {
+                return;
+            }
+            if( mThreads.empty() || count == 1 )
+            {
+                for( int i = 0; i < count; ++i )
+                {
+                    body( i );
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mBody  = &body;
+                mCount = count;
+                mNext  = 0;
+                mActive = (int) mThreads.size();
+                mGeneration++;
+            }
+            mWork.notify_all();
+
+            Drain( body, count );
+
+            //== the loop is only done once every worker has stopped touching the body ==--
+
+            std::unique_lock<std::mutex> lock( mLock );
+            mDone.wait( lock, [this] { return mActive == 0; } );
+            mBody = nullptr;
+        }
+
+    private:
+        cWorkerPool( const cWorkerPool& );
+        cWorkerPool& operator=( const cWorkerPool& );
+
+        void            Drain( const std::function<void( int )> &body, int count )
+        {
+            for( int i = mNext++; i < count; i = mNext++ )
+            {
+                body( i );
+            }
+        }
+
+        void            WorkerThread()
+        {
+            unsigned long long generation = 0;
+
+            for( ;; )
+            {
+                const std::function<void( int )> *body;
+                int count;
+                {
+                    std::unique_lock<std::mutex> lock( mLock );
+                    mWork.wait( lock, [&] { return !mRunning || mGeneration != generation; } );
+                    if( !mRunning )
+                    {
+                        return;
+                    }
+                    generation = mGeneration;
+                    body  = mBody;
+                    count = mCount;
+                }
+
+                Drain( *body, count );
+
+                {
+                    std::lock_guard<std::mutex> lock( mLock );
+                    mActive--;
+                }
+                mDone.notify_one();
+            }
+        }
+
+        std::vector<std::thread>    mThreads;
+        std::mutex                  mLock;
+        std::condition_variable     mWork;
+        std::condition_variable     mDone;
+        const std::function<void( int )> * mBody;
+        int                         mCount;
+        std::atomic<int>            mNext;
+        unsigned long long          mGeneration;
+        int                         mActive;
+        bool                        mRunning;
+    };
+}
@@ -0,0 +1,245 @@
+//======================================================================================================
+// Copyright 2014, NaturalPoint Inc.
+//======================================================================================================
+#pragma once
+
+// Local includes
+#include "Core/BuildConfig.h"
+#include "Core/SIMD.h"
+
+namespace Core
+{
+    /// <summary>
+    /// Fixed point YUV to RGB matrix. Luma is scaled by YScale / 2^14 after removing YOffset,
+    /// chroma terms are in 2^-14 units except BU which is in 2^-13 units and applied twice
+    /// (2.017 does not fit a signed 16 bit 2^-14 coefficient).
+    /// </summary>
+    struct sYUVCoefficients
+    {
+        unsigned char  YOffset;
+        unsigned short YScale;
+        short          RV;
+        short          GU;
+        short          GV;
+        short          BU;
+    };
+
+    /// <summary>
+    /// Converts planar YUV 4:2:0 (I420, the output of the H.264 decoder) to 32 bit R, G, B, A
+    /// bytes with 255 alpha, the memory order of AV_PIX_FMT_RGBA. Chroma is upsampled by
+    /// repetition. Every kernel computes the same 16 bit fixed point arithmetic so SIMD and
+    /// scalar results are bit identical.
+    /// </summary>
+    class cYUVConvert
+    {
+    public:
+        typedef void ( *RowKernel )( const unsigned char *y, const unsigned char *u, const unsigned char *v,
+                                     unsigned char *destination, int count, const sYUVCoefficients &matrix );
+
+        /// <summary>BT.601 with video range (16-235) luma, the H.264 default.</summary>
+        static const sYUVCoefficients & BT601()
+        {
+            static const sYUVCoefficients matrix = { 16, 19077, 26149, 6419, 13320, 16525 };
+            return matrix;
+        }
+
+        /// <summary>BT.601 with full range (0-255) luma, as in JPEG and yuvj420p.</summary>
+        static const sYUVCoefficients & BT601Full()
+        {
+            static const sYUVCoefficients matrix = { 0, 16384, 22970, 5638, 11700, 14516 };
+            return matrix;
+        }
+
+        static RowKernel Kernel( eSIMDLevel level = BestSIMDLevel() )
+        {
+#if defined( CORE_SIMD_SSE2 )
+            if( level >= SIMDSSE2 ) return RowSSE2;
+#endif
+#if defined( CORE_SIMD_NEON )
+            if( level >= SIMDNEON ) return RowNEON;
+#endif
+            return Row;
+        }
+
+        /// <summary>Convert a width x height I420 image; the chroma planes are (width + 1) / 2 x (height + 1) / 2.</summary>
+        static void I420ToRGBA( const unsigned char *y, int ySpan, const unsigned char *u, int uSpan,
+                                const unsigned char *v, int vSpan, int width, int height,
+                                unsigned char *destination, int destinationSpan,
+                                const sYUVCoefficients &matrix = BT601(), eSIMDLevel level = BestSIMDLevel() )
+        {
+            RowKernel kernel = Kernel( level );
+
+            for( int row = 0; row < height; ++row )
+            {
+                long long chroma = (long long) ( row >> 1 );
+                kernel( y + (long long) row * ySpan, u + chroma * uSpan, v + chroma * vSpan,
+                        destination + (long long) row * destinationSpan, width, matrix );
+            }
+        }
+
+        //== scalar kernel, also used for the tails of the vector kernels ==--
+
+        static void Row( const unsigned char *y, const unsigned char *u, const unsigned char *v,
+                         unsigned char *destination, int count, const sYUVCoefficients &matrix )
+        {
+            for( int i = 0; i < count; ++i )
+            {
+                int luma = ( y[ i ] > matrix.YOffset ) ? y[ i ] - matrix.YOffset : 0;
+                int base = (int) ( ( (unsigned int) luma << 8 ) * matrix.YScale >> 16 ) + 32;
+                int cu   = ( u[ i >> 1 ] - 128 ) * 256;
+                int cv   = ( v[ i >> 1 ] - 128 ) * 256;
+
+                int rv = MulHigh( cv, matrix.RV );
+                int gu = MulHigh( cu, matrix.GU );
+                int gv = MulHigh( cv, matrix.GV );
+                int bu = MulHigh( cu, matrix.BU );
+
+                destination[ 0 ] = Clamp( Saturate( base + rv ) >> 6 );
+                destination[ 1 ] = Clamp( Saturate( Saturate( base - gu ) - gv ) >> 6 );
+                destination[ 2 ] = Clamp( Saturate( Saturate( base + bu ) + bu ) >> 6 );
+                destination[ 3 ] = 255;
+                destination += 4;
+            }
+        }
+
+#if defined( CORE_SIMD_SSE2 )
+        static void RowSSE2( const unsigned char *y, const unsigned char *u, const unsigned char *v,
+                             unsigned char *destination, int count, const sYUVCoefficients &matrix )
+        {
+            const __m128i zero    = _mm_setzero_si128();
+            const __m128i offset  = _mm_set1_epi8( (char) matrix.YOffset );
+            const __m128i scale   = _mm_set1_epi16( (short) matrix.YScale );
+            const __m128i round   = _mm_set1_epi16( 32 );
+            const __m128i bias    = _mm_set1_epi16( (short) 0x8000 );
+            const __m128i rvScale = _mm_set1_epi16( matrix.RV );
+            const __m128i guScale = _mm_set1_epi16( matrix.GU );
+            const __m128i gvScale = _mm_set1_epi16( matrix.GV );
+            const __m128i buScale = _mm_set1_epi16( matrix.BU );
+            const __m128i alpha   = _mm_set1_epi8( (char) 0xFF );
+
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                //== (c - 128) << 8 as c << 8 with the top bit flipped, terms for 8 chroma samples ==--
+
+                __m128i cu = _mm_xor_si128( _mm_unpacklo_epi8( zero, _mm_loadl_epi64( (const __m128i*) ( u + ( i >> 1 ) ) ) ), bias );
+                __m128i cv = _mm_xor_si128( _mm_unpacklo_epi8( zero, _mm_loadl_epi64( (const __m128i*) ( v + ( i >> 1 ) ) ) ), bias );
+
+                __m128i rv = _mm_mulhi_epi16( cv, rvScale );
+                __m128i gu = _mm_mulhi_epi16( cu, guScale );
+                __m128i gv = _mm_mulhi_epi16( cv, gvScale );
+                __m128i bu = _mm_mulhi_epi16( cu, buScale );
+
+                __m128i luma = _mm_subs_epu8( _mm_loadu_si128( (const __m128i*) ( y + i ) ), offset );
+                __m128i base[ 2 ];
+                base[ 0 ] = _mm_add_epi16( _mm_mulhi_epu16( _mm_unpacklo_epi8( zero, luma ), scale ), round );
+                base[ 1 ] = _mm_add_epi16( _mm_mulhi_epu16( _mm_unpackhi_epi8( zero, luma ), scale ), round );
+
+                __m128i red[ 2 ], green[ 2 ], blue[ 2 ];
+                for( int half = 0; half < 2; ++half )
+                {
+                    __m128i rvPair = half ? _mm_unpackhi_epi16( rv, rv ) : _mm_unpacklo_epi16( rv, rv );
+                    __m128i guPair = half ? _mm_unpackhi_epi16( gu, gu ) : _mm_unpacklo_epi16( gu, gu );
+                    __m128i gvPair = half ? _mm_unpackhi_epi16( gv, gv ) : _mm_unpacklo_epi16( gv, gv );
+                    __m128i buPair = half ? _mm_unpackhi_epi16( bu, bu ) : _mm_unpacklo_epi16( bu, bu );
+
+                    red[ half ]   = _mm_srai_epi16( _mm_adds_epi16( base[ half ], rvPair ), 6 );
+                    green[ half ] = _mm_srai_epi16( _mm_subs_epi16( _mm_subs_epi16( base[ half ], guPair ), gvPair ), 6 );
+                    blue[ half ]  = _mm_srai_epi16( _mm_adds_epi16( _mm_adds_epi16( base[ half ], buPair ), buPair ), 6 );
+                }
+
+                __m128i r = _mm_packus_epi16( red[ 0 ],   red[ 1 ] );
+                __m128i g = _mm_packus_epi16( green[ 0 ], green[ 1 ] );
+                __m128i b = _mm_packus_epi16( blue[ 0 ],  blue[ 1 ] );
+
+                __m128i rg = _mm_unpacklo_epi8( r, g );
+                __m128i ba = _mm_unpacklo_epi8( b, alpha );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i ),      _mm_unpacklo_epi16( rg, ba ) );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i + 16 ), _mm_unpackhi_epi16( rg, ba ) );
+                rg = _mm_unpackhi_epi8( r, g );
+                ba = _mm_unpackhi_epi8( b, alpha );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i + 32 ), _mm_unpacklo_epi16( rg, ba ) );
+                _mm_storeu_si128( (__m128i*) ( destination + 4 * i + 48 ), _mm_unpackhi_epi16( rg, ba ) );
+            }
+            Row( y + i, u + ( i >> 1 ), v + ( i >> 1 ), destination + 4 * i, count - i, matrix );
+        }
+#endif
+
+#if defined( CORE_SIMD_NEON )
+        static void RowNEON( const unsigned char *y, const unsigned char *u, const unsigned char *v,
+                             unsigned char *destination, int count, const sYUVCoefficients &matrix )
+        {
+            const uint8x8_t  offset = vdup_n_u8( matrix.YOffset );
+            const int16x8_t  round  = vdupq_n_s16( 32 );
+            const int16x8_t  bias   = vdupq_n_s16( 128 );
+
+            int i = 0;
+            for( ; i + 16 <= count; i += 16 )
+            {
+                int16x8_t cu = vshlq_n_s16( vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vld1_u8( u + ( i >> 1 ) ) ) ), bias ), 8 );
+                int16x8_t cv = vshlq_n_s16( vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vld1_u8( v + ( i >> 1 ) ) ) ), bias ), 8 );
+
+                int16x8_t rv = MulHighNEON( cv, matrix.RV );
+                int16x8_t gu = MulHighNEON( cu, matrix.GU );
+                int16x8_t gv = MulHighNEON( cv, matrix.GV );
+                int16x8_t bu = MulHighNEON( cu, matrix.BU );
+
+                uint8x16x4_t pixels;
+                uint8x8_t channel[ 3 ][ 2 ];
+
+                for( int half = 0; half < 2; ++half )
+                {
+                    uint16x8_t luma = vshll_n_u8( vqsub_u8( vld1_u8( y + i + 8 * half ), offset ), 8 );
+                    uint16x4_t low  = vshrn_n_u32( vmull_n_u16( vget_low_u16( luma ),  matrix.YScale ), 16 );
+                    uint16x4_t high = vshrn_n_u32( vmull_n_u16( vget_high_u16( luma ), matrix.YScale ), 16 );
+                    int16x8_t base  = vaddq_s16( vreinterpretq_s16_u16( vcombine_u16( low, high ) ), round );
+
+                    int16x8_t rvPair = half ? vzip2q_s16( rv, rv ) : vzip1q_s16( rv, rv );
+                    int16x8_t guPair = half ? vzip2q_s16( gu, gu ) : vzip1q_s16( gu, gu );
+                    int16x8_t gvPair = half ? vzip2q_s16( gv, gv ) : vzip1q_s16( gv, gv );
+                    int16x8_t buPair = half ? vzip2q_s16( bu, bu ) : vzip1q_s16( bu, bu );
+
+                    channel[ 0 ][ half ] = vqmovun_s16( vshrq_n_s16( vqaddq_s16( base, rvPair ), 6 ) );
+                    channel[ 1 ][ half ] = vqmovun_s16( vshrq_n_s16( vqsubq_s16( vqsubq_s16( base, guPair ), gvPair ), 6 ) );
+                    channel[ 2 ][ half ] = vqmovun_s16( vshrq_n_s16( vqaddq_s16( vqaddq_s16( base, buPair ), buPair ), 6 ) );
+                }
+
+                pixels.val[ 0 ] = vcombine_u8( channel[ 0 ][ 0 ], channel[ 0 ][ 1 ] );
+                pixels.val[ 1 ] = vcombine_u8( channel[ 1 ][ 0 ], channel[ 1 ][ 1 ] );
+                pixels.val[ 2 ] = vcombine_u8( channel[ 2 ][ 0 ], channel[ 2 ][ 1 ] );
+                pixels.val[ 3 ] = vdupq_n_u8( 0xFF );
+                vst4q_u8( destination + 4 * i, pixels );
+            }
+            Row( y + i, u + ( i >> 1 ), v + ( i >> 1 ), destination + 4 * i, count - i, matrix );
+        }
+#endif
+
+    private:
+        static int MulHigh( int value, int scale )
+        {
+            //== floor of the product / 2^16, as the vector multiply-high instructions ==--
+
+            int product = value * scale;
+            return ( product >= 0 ) ? ( product >> 16 ) : -( ( -product + 65535 ) >> 16 );
+        }
+
+        static int Saturate( int value )
+        {
+            return ( value < -32768 ) ? -32768 : ( value > 32767 ) ? 32767 : value;
+        }
+
+        static unsigned char Clamp( int value )
+        {
+            return (unsigned char) ( ( value < 0 ) ? 0 : ( value > 255 ) ? 255 : value );
+        }
+
+#if defined( CORE_SIMD_NEON )
+        static int16x8_t MulHighNEON( int16x8_t value, short scale )
+        {
+            int16x4_t low  = vshrn_n_s32( vmull_n_s16( vget_low_s16( value ),  scale ), 16 );
+            int16x4_t high = vshrn_n_s32( vmull_n_s16( vget_high_s16( value ), scale ), 16 );
+            return vcombine_s16( low, high );
+        }
+#endif
+    };
+}
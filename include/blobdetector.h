@@ -0,0 +1,444 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__BLOBDETECTOR_H__
+#define __CAMERALIBRARY__BLOBDETECTOR_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <math.h>
+#include <vector>
+
+#include "frame.h"
+#include "cameratypes.h"
+#include "Core/ThresholdRuns.h"
+#include "Core/WorkerPool.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Segment style span, usable with cFrameRasterizer::FillRuns ==--
+
+    struct sBlobSpan
+    {
+        int     StartX;
+        int     StartY;
+        int     Length;
+
+        int     StopX() const { return StartX + Length - 1; }
+    };
+
+    //== One detected object, the host side counterpart of cObject.  X and Y are the (optionally
+    //== intensity weighted) centroid in pixels, with pixel centers at integer coordinates.
+    //== Roundness is the ratio of the minor to major axis of the blob's second moments, 1 for
+    //== a disc.  The blob's spans are Spans[FirstSpan] through Spans[FirstSpan + SpanCount - 1]
+    //== of its detector, top to bottom ==--
+
+    struct sBlob
+    {
+        float   X;
+        float   Y;
+        float   Area;               //== pixel count ==--
+        float   Roundness;
+        int     Left;
+        int     Right;
+        int     Top;
+        int     Bottom;
+        int     FirstSpan;
+        int     SpanCount;
+
+        int     Width()  const { return Right  - Left + 1; }
+        int     Height() const { return Bottom - Top  + 1; }
+        float   Radius() const { return 0.5f * (float) ( Width() > Height() ? Width() : Height() ); }
+        float   Aspect() const { return ( Width() < Height() ) ? (float) Width() / Height() : (float) Height() / Width(); }
+    };
+
+    struct sBlobDetectorSettings
+    {
+        int     Threshold;              //== Pixels at or above this are part of objects ==========----
+        int     MinObjectDiameter;      //== Objects whose larger extent is outside this ==========----
+        int     MaxObjectDiameter;      //== range are discarded ==================================----
+        bool    IntensityWeighted;      //== Weight centroids by pixel - Threshold + 1 ============----
+        int     ThreadCount;            //== Workers besides the caller, 0 for one per extra core =----
+
+        sBlobDetectorSettings() : Threshold( 200 ), MinObjectDiameter( 1 ), MaxObjectDiameter( 56 ),
+                                  IntensityWeighted( true ), ThreadCount( 0 ) {}
+
+        sBlobDetectorSettings( const sObjectModeSettings &ObjectMode, int CameraThreshold )
+            : Threshold( CameraThreshold ), MinObjectDiameter( ObjectMode.MinObjectDiameter ),
+              MaxObjectDiameter( ObjectMode.MaxObjectDiameter ), IntensityWeighted( true ), ThreadCount( 0 ) {}
+    };
+
+    //== Software object detection for grayscale images, e.g. from cameras in GrayscaleMode or
+    //== MJPEGMode (decode those with cMJPEGDecoder first), which deliver no cObjects.
+    //==
+    //== The image is split into horizontal stripes processed on a Core::cWorkerPool.  Each stripe
+    //== is thresholded into runs (Core::cThresholdRuns, 16 pixels per SIMD test) and its runs are
+    //== joined into 8-connected objects with a union-find; runs touching across stripe edges are
+    //== joined afterwards, and each object's centroid, area, bounds and roundness are summed from
+    //== its runs.  Results stay valid until the next Detect() ==--
+
+    class cBlobDetector
+    {
+    public:
+        cBlobDetector( const sBlobDetectorSettings &Settings = sBlobDetectorSettings() )
+            : mSettings( Settings ), mPool( Settings.ThreadCount ) {}
+        ~cBlobDetector() {}
+
+        void    SetSettings( const sBlobDetectorSettings &Settings ) { mSettings = Settings; }
+        const sBlobDetectorSettings & Settings() const { return mSettings; }
+
+        //== Detect objects in a GrayscaleMode frame, returns the object count.  Other frames (MJPEG
+        //== included, whose data need not be a full image) and frames with less grayscale data
+        //== than Width x Height detect nothing ==--
+
+        int     Detect( Frame *FrameRef )
+        {
+            const unsigned char *gray = ( FrameRef && FrameRef->FrameType() == Core::GrayscaleMode ) ? FrameRef->GetGrayscaleData() : 0;
+
+            if( !gray || (long long) FrameRef->GetGrayscaleDataSize() < (long long) FrameRef->Width() * FrameRef->Height() )
+            {
+                Reset();
+                return 0;
+            }
+
+            return Detect( gray, FrameRef->Width(), FrameRef->Height(), FrameRef->Width() );
+        }
+
+        int     Detect( const unsigned char *Image, int Width, int Height, int Span )
+        {
+            Reset();
+
+            if( !Image || Width <= 0 || Height <= 0 || Span < Width )
+            {
+                return 0;
+            }
+
+            //== 1. runs per stripe, in parallel ==--
+
+            int stripeCount = ( mPool.ThreadCount() + 1 ) * 4;
+            if( stripeCount > Height )
+            {
+                stripeCount = Height;
+            }
+
+            mStripes.resize( stripeCount );
+            for( int i = 0; i < stripeCount; i++ )
+            {
+                mStripes[i].Top    = (int) ( (long long) Height * i / stripeCount );
+                mStripes[i].Bottom = (int) ( (long long) Height * ( i + 1 ) / stripeCount );
+                mStripes[i].Runs.clear();
+            }
+
+            int  threshold = mSettings.Threshold;
+            bool weighted  = mSettings.IntensityWeighted;
+
+            mPool.ParallelFor( stripeCount, [&]( int Index )
+            {
+                sStripe &stripe = mStripes[ Index ];
+                for( int y = stripe.Top; y < stripe.Bottom; y++ )
+                {
+                    Core::cThresholdRuns::Extract( Image + (size_t) y * Span, Width, y, threshold, weighted, stripe.Runs );
+                }
+            } );
+
+            //== 2. gather runs and index them by row ==--
+
+            size_t runCount = 0;
+            for( int i = 0; i < stripeCount; i++ )
+            {
+                mStripes[i].FirstRun = (int) runCount;
+                runCount += mStripes[i].Runs.size();
+            }
+
+            mRuns.resize( runCount );
+            mParent.resize( runCount );
+            mRowStart.assign( Height + 1, 0 );
+
+            for( int i = 0; i < stripeCount; i++ )
+            {
+                const std::vector<Core::sThresholdRun> &runs = mStripes[i].Runs;
+                for( size_t j = 0; j < runs.size(); j++ )
+                {
+                    mRuns[ mStripes[i].FirstRun + j ] = runs[j];
+                    mRowStart[ runs[j].StartY + 1 ]++;
+                }
+            }
+            for( int y = 0; y < Height; y++ )
+            {
+                mRowStart[ y + 1 ] += mRowStart[ y ];
+            }
+            for( size_t i = 0; i < runCount; i++ )
+            {
+                mParent[i] = (int) i;
+            }
+
+            //== 3. connect runs within stripes in parallel (unions never leave a stripe), then across stripes ==--
+
+            mPool.ParallelFor( stripeCount, [this]( int Index )
+            {
+                const sStripe &stripe = mStripes[ Index ];
+                for( int y = stripe.Top + 1; y < stripe.Bottom; y++ )
+                {
+                    ConnectRows( y );
+                }
+            } );
+
+            for( int i = 1; i < stripeCount; i++ )
+            {
+                ConnectRows( mStripes[i].Top );
+            }
+
+            //== 4. sum objects ==--
+
+            Accumulate();
+
+            return (int) mBlobs.size();
+        }
+
+        int     BlobCount() const           { return (int) mBlobs.size(); }
+        const sBlob & Blob( int Index ) const { return mBlobs[ Index ]; }
+
+        int     SpanCount() const           { return (int) mSpans.size(); }
+        const sBlobSpan * Spans() const     { return mSpans.empty() ? 0 : &mSpans[0]; }
+
+        int     ThreadCount() const         { return mPool.ThreadCount(); }
+
+    private:
+        struct sStripe
+        {
+            int Top;
+            int Bottom;
+            int FirstRun;
+            std::vector<Core::sThresholdRun> Runs;
+        };
+
+        struct sSums
+        {
+            double  Weight;
+            double  WeightX;
+            double  WeightY;
+            double  Count;
+            double  X;
+            double  Y;
+            double  XX;
+            double  YY;
+            double  XY;
+            int     Left;
+            int     Right;
+            int     Top;
+            int     Bottom;
+            int     SpanCount;
+        };
+
+        cBlobDetector( const cBlobDetector& );
+        cBlobDetector& operator=( const cBlobDetector& );
+
+        void    Reset()
+        {
+            mRuns.clear();
+            mBlobs.clear();
+            mSpans.clear();
+        }
+
+        int     Find( int Run )
+        {
+            while( mParent[ Run ] != Run )
+            {
+                mParent[ Run ] = mParent[ mParent[ Run ] ];
+                Run = mParent[ Run ];
+            }
+            return Run;
+        }
+
+        void    Union( int A, int B )
+        {
+            A = Find( A );
+            B = Find( B );
+            if( A < B )
+            {
+                mParent[ B ] = A;
+            }
+            else if( B < A )
+            {
+                mParent[ A ] = B;
+            }
+        }
+
+        //== Join the runs of row Y with the 8-connected runs of row Y - 1 ==--
+
+        void    ConnectRows( int Y )
+        {
+            int above    = mRowStart[ Y - 1 ];
+            int aboveEnd = mRowStart[ Y ];
+            int below    = mRowStart[ Y ];
+            int belowEnd = mRowStart[ Y + 1 ];
+
+            while( above < aboveEnd && below < belowEnd )
+            {
+                const Core::sThresholdRun &a = mRuns[ above ];
+                const Core::sThresholdRun &b = mRuns[ below ];
+
+                int aStop = a.StartX + a.Length;    //== one past the end, i.e. diagonal neighbors touch ==--
+                int bStop = b.StartX + b.Length;
+
+                if( aStop >= b.StartX && bStop >= a.StartX )
+                {
+                    Union( above, below );
+                }
+
+                if( aStop < bStop )
+                {
+                    above++;
+                }
+                else
+                {
+                    below++;
+                }
+            }
+        }
+
+        void    Accumulate()
+        {
+            int runCount = (int) mRuns.size();
+
+            //== objects numbered in raster order of their first run ==--
+
+            mLabel.resize( runCount );
+            mSums.clear();
+
+            for( int i = 0; i < runCount; i++ )
+            {
+                int root = Find( i );
+                if( root == i )
+                {
+                    mLabel[i] = (int) mSums.size();
+                    sSums sums = { 0, 0, 0, 0, 0, 0, 0, 0, 0, mRuns[i].StartX, 0, mRuns[i].StartY, 0, 0 };
+                    mSums.push_back( sums );
+                }
+                else
+                {
+                    mLabel[i] = mLabel[ root ];
+                }
+
+                const Core::sThresholdRun &run = mRuns[i];
+                sSums &sums = mSums[ mLabel[i] ];
+
+                double n     = run.Length;
+                double x0    = run.StartX;
+                double x1    = run.StartX + run.Length - 1;
+                double y     = run.StartY;
+                double sumX  = n * ( x0 + x1 ) * 0.5;
+                double sumXX = ( x1 * ( x1 + 1 ) * ( 2 * x1 + 1 ) - ( x0 - 1 ) * x0 * ( 2 * x0 - 1 ) ) / 6.0;
+
+                sums.Weight  += run.Weight;
+                sums.WeightX += (double) run.WeightX;
+                sums.WeightY += run.Weight * y;
+                sums.Count   += n;
+                sums.X       += sumX;
+                sums.Y       += n * y;
+                sums.XX      += sumXX;
+                sums.YY      += n * y * y;
+                sums.XY      += sumX * y;
+                sums.SpanCount++;
+
+                if( run.StartX < sums.Left )            sums.Left   = run.StartX;
+                if( (int) x1 > sums.Right )             sums.Right  = (int) x1;
+                sums.Bottom = run.StartY;
+            }
+
+            //== keep objects within the diameter limits and lay out their spans contiguously ==--
+
+            int objectCount = (int) mSums.size();
+            mRemap.assign( objectCount, -1 );
+
+            int spanTotal = 0;
+            for( int i = 0; i < objectCount; i++ )
+            {
+                const sSums &sums = mSums[i];
+                int width    = sums.Right  - sums.Left + 1;
+                int height   = sums.Bottom - sums.Top  + 1;
+                int diameter = ( width > height ) ? width : height;
+
+                if( diameter < mSettings.MinObjectDiameter || diameter > mSettings.MaxObjectDiameter )
+                {
+                    continue;
+                }
+
+                mRemap[i] = (int) mBlobs.size();
+                mBlobs.push_back( MakeBlob( sums, spanTotal ) );
+                spanTotal += sums.SpanCount;
+            }
+
+            mSpans.resize( spanTotal );
+            mFill.resize( mBlobs.size() );
+            for( size_t i = 0; i < mBlobs.size(); i++ )
+            {
+                mFill[i] = mBlobs[i].FirstSpan;
+            }
+
+            for( int i = 0; i < runCount; i++ )
+            {
+                int blob = mRemap[ mLabel[i] ];
+                if( blob < 0 )
+                {
+                    continue;
+                }
+                sBlobSpan &span = mSpans[ mFill[ blob ]++ ];
+                span.StartX = mRuns[i].StartX;
+                span.StartY = mRuns[i].StartY;
+                span.Length = mRuns[i].Length;
+            }
+        }
+
+        static sBlob MakeBlob( const sSums &Sums, int FirstSpan )
+        {
+            sBlob blob;
+
+            blob.X         = (float) ( Sums.WeightX / Sums.Weight );
+            blob.Y         = (float) ( Sums.WeightY / Sums.Weight );
+            blob.Area      = (float) Sums.Count;
+            blob.Left      = Sums.Left;
+            blob.Right     = Sums.Right;
+            blob.Top       = Sums.Top;
+            blob.Bottom    = Sums.Bottom;
+            blob.FirstSpan = FirstSpan;
+            blob.SpanCount = Sums.SpanCount;
+
+            //== second moments of the pixel squares (each adds 1/12 of its own extent) ==--
+
+            double meanX = Sums.X / Sums.Count;
+            double meanY = Sums.Y / Sums.Count;
+            double xx    = Sums.XX / Sums.Count - meanX * meanX + 1.0 / 12.0;
+            double yy    = Sums.YY / Sums.Count - meanY * meanY + 1.0 / 12.0;
+            double xy    = Sums.XY / Sums.Count - meanX * meanY;
+
+            double center = 0.5 * ( xx + yy );
+            double spread = sqrt( 0.25 * ( xx - yy ) * ( xx - yy ) + xy * xy );
+            double minor  = center - spread;
+            double major  = center + spread;
+
+            blob.Roundness = ( major > 0 && minor > 0 ) ? (float) sqrt( minor / major ) : 0.0f;
+
+            return blob;
+        }
+
+        sBlobDetectorSettings               mSettings;
+        Core::cWorkerPool                   mPool;
+        std::vector<sStripe>                mStripes;
+        std::vector<Core::sThresholdRun>    mRuns;
+        std::vector<int>                    mRowStart;
+        std::vector<int>                    mParent;
+        std::vector<int>                    mLabel;
+        std::vector<sSums>                  mSums;
+        std::vector<int>                    mRemap;
+        std::vector<int>                    mFill;
+        std::vector<sBlob>                  mBlobs;
+        std::vector<sBlobSpan>              mSpans;
+    };
+}
+
+#endif
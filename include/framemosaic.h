@@ -0,0 +1,201 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__FRAMEMOSAIC_H__
+#define __CAMERALIBRARY__FRAMEMOSAIC_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <math.h>
+#include <vector>
+
+#include "framegroup.h"
+#include "framerasterizer.h"
+#include "Core/WorkerPool.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Grid layout of a mosaic.  Zero Columns and Rows pick a near square grid for the frame
+    //== count, zero in just one of them derives it from the other ==--
+
+    struct sMosaicLayout
+    {
+        int     Columns;
+        int     Rows;
+        int     Spacing;                //== Pixels between tiles and around the border ===========----
+        PIXEL   Background;
+
+        sMosaicLayout() : Columns( 0 ), Rows( 0 ), Spacing( 2 ), Background( PIXELCOLOR(0,0,0) ) {}
+    };
+
+    //== Rasterizes every frame of a FrameGroup into one target, one tile per frame in FrameGroup
+    //== order.  Tiles are drawn in parallel on a Core::cWorkerPool (the calling thread included), each
+    //== through cFrameRasterizer::RasterizeRegion with the smallest integer downscale that fits
+    //== the frame into its tile, centered.  Tiles write disjoint parts of the target, so workers
+    //== share nothing but the target buffer.  Every frame taken from the group with GetFrame is
+    //== released once all tiles are drawn.  A mosaic is meant to be driven from one thread ==--
+
+    class cFrameMosaic
+    {
+    public:
+        //== ThreadCount workers in addition to the calling thread, zero for one per extra core ==--
+
+        cFrameMosaic( int ThreadCount = 0 ) : mPool( ThreadCount ) {}
+        ~cFrameMosaic() {}
+
+        bool Rasterize( FrameGroup *Group, Bitmap *BitmapRef, const sMosaicLayout &Layout = sMosaicLayout() )
+        {
+            return BitmapRef && Rasterize( Group, BitmapRef->PixelWidth(), BitmapRef->PixelHeight(),
+                                           BitmapRef->ByteSpan(), BitmapRef->GetBitsPerPixel(), BitmapRef->GetBits(), Layout );
+        }
+
+        bool Rasterize( FrameGroup *Group, unsigned int Width, unsigned int Height, unsigned int Span,
+                        unsigned int BitsPerPixel, void *Buffer, const sMosaicLayout &Layout = sMosaicLayout() )
+        {
+            int bytesPerPixel = (int) BitsPerPixel / 8;
+
+            if( !Group || !Buffer || bytesPerPixel < 1 || bytesPerPixel > 4 || Span < Width * bytesPerPixel )
+            {
+                return false;
+            }
+
+            cFrameRasterizer::Clear( Width, Height, Span, BitsPerPixel, Buffer, Layout.Background );
+
+            int count = Group->Count();
+            int columns, rows;
+            Grid( Layout, count, columns, rows );
+
+            mTiles.resize( count );
+
+            for( int i = 0; i < count; i++ )
+            {
+                sTile &tile = mTiles[i];
+
+                tile.FrameRef     = Group->GetFrame( i );
+                tile.Buffer       = 0;
+                tile.BitsPerPixel = BitsPerPixel;
+                tile.Span         = Span;
+                tile.Width        = 0;
+                tile.Height       = 0;
+
+                int x, y;
+                if( !tile.FrameRef || i >= columns * rows
+                    || !TileRect( Layout, columns, rows, (int) Width, (int) Height, i, x, y, tile.Width, tile.Height ) )
+                {
+                    continue;
+                }
+
+                tile.Buffer = (unsigned char*) Buffer + (size_t) y * Span + (size_t) x * bytesPerPixel;
+            }
+
+            mPool.ParallelFor( count, [this]( int Index ) { RasterizeTile( mTiles[Index] ); } );
+
+            //== GetFrame adds a reference, skipped tiles included ==--
+
+            for( int i = 0; i < count; i++ )
+            {
+                if( mTiles[i].FrameRef )
+                {
+                    mTiles[i].FrameRef->Release();
+                    mTiles[i].FrameRef = 0;
+                }
+            }
+
+            return true;
+        }
+
+        //== Columns and rows actually used for a layout and frame count ==--
+
+        static void Grid( const sMosaicLayout &Layout, int Count, int &Columns, int &Rows )
+        {
+            Columns = Layout.Columns;
+            Rows    = Layout.Rows;
+
+            if( Columns <= 0 && Rows <= 0 )
+            {
+                Columns = (int) ceil( sqrt( (double) ( Count > 0 ? Count : 1 ) ) );
+            }
+            if( Columns <= 0 )
+            {
+                Columns = ( Count + Rows - 1 ) / Rows;
+            }
+            if( Rows <= 0 )
+            {
+                Rows = ( Count + Columns - 1 ) / Columns;
+            }
+            if( Columns < 1 ) Columns = 1;
+            if( Rows    < 1 ) Rows    = 1;
+        }
+
+        //== Pixel rectangle of tile Index, false if the grid does not fit the target ==--
+
+        static bool TileRect( const sMosaicLayout &Layout, int Columns, int Rows, int Width, int Height, int Index,
+                              int &X, int &Y, int &TileWidth, int &TileHeight )
+        {
+            int spacing = ( Layout.Spacing > 0 ) ? Layout.Spacing : 0;
+
+            TileWidth  = ( Width  - spacing * ( Columns + 1 ) ) / Columns;
+            TileHeight = ( Height - spacing * ( Rows    + 1 ) ) / Rows;
+
+            X = spacing + ( Index % Columns ) * ( TileWidth  + spacing );
+            Y = spacing + ( Index / Columns ) * ( TileHeight + spacing );
+
+            return TileWidth > 0 && TileHeight > 0;
+        }
+
+        int  ThreadCount() const { return mPool.ThreadCount(); }
+
+    private:
+        struct sTile
+        {
+            Frame *         FrameRef;
+            unsigned char * Buffer;             //== null when the tile is not drawn ==--
+            unsigned int    Span;
+            unsigned int    BitsPerPixel;
+            int             Width;
+            int             Height;
+        };
+
+        static void RasterizeTile( const sTile &Tile )
+        {
+            if( !Tile.FrameRef || !Tile.Buffer )
+            {
+                return;
+            }
+
+            Frame *frame      = Tile.FrameRef;
+            int frameWidth    = frame->Width();
+            int frameHeight   = frame->Height();
+            int factor        = Core::cBoxDownsample::FitFactor( frameWidth, frameHeight, Tile.Width, Tile.Height );
+
+            if( factor < 1 )
+            {
+                return;
+            }
+
+            //== center the reduced frame in its tile ==--
+
+            int width   = Core::cBoxDownsample::OutputSize( frameWidth,  factor );
+            int height  = Core::cBoxDownsample::OutputSize( frameHeight, factor );
+            int offsetX = ( Tile.Width  - width )  / 2;
+            int offsetY = ( Tile.Height - height ) / 2;
+
+            unsigned char *tile = Tile.Buffer + (size_t) offsetY * Tile.Span + (size_t) offsetX * ( Tile.BitsPerPixel / 8 );
+
+            cFrameRasterizer::RasterizeRegion( frame, 0, 0, frameWidth, frameHeight, factor,
+                                               width, height, Tile.Span, Tile.BitsPerPixel, tile );
+        }
+
+        cFrameMosaic( const cFrameMosaic& );
+        cFrameMosaic& operator=( const cFrameMosaic& );
+
+        Core::cWorkerPool       mPool;
+        std::vector<sTile>      mTiles;
+    };
+}
+
+#endif
@@ -0,0 +1,437 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__FRAMERASTERIZER_H__
+#define __CAMERALIBRARY__FRAMERASTERIZER_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+
+#include "frame.h"
+#include "bitmap.h"
+#include "object.h"
+#include "segment.h"
+#include "framesegments.h"
+#include "Core/GrayscaleExpand.h"
+#include "Core/BoxDownsample.h"
+#include "Core/SpanFill.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Drop-in replacements for Frame::Rasterize.  Core::GrayscaleMode frames drawn at their own
+    //== size are expanded straight from the frame's grayscale data with the vectorized kernels of
+    //== Core::cGrayscaleExpand (8, 16, 24 and 32 bit targets, any span).  Everything else, e.g.
+    //== MJPEG, interleaved, object and segment frames or scaled output, is passed on to
+    //== Frame::Rasterize ==--
+    //==
+    //== Segment frames can instead be drawn with RasterizeSegments, which clears the target with
+    //== wide stores and fills every segment run with Core::cSpanFill rather than pixel by pixel.
+    //== Runs are clipped to the target; the PIXEL color is packed once per call for the target
+    //== depth (32 bit stores the PIXEL as is, 24 bit its r,g,b bytes, 16 bit 565 and 8 bit luma) ==--
+    //==
+    //== RasterizeRegion draws a source region of interest reduced by an integer box filter factor
+    //== straight into a small target, so thumbnails cost output pixels instead of a full size
+    //== rasterize followed by Bitmap::Resize.  GrayscaleMode frames are filtered from their image
+    //== data, segment and precision frames draw their runs at the reduced scale, and anything else
+    //== (object, MJPEG, interleaved or video frames) is rasterized at full size into an 8 bit
+    //== scratch image by Frame::Rasterize and then filtered ==--
+
+    class cFrameRasterizer
+    {
+    public:
+        static void Rasterize( Frame *Frame, unsigned int Width, unsigned int Height, unsigned int Span,
+                               unsigned int BitsPerPixel, void *Buffer )
+        {
+            if( !RasterizeGrayscale( Frame, Width, Height, Span, BitsPerPixel, Buffer ) )
+            {
+                Frame->Rasterize( Width, Height, Span, BitsPerPixel, Buffer );
+            }
+        }
+
+        static void Rasterize( Frame *Frame, Bitmap *BitmapRef )
+        {
+            if( !RasterizeGrayscale( Frame, BitmapRef->PixelWidth(), BitmapRef->PixelHeight(), BitmapRef->ByteSpan(),
+                                     BitmapRef->GetBitsPerPixel(), BitmapRef->GetBits() ) )
+            {
+                Frame->Rasterize( BitmapRef );
+            }
+        }
+
+        //== Expand the frame's grayscale data if it can be drawn 1:1, returns false otherwise.
+        //== IsGrayscale() also holds for MJPEG frames, so the frame type is checked instead ==--
+
+        static bool RasterizeGrayscale( Frame *Frame, unsigned int Width, unsigned int Height, unsigned int Span,
+                                        unsigned int BitsPerPixel, void *Buffer,
+                                        Core::eSIMDLevel Level = Core::BestSIMDLevel() )
+        {
+            if( !Buffer || Frame->FrameType() != Core::GrayscaleMode || (int) Width != Frame->Width() || (int) Height != Frame->Height()
+                || Span < Width * ( BitsPerPixel / 8 ) )
+            {
+                return false;
+            }
+
+            const unsigned char *gray = Frame->GetGrayscaleData();
+            if( !gray || (long long) Frame->GetGrayscaleDataSize() < (long long) Width * Height )
+            {
+                return false;
+            }
+
+            return Core::cGrayscaleExpand::Expand( gray, (int) Width, (int) Width, (int) Height,
+                                                   (unsigned char*) Buffer, (int) Span, (int) BitsPerPixel, Level );
+        }
+
+        //== Draw the region RoiX,RoiY,RoiWidth x RoiHeight of the frame (clipped to the frame) reduced
+        //== by Factor into the top left of the target.  A Factor below 1 picks the smallest factor
+        //== that fits the region into the target.  Target pixels outside the reduced region are
+        //== left untouched, returns false if nothing could be drawn ==--
+
+        static bool RasterizeRegion( Frame *Frame, int RoiX, int RoiY, int RoiWidth, int RoiHeight, int Factor,
+                                     unsigned int Width, unsigned int Height, unsigned int Span,
+                                     unsigned int BitsPerPixel, void *Buffer,
+                                     Core::eSIMDLevel Level = Core::BestSIMDLevel() )
+        {
+            int frameWidth  = Frame->Width();
+            int frameHeight = Frame->Height();
+
+            if( !Buffer || !ClipRegion( frameWidth, frameHeight, RoiX, RoiY, RoiWidth, RoiHeight )
+                || BitsPerPixel < 8 || BitsPerPixel > 32 || Span < Width * ( BitsPerPixel / 8 ) )
+            {
+                return false;
+            }
+
+            if( Factor < 1 )
+            {
+                Factor = Core::cBoxDownsample::FitFactor( RoiWidth, RoiHeight, (int) Width, (int) Height );
+            }
+
+            int outputWidth  = Core::cBoxDownsample::OutputSize( RoiWidth,  Factor );
+            int outputHeight = Core::cBoxDownsample::OutputSize( RoiHeight, Factor );
+
+            if( outputWidth  > (int) Width )  outputWidth  = (int) Width;
+            if( outputHeight > (int) Height ) outputHeight = (int) Height;
+
+            if( outputWidth <= 0 || outputHeight <= 0 )
+            {
+                return false;
+            }
+
+            Core::eVideoMode frameType = Frame->FrameType();
+
+            if( frameType == Core::SegmentMode || frameType == Core::PrecisionMode || frameType == Core::BitPackedPrecisionMode )
+            {
+                sSpanTarget target = { (unsigned char*) Buffer, outputWidth, outputHeight, (int) Span, (int) BitsPerPixel / 8 };
+                Clear( target, PIXELCOLOR(0,0,0) );
+                RegionSegments( Frame, target, RoiX, RoiY, Factor, PIXELCOLOR(255,255,255) );
+                return true;
+            }
+
+            const unsigned char *gray = ( frameType == Core::GrayscaleMode ) ? Frame->GetGrayscaleData() : 0;
+            if( gray && (long long) Frame->GetGrayscaleDataSize() >= (long long) frameWidth * frameHeight )
+            {
+                return Core::cBoxDownsample::Downsample( gray + (size_t) RoiY * frameWidth + RoiX, frameWidth,
+                                                         outputWidth, outputHeight, Factor,
+                                                         (unsigned char*) Buffer, (int) Span, (int) BitsPerPixel, Level );
+            }
+
+            std::vector<unsigned char> scratch( (size_t) frameWidth * frameHeight );
+            Frame->Rasterize( frameWidth, frameHeight, frameWidth, 8, &scratch[ 0 ] );
+
+            return Core::cBoxDownsample::Downsample( &scratch[ (size_t) RoiY * frameWidth + RoiX ], frameWidth,
+                                                     outputWidth, outputHeight, Factor,
+                                                     (unsigned char*) Buffer, (int) Span, (int) BitsPerPixel, Level );
+        }
+
+        static bool RasterizeRegion( Frame *Frame, int RoiX, int RoiY, int RoiWidth, int RoiHeight, int Factor,
+                                     Bitmap *BitmapRef, Core::eSIMDLevel Level = Core::BestSIMDLevel() )
+        {
+            return BitmapRef && RasterizeRegion( Frame, RoiX, RoiY, RoiWidth, RoiHeight, Factor,
+                                                 BitmapRef->PixelWidth(), BitmapRef->PixelHeight(), BitmapRef->ByteSpan(),
+                                                 BitmapRef->GetBitsPerPixel(), BitmapRef->GetBits(), Level );
+        }
+
+        //== Whole frame reduced to fit the target, e.g. for thumbnails ==--
+
+        static bool RasterizeThumbnail( Frame *Frame, Bitmap *BitmapRef, Core::eSIMDLevel Level = Core::BestSIMDLevel() )
+        {
+            return RasterizeRegion( Frame, 0, 0, Frame->Width(), Frame->Height(), 0, BitmapRef, Level );
+        }
+
+        //== Draw every segment of the frame's objects, returns the number of runs drawn ==--
+
+        static int RasterizeSegments( Frame *Frame, Bitmap *BitmapRef, PIXEL Color = PIXELCOLOR(255,255,255),
+                                      bool ClearFirst = true, PIXEL Background = PIXELCOLOR(0,0,0) )
+        {
+            sSpanTarget target;
+            if( !GetTarget( BitmapRef, target ) )
+            {
+                return 0;
+            }
+
+            if( ClearFirst )
+            {
+                Clear( target, Background );
+            }
+
+            unsigned char pixel[ 4 ];
+            PackPixel( Color, target.BytesPerPixel, pixel );
+
+            int drawn = 0;
+            int objectCount = Frame->ObjectCount();
+
+            for( int i = 0; i < objectCount; i++ )
+            {
+                cObject *object = Frame->Object( i );
+                for( Segment *segment = object ? object->Segments() : 0; segment; segment = segment->Next() )
+                {
+                    drawn += FillRun( target, segment->StartX(), segment->StartY(), segment->Length(), pixel );
+                }
+            }
+
+            return drawn;
+        }
+
+        //== Same, from segments already gathered into a cFrameSegments ==--
+
+        static int RasterizeSegments( const cFrameSegments &Segments, Bitmap *BitmapRef, PIXEL Color = PIXELCOLOR(255,255,255),
+                                      bool ClearFirst = true, PIXEL Background = PIXELCOLOR(0,0,0) )
+        {
+            sSpanTarget target;
+            if( !GetTarget( BitmapRef, target ) )
+            {
+                return 0;
+            }
+
+            if( ClearFirst )
+            {
+                Clear( target, Background );
+            }
+
+            unsigned char pixel[ 4 ];
+            PackPixel( Color, target.BytesPerPixel, pixel );
+
+            const unsigned short *startX = Segments.StartX();
+            const unsigned short *startY = Segments.StartY();
+            const unsigned short *length = Segments.Length();
+
+            int drawn = 0;
+            int count = Segments.SegmentCount();
+
+            for( int i = 0; i < count; i++ )
+            {
+                drawn += FillRun( target, startX[i], startY[i], length[i], pixel );
+            }
+
+            return drawn;
+        }
+
+        //== Draw a flat array of runs, any type with StartX, StartY and Length members (for example
+        //== sTestPatternSegment), returns the number of runs drawn ==--
+
+        template<typename RunType>
+        static int FillRuns( Bitmap *BitmapRef, const RunType *Runs, int Count, PIXEL Color = PIXELCOLOR(255,255,255) )
+        {
+            sSpanTarget target;
+            if( !GetTarget( BitmapRef, target ) )
+            {
+                return 0;
+            }
+
+            unsigned char pixel[ 4 ];
+            PackPixel( Color, target.BytesPerPixel, pixel );
+
+            int drawn = 0;
+            for( int i = 0; i < Count; i++ )
+            {
+                drawn += FillRun( target, Runs[ i ].StartX, Runs[ i ].StartY, Runs[ i ].Length, pixel );
+            }
+            return drawn;
+        }
+
+        //== Vectorized equivalent of Bitmap::HorizontalLine, X through X2 inclusive ==--
+
+        static void FillSpan( Bitmap *BitmapRef, int X, int Y, int X2, PIXEL Color )
+        {
+            sSpanTarget target;
+            if( GetTarget( BitmapRef, target ) )
+            {
+                unsigned char pixel[ 4 ];
+                PackPixel( Color, target.BytesPerPixel, pixel );
+                FillRun( target, X, Y, X2 - X + 1, pixel );
+            }
+        }
+
+        //== Fill the whole bitmap with a color using wide stores ==--
+
+        static void Clear( Bitmap *BitmapRef, PIXEL Color = PIXELCOLOR(0,0,0) )
+        {
+            sSpanTarget target;
+            if( GetTarget( BitmapRef, target ) )
+            {
+                Clear( target, Color );
+            }
+        }
+
+        static void Clear( unsigned int Width, unsigned int Height, unsigned int Span, unsigned int BitsPerPixel,
+                           void *Buffer, PIXEL Color = PIXELCOLOR(0,0,0) )
+        {
+            sSpanTarget target = { (unsigned char*) Buffer, (int) Width, (int) Height, (int) Span, (int) BitsPerPixel / 8 };
+            if( Buffer && target.BytesPerPixel >= 1 && target.BytesPerPixel <= 4
+                && target.Span >= target.Width * target.BytesPerPixel )
+            {
+                Clear( target, Color );
+            }
+        }
+
+        //== Pack a PIXEL for a target of 1-4 bytes per pixel ==--
+
+        static void PackPixel( PIXEL Color, int BytesPerPixel, unsigned char *Pixel )
+        {
+            int r = GetRedCol( Color );
+            int g = GetGreenCol( Color );
+            int b = GetBlueCol( Color );
+
+            switch( BytesPerPixel )
+            {
+            case 1:
+                Pixel[ 0 ] = (unsigned char) ( ( r * 77 + g * 150 + b * 29 ) >> 8 );
+                break;
+            case 2:
+            {
+                unsigned short value = (unsigned short) ( ( ( r >> 3 ) << 11 ) | ( ( g >> 2 ) << 5 ) | ( b >> 3 ) );
+                memcpy( Pixel, &value, 2 );
+                break;
+            }
+            case 3:
+                Pixel[ 0 ] = (unsigned char) r;
+                Pixel[ 1 ] = (unsigned char) g;
+                Pixel[ 2 ] = (unsigned char) b;
+                break;
+            default:
+                memcpy( Pixel, &Color, 4 );
+                break;
+            }
+        }
+
+    private:
+        struct sSpanTarget
+        {
+            unsigned char * Bits;
+            int             Width;
+            int             Height;
+            int             Span;
+            int             BytesPerPixel;
+        };
+
+        //== Fetch the bitmap's layout once per call instead of once per run ==--
+
+        static bool GetTarget( Bitmap *BitmapRef, sSpanTarget &Target )
+        {
+            Target.Bits          = BitmapRef ? BitmapRef->GetBits() : 0;
+            Target.Width         = Target.Bits ? BitmapRef->PixelWidth() : 0;
+            Target.Height        = Target.Bits ? BitmapRef->PixelHeight() : 0;
+            Target.Span          = Target.Bits ? BitmapRef->ByteSpan() : 0;
+            Target.BytesPerPixel = Target.Bits ? BitmapRef->GetBytesPerPixel() : 0;
+
+            return Target.Bits && Target.Width > 0 && Target.Height > 0 && Target.BytesPerPixel >= 1
+                && Target.BytesPerPixel <= 4 && Target.Span >= Target.Width * Target.BytesPerPixel;
+        }
+
+        static int FillRun( const sSpanTarget &Target, int X, int Y, int Length, const unsigned char *Pixel )
+        {
+            if( Y < 0 || Y >= Target.Height )
+            {
+                return 0;
+            }
+
+            int x2 = X + Length;
+            if( X < 0 )
+            {
+                X = 0;
+            }
+            if( x2 > Target.Width )
+            {
+                x2 = Target.Width;
+            }
+            if( x2 <= X )
+            {
+                return 0;
+            }
+
+            Core::cSpanFill::Fill( Target.Bits + (size_t) Y * Target.Span + (size_t) X * Target.BytesPerPixel,
+                                   x2 - X, Target.BytesPerPixel, Pixel );
+            return 1;
+        }
+
+        static bool ClipRegion( int FrameWidth, int FrameHeight, int &RoiX, int &RoiY, int &RoiWidth, int &RoiHeight )
+        {
+            if( RoiX < 0 ) { RoiWidth  += RoiX; RoiX = 0; }
+            if( RoiY < 0 ) { RoiHeight += RoiY; RoiY = 0; }
+            if( RoiWidth  > FrameWidth  - RoiX ) RoiWidth  = FrameWidth  - RoiX;
+            if( RoiHeight > FrameHeight - RoiY ) RoiHeight = FrameHeight - RoiY;
+
+            return RoiWidth > 0 && RoiHeight > 0;
+        }
+
+        //== A run covers every output pixel whose block it touches ==--
+
+        static void RegionSegments( Frame *Frame, const sSpanTarget &Target, int RoiX, int RoiY, int Factor, PIXEL Color )
+        {
+            unsigned char pixel[ 4 ];
+            PackPixel( Color, Target.BytesPerPixel, pixel );
+
+            int objectCount = Frame->ObjectCount();
+
+            for( int i = 0; i < objectCount; i++ )
+            {
+                cObject *object = Frame->Object( i );
+                for( Segment *segment = object ? object->Segments() : 0; segment; segment = segment->Next() )
+                {
+                    int y = segment->StartY() - RoiY;
+                    int x = segment->StartX() - RoiX;
+                    int length = segment->Length();
+
+                    if( y < 0 || x + length <= 0 || length <= 0 )
+                    {
+                        continue;
+                    }
+                    if( x < 0 )
+                    {
+                        length += x;
+                        x = 0;
+                    }
+
+                    int start = x / Factor;
+                    FillRun( Target, start, y / Factor, ( x + length - 1 ) / Factor - start + 1, pixel );
+                }
+            }
+        }
+
+        //== Rows without padding are cleared as one run ==--
+
+        static void Clear( const sSpanTarget &Target, PIXEL Color )
+        {
+            unsigned char pixel[ 4 ];
+            PackPixel( Color, Target.BytesPerPixel, pixel );
+
+            int rowBytes = Target.Width * Target.BytesPerPixel;
+
+            if( Target.Span == rowBytes && (long long) Target.Width * Target.Height <= 0x7fffffff )
+            {
+                Core::cSpanFill::Fill( Target.Bits, Target.Width * Target.Height, Target.BytesPerPixel, pixel );
+                return;
+            }
+
+            for( int y = 0; y < Target.Height; y++ )
+            {
+                Core::cSpanFill::Fill( Target.Bits + (size_t) y * Target.Span, Target.Width, Target.BytesPerPixel, pixel );
+            }
+        }
+    };
+}
+
+#endif
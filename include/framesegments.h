@@ -0,0 +1,185 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__FRAMESEGMENTS_H__
+#define __CAMERALIBRARY__FRAMESEGMENTS_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <string.h>
+#include <vector>
+
+#include "frame.h"
+#include "object.h"
+#include "segment.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Segments of one object: indices First through First + Count - 1 of the segment arrays ==--
+
+    struct sSegmentSpan
+    {
+        int     First;
+        int     Count;
+    };
+
+    //== A frame's segments in contiguous structure-of-arrays form.  Gather() walks each object's
+    //== Segment::Next() chain once; afterwards the columns can be streamed linearly, e.g. to
+    //== refit centroids or build masks, without chasing pointers through the library's lists.
+    //== Segments are stored object by object in Frame::Object() order and, within an object, in
+    //== chain order.  Columns are 16 bit, 8 bytes per segment, valid until the next Gather() ==--
+
+    class cFrameSegments
+    {
+    public:
+        cFrameSegments()
+        {
+            mStartX.reserve( kMaxSegmentsPerFrame );
+            mStartY.reserve( kMaxSegmentsPerFrame );
+            mLength.reserve( kMaxSegmentsPerFrame );
+            mObject.reserve( kMaxSegmentsPerFrame );
+            mObjectStart.reserve( kMaxObjectsPerFrame + 1 );
+        }
+        ~cFrameSegments() {}
+
+        //== Flatten the frame's segments, returns the segment count ==--
+
+        int     Gather( Frame *FrameRef )
+        {
+            Clear();
+
+            int objectCount = FrameRef ? FrameRef->ObjectCount() : 0;
+
+            for( int i = 0; i < objectCount; i++ )
+            {
+                mObjectStart.push_back( (int) mStartX.size() );
+
+                cObject *object = FrameRef->Object( i );
+                for( Segment *segment = object ? object->Segments() : 0; segment; segment = segment->Next() )
+                {
+                    mStartX.push_back( (unsigned short) segment->StartX() );
+                    mStartY.push_back( (unsigned short) segment->StartY() );
+                    mLength.push_back( (unsigned short) segment->Length() );
+                    mObject.push_back( (unsigned short) i );
+                }
+            }
+            mObjectStart.push_back( (int) mStartX.size() );
+
+            return SegmentCount();
+        }
+
+        void    Clear()
+        {
+            mStartX.clear();
+            mStartY.clear();
+            mLength.clear();
+            mObject.clear();
+            mObjectStart.clear();
+        }
+
+        int     SegmentCount() const { return (int) mStartX.size(); }
+        int     ObjectCount()  const { return mObjectStart.empty() ? 0 : (int) mObjectStart.size() - 1; }
+
+        //== Columns, SegmentCount() entries each ==--
+
+        const unsigned short * StartX()      const { return Column( mStartX ); }
+        const unsigned short * StartY()      const { return Column( mStartY ); }
+        const unsigned short * Length()      const { return Column( mLength ); }
+        const unsigned short * ObjectIndex() const { return Column( mObject ); }
+
+        //== Span accessor for one object's segments ==--
+
+        sSegmentSpan Segments( int ObjectIndex ) const
+        {
+            sSegmentSpan span = { 0, 0 };
+            if( ObjectIndex >= 0 && ObjectIndex < ObjectCount() )
+            {
+                span.First = mObjectStart[ ObjectIndex ];
+                span.Count = mObjectStart[ ObjectIndex + 1 ] - span.First;
+            }
+            return span;
+        }
+
+        //== Unweighted centroid and pixel count of every object in one pass over the columns, with
+        //== pixel centers at integer coordinates.  Arrays hold ObjectCount() entries; objects
+        //== without segments get an area of 0 and a centroid of 0, 0 ==--
+
+        void    Centroids( float *X, float *Y, int *Area ) const
+        {
+            int objectCount = ObjectCount();
+            for( int o = 0; o < objectCount; o++ )
+            {
+                long long sumX = 0, sumY = 0, area = 0;
+
+                //== sum of x over a run is Length * ( 2 * StartX + Length - 1 ) / 2, kept doubled ==--
+
+                for( int i = mObjectStart[o], end = mObjectStart[ o + 1 ]; i < end; i++ )
+                {
+                    long long length = mLength[i];
+                    sumX += length * ( 2 * (long long) mStartX[i] + length - 1 );
+                    sumY += length * mStartY[i];
+                    area += length;
+                }
+
+                X[o]    = area ? (float) ( (double) sumX / ( 2.0 * area ) ) : 0.0f;
+                Y[o]    = area ? (float) ( (double) sumY / area ) : 0.0f;
+                Area[o] = (int) area;
+            }
+        }
+
+        //== Set every segment pixel of an 8 bit mask to Value (clipped), returns the segments drawn ==--
+
+        int     FillMask( unsigned char *Mask, int Width, int Height, int Span, unsigned char Value = 255 ) const
+        {
+            if( !Mask )
+            {
+                return 0;
+            }
+
+            int drawn = 0;
+            int count = SegmentCount();
+
+            for( int i = 0; i < count; i++ )
+            {
+                int y  = mStartY[i];
+                int x1 = mStartX[i];
+                int x2 = x1 + mLength[i];
+
+                if( y >= Height || x1 >= Width || mLength[i] == 0 )
+                {
+                    continue;
+                }
+                if( x2 > Width )
+                {
+                    x2 = Width;
+                }
+
+                memset( Mask + (size_t) y * Span + x1, Value, x2 - x1 );
+                drawn++;
+            }
+
+            return drawn;
+        }
+
+    private:
+        cFrameSegments( const cFrameSegments& );
+        cFrameSegments& operator=( const cFrameSegments& );
+
+        static const unsigned short * Column( const std::vector<unsigned short> &Values )
+        {
+            return Values.empty() ? 0 : &Values[0];
+        }
+
+        std::vector<unsigned short> mStartX;
+        std::vector<unsigned short> mStartY;
+        std::vector<unsigned short> mLength;
+        std::vector<unsigned short> mObject;
+        std::vector<int>            mObjectStart;     //== ObjectCount() + 1 entries ==--
+    };
+}
+
+#endif
@@ -0,0 +1,396 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__FRAMESTREAMREADER_H__
+#define __CAMERALIBRARY__FRAMESTREAMREADER_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#if !defined(ZLIBIMPORTED)
+#error framestreamreader.h needs zlib: define ZLIBIMPORTED and link zlib
+#endif
+
+#include "ziphelpers.h"
+#include "Core/Frame.h"
+#include "Core/ArenaSerializer.h"
+#include "Core/MappedFileReader.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Frame streams are camera frames saved back to back (Core::cICameraFrame::Save) into a
+    //== chunked zlib stream, with every chunk holding whole frames.  That makes each chunk an
+    //== independent unit of work: cPrefetchFrameReader decompresses and parses chunks on prefetch
+    //== threads while the consumer works through frames that are already loaded.
+
+    const int kFrameStreamDefaultRingSize = 8;
+
+    //== Records frames into a frame stream.  The chunk size must exceed the largest frame ==--
+
+    class cFrameStreamWriter
+    {
+    public:
+        bool Open( const char *Filename, const sZipStreamSettings &Settings = sZipStreamSettings() )
+        {
+            return mStream.Open( Filename, Settings );
+        }
+
+        bool Close()
+        {
+            return mStream.Close();
+        }
+
+        void WriteFrame( const Core::cICameraFrame &Frame )
+        {
+            mFrame.Clear();
+            Frame.Save( &mFrame );
+
+            if( mFrame.BlockCount() == 1 )
+            {
+                mStream.WriteRecord( mFrame.Block( 0 ), (size_t) mFrame.BlockDataSize( 0 ) );
+                return;
+            }
+
+            //== frames spanning several serializer blocks are gathered so they stay in one chunk ==--
+
+            mGather.resize( (size_t) mFrame.Size() );
+            mFrame.Seek( 0 );
+            mFrame.ReadData( &mGather[ 0 ], mGather.size() );
+            mStream.WriteRecord( &mGather[ 0 ], mGather.size() );
+        }
+
+        cZipChunkWriter & Stream() { return mStream; }
+
+    private:
+        cZipChunkWriter             mStream;
+        Core::cArenaSerializer      mFrame;
+        std::vector<unsigned char>  mGather;
+    };
+
+    //== Prefetching frame stream reader.  PrefetchThreads threads claim chunks in order, decompress
+    //== them and load their frames through the frame factory into a ring of RingSize chunks.  The
+    //== consumer only waits (a stall) when the chunk it needs next has not been loaded yet ==--
+
+    class cPrefetchFrameReader
+    {
+    public:
+        cPrefetchFrameReader() : mFactory( 0 ), mVersion( Core::cICameraFrame::kCompressedFrameVersion ), mThreadCount( 0 ),
+            mNextClaim( 0 ), mCurrent( 0 ), mFrame( 0 ), mStarted( false ), mRunning( false ), mFramesRead( 0 ),
+            mChunksReady( 0 ), mChunksStalled( 0 ), mStallNanoseconds( 0 ), mLoadNanoseconds( 0 ), mErrors( 0 )
+        {
+        }
+
+        ~cPrefetchFrameReader()
+        {
+            Close();
+        }
+
+        //== Open a frame stream.  Factory creates the frame instances Load() is called on and must
+        //== outlive the reader ==--
+
+        bool Open( const char *Filename, const Core::cICameraFrameFactory *Factory, int PrefetchThreads = 1,
+            int RingSize = kFrameStreamDefaultRingSize, int Version = Core::cICameraFrame::kCompressedFrameVersion )
+        {
+            Close();
+
+            if( !Factory || !mStream.Open( Filename ) )
+            {
+                return false;
+            }
+
+            mFactory     = Factory;
+            mVersion     = Version;
+            mThreadCount = ( PrefetchThreads > 0 ) ? PrefetchThreads : 1;
+            mRing.resize( ( RingSize > mThreadCount ) ? RingSize : mThreadCount + 1 );
+
+            for( size_t i = 0; i < mRing.size(); i++ )
+            {
+                mRing[ i ] = new sSlot();
+            }
+
+            Start( 0 );
+
+            return true;
+        }
+
+        void Close()
+        {
+            Stop();
+
+            for( size_t i = 0; i < mRing.size(); i++ )
+            {
+                for( size_t j = 0; j < mRing[ i ]->Frames.size(); j++ )
+                {
+                    delete mRing[ i ]->Frames[ j ];
+                }
+                delete mRing[ i ];
+            }
+            mRing.clear();
+            mStream.Close();
+            mFactory = 0;
+        }
+
+        bool IsOpen() const { return !mRing.empty(); }
+
+        int  ChunkCount() const { return mStream.ChunkCount(); }
+
+        //== Next frame in stream order, or null at the end of the stream.  The frame belongs to the
+        //== reader and stays valid until the next call ==--
+
+        Core::cICameraFrame * NextFrame()
+        {
+            while( IsOpen() && mCurrent < mStream.ChunkCount() )
+            {
+                sSlot *slot = mRing[ mCurrent % mRing.size() ];
+
+                if( mFrame == 0 && !WaitForChunk( slot ) )
+                {
+                    return 0;
+                }
+
+                if( mFrame < slot->Count )
+                {
+                    mFramesRead++;
+                    return slot->Frames[ mFrame++ ];
+                }
+
+                //== chunk consumed, hand its slot back to the prefetch threads ==--
+
+                {
+                    std::lock_guard<std::mutex> lock( mLock );
+                    slot->State = SlotEmpty;
+                }
+                mSlotFreed.notify_all();
+
+                mCurrent++;
+                mFrame = 0;
+            }
+            return 0;
+        }
+
+        //== Restart reading at the first frame of a chunk ==--
+
+        bool SeekToChunk( int Chunk )
+        {
+            if( !IsOpen() || Chunk < 0 || Chunk > mStream.ChunkCount() )
+            {
+                return false;
+            }
+            Stop();
+            Start( Chunk );
+            return true;
+        }
+
+        //== Restart reading at the chunk holding an uncompressed stream offset ==--
+
+        bool SeekToOffset( unsigned long long Offset )
+        {
+            return SeekToChunk( mStream.FindChunk( Offset ) );
+        }
+
+        //== Statistics ==--
+
+        long long FramesRead()    const { return mFramesRead; }
+        long long ChunksReady()   const { return mChunksReady; }       //== needed chunk was already loaded ==--
+        long long ChunksStalled() const { return mChunksStalled; }     //== consumer had to wait ==--
+        long long Errors()        const { return mErrors; }
+
+        double    HitRate() const
+        {
+            long long total = mChunksReady + mChunksStalled;
+            return ( total > 0 ) ? (double) mChunksReady / (double) total : 0;
+        }
+
+        double    StallSeconds() const { return (double) mStallNanoseconds * 1e-9; }
+        double    LoadSeconds()  const { return (double) mLoadNanoseconds * 1e-9; }     //== summed over prefetch threads ==--
+
+    private:
+        enum eSlotState
+        {
+            SlotEmpty = 0,
+            SlotLoading,
+            SlotReady
+        };
+
+        struct sSlot
+        {
+            sSlot() : State( SlotEmpty ), Chunk( -1 ), Count( 0 ) { }
+
+            eSlotState                          State;
+            int                                 Chunk;
+            int                                 Count;      //== frames loaded ==--
+            std::vector<Core::cICameraFrame*>   Frames;     //== reused between chunks ==--
+            std::vector<unsigned char>          Data;
+        };
+
+        void Start( int Chunk )
+        {
+            for( size_t i = 0; i < mRing.size(); i++ )
+            {
+                mRing[ i ]->State = SlotEmpty;
+                mRing[ i ]->Chunk = -1;
+                mRing[ i ]->Count = 0;
+            }
+
+            mNextClaim = Chunk;
+            mCurrent   = Chunk;
+            mFrame     = 0;
+            mRunning   = true;
+            mStarted   = true;
+
+            for( int i = 0; i < mThreadCount; i++ )
+            {
+                mThreads.push_back( std::thread( &cPrefetchFrameReader::PrefetchThread, this ) );
+            }
+        }
+
+        void Stop()
+        {
+            if( !mStarted )
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mSlotFreed.notify_all();
+            for( size_t i = 0; i < mThreads.size(); i++ )
+            {
+                mThreads[ i ].join();
+            }
+            mThreads.clear();
+            mStarted = false;
+        }
+
+        bool WaitForChunk( sSlot *slot )
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            if( slot->State == SlotReady && slot->Chunk == mCurrent )
+            {
+                mChunksReady++;
+                return true;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            mSlotReady.wait( lock, [this, slot] { return slot->State == SlotReady && slot->Chunk == mCurrent; } );
+
+            mStallNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+            mChunksStalled++;
+            return true;
+        }
+
+        void PrefetchThread()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            while( true )
+            {
+                //== chunk N lives in slot N % RingSize, so claiming it waits until chunk N - RingSize
+                //== has been consumed ==--
+
+                int    chunk = mNextClaim;
+                sSlot *slot  = mRing[ chunk % mRing.size() ];
+
+                mSlotFreed.wait( lock, [this, chunk, slot] { return !mRunning || chunk != mNextClaim || chunk >= mStream.ChunkCount() || slot->State == SlotEmpty; } );
+
+                if( !mRunning || chunk >= mStream.ChunkCount() )
+                {
+                    break;
+                }
+                if( chunk != mNextClaim )
+                {
+                    continue;       //== another thread took it ==--
+                }
+
+                mNextClaim++;
+                slot->State = SlotLoading;
+                slot->Chunk = chunk;
+
+                lock.unlock();
+
+                Load( chunk, slot );
+
+                lock.lock();
+                slot->State = SlotReady;
+                mSlotReady.notify_all();
+                mSlotFreed.notify_all();
+            }
+        }
+
+        //== Decompress a chunk and load its frames (no lock held) ==--
+
+        void Load( int Chunk, sSlot *slot )
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            slot->Count = 0;
+            slot->Data.resize( mStream.Chunk( Chunk ).UncompressedSize );
+
+            if( slot->Data.empty() || !mStream.DecompressChunk( Chunk, &slot->Data[ 0 ] ) )
+            {
+                mErrors++;
+            }
+            else
+            {
+                Core::cMappedFileReader reader;
+                reader.Attach( &slot->Data[ 0 ], slot->Data.size() );
+
+                while( !reader.IsEOF() )
+                {
+                    if( slot->Count == (int) slot->Frames.size() )
+                    {
+                        slot->Frames.push_back( mFactory->CreateInstance() );
+                    }
+                    if( !slot->Frames[ slot->Count ]->Load( &reader, mVersion ) )
+                    {
+                        mErrors++;
+                        break;
+                    }
+                    slot->Count++;
+                }
+            }
+
+            mLoadNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+        }
+
+        cZipChunkReader                     mStream;
+        const Core::cICameraFrameFactory *  mFactory;
+        int                                 mVersion;
+        int                                 mThreadCount;
+
+        std::vector<sSlot*>                 mRing;
+        int                                 mNextClaim;
+        int                                 mCurrent;       //== chunk being consumed ==--
+        int                                 mFrame;         //== next frame within it ==--
+
+        bool                                mStarted;
+        bool                                mRunning;
+
+        std::atomic<long long>              mFramesRead;
+        std::atomic<long long>              mChunksReady;
+        std::atomic<long long>              mChunksStalled;
+        std::atomic<long long>              mStallNanoseconds;
+        std::atomic<long long>              mLoadNanoseconds;
+        std::atomic<long long>              mErrors;
+
+        std::vector<std::thread>            mThreads;
+        std::mutex                          mLock;
+        std::condition_variable             mSlotReady;
+        std::condition_variable             mSlotFreed;
+    };
+}
+
+#endif
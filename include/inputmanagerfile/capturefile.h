@@ -0,0 +1,97 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__CAPTUREFILE_H__
+#define __CAMERALIBRARY__CAPTUREFILE_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include "cameralibraryglobals.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+//== Raw capture files hold the camera packet stream exactly as it arrived at the cInputListener
+//== level so it can be replayed through the normal packet parsing path later on.
+//==
+//== Layout:
+//==
+//==   sCaptureFileHeader
+//==   record, record, record...          (sCaptureRecordHeader + payload, padded to 8 bytes,
+//==                                       unknown record types are skipped)
+//==   sCaptureIndexHeader                (optional, located by sCaptureFileHeader::IndexOffset)
+//==   sCaptureCameraInfo  x CameraCount
+//==   sCaptureIndexEntry  x EntryCount   (sorted by file offset)
+//==
+//== A camera info record is written ahead of the first packet of every camera, so a file that
+//== was never closed (no index) is still fully playable by scanning its records.
+
+namespace CameraLibrary
+{
+    const unsigned int kCaptureFileMagic      = 0x4643504E;  //== 'NPCF' ==--
+    const unsigned int kCaptureIndexMagic     = 0x5849504E;  //== 'NPIX' ==--
+    const unsigned int kCaptureFileVersion    = 1;
+    const unsigned int kCaptureRecordAlign    = 8;
+
+    enum eCaptureRecordTypes
+    {
+        CaptureRecordPadding = 0,    //== filler up to the end of a write chunk, skipped ==--
+        CaptureRecordCamera,         //== payload is sCaptureCameraInfo ==--
+        CaptureRecordPacket,         //== payload is a raw camera packet ==--
+        CaptureRecordComm            //== payload is a raw camera comm response ==--
+    };
+
+    struct sCaptureFileHeader
+    {
+        unsigned int       Magic;
+        unsigned int       Version;
+        unsigned long long IndexOffset;    //== zero until the capture is closed ==--
+        double             StartTimeStamp; //== host time stamp of the first record ==--
+        unsigned int       HeaderSize;     //== offset of the first record ==--
+        unsigned int       Reserved;
+    };
+
+    struct sCaptureRecordHeader
+    {
+        unsigned short     Type;
+        unsigned short     CameraIndex;
+        unsigned int       Size;           //== payload size, not including padding ==--
+        double             TimeStamp;      //== host arrival time (in seconds) ==--
+    };
+
+    struct sCaptureCameraInfo
+    {
+        int                Serial;
+        int                Revision;
+        int                SubModel;
+        int                Width;
+        int                Height;
+        int                FrameRate;
+        int                CameraID;
+        int                Reserved;
+        char               Name[kCameraNameMaxLen];
+    };
+
+    struct sCaptureIndexHeader
+    {
+        unsigned int       Magic;
+        unsigned int       CameraCount;
+        unsigned long long EntryCount;
+    };
+
+    struct sCaptureIndexEntry
+    {
+        int                CameraSerial;
+        int                FrameID;
+        unsigned long long HardwareTimeStamp;
+        unsigned long long Offset;         //== file offset of the first record of the frame ==--
+    };
+
+    inline unsigned long long CaptureRecordStride( unsigned int payloadSize )
+    {
+        return ( sizeof( sCaptureRecordHeader ) + payloadSize + kCaptureRecordAlign - 1 ) & ~( (unsigned long long) kCaptureRecordAlign - 1 );
+    }
+}
+
+#endif
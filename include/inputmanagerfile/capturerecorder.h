@@ -0,0 +1,570 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__CAPTURERECORDER_H__
+#define __CAMERALIBRARY__CAPTURERECORDER_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <string.h>
+#include <stdlib.h>
+
+#include "inputmanagerbase.h"
+#include "cameramodulebase.h"
+#include "cameramanager.h"
+#include "camera.h"
+#include "frame.h"
+#include "inputmanagerfile/capturefile.h"
+#include "inputmanagerfile/directfile.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Capture recorder writes the raw packet stream into the capture file format read by
+    //== cInputManagerFile.  Records are appended into large preallocated, sector aligned chunks
+    //== and a dedicated writer thread flushes full chunks with unbuffered (O_DIRECT /
+    //== FILE_FLAG_NO_BUFFERING) writes, so recording never blocks the thread delivering packets.
+    //== When every chunk is in flight the packet is dropped and counted instead of stalling.
+    //==
+    //== Every chunk is written at its full size.  A chunk that is sealed early is completed with a
+    //== padding record, which keeps direct writes sector aligned and the file seamlessly parsable.
+
+    const int kCaptureDefaultChunkSize  = 16 * 1024 * 1024;
+    const int kCaptureDefaultChunkCount = 8;
+    const int kCaptureSectorSize        = kDirectFileSectorSize;
+
+    const unsigned long long kCaptureNoOffset = ~0ULL;
+
+    class cCaptureRecorder
+    {
+    public:
+        cCaptureRecorder() : mChunkSize( 0 ), mCurrent( 0 ), mCurrentOffset( 0 ), mStartTimeStamp( 0 ), mStarted( false ),
+            mRecords( 0 ), mRunning( false ), mBytesRecorded( 0 ), mPacketsRecorded( 0 ), mPacketsDropped( 0 ),
+            mChunksWritten( 0 ), mWriteErrors( 0 )
+        {
+        }
+
+        ~cCaptureRecorder()
+        {
+            Close();
+        }
+
+        //== Start a new capture file.  ChunkSize is rounded up to the sector size and must hold
+        //== the largest packet; ChunkCount bounds the memory held by the recorder.
+
+        bool Open( const char *Filename, int ChunkSize = kCaptureDefaultChunkSize,
+            int ChunkCount = kCaptureDefaultChunkCount, bool DirectIO = true )
+        {
+            Close();
+
+            long long minimum = (long long) CaptureRecordStride( kMaxPacketSize ) + sizeof( sCaptureRecordHeader )
+                + sizeof( sCaptureFileHeader );
+
+            if( ChunkSize < minimum )
+            {
+                ChunkSize = (int) minimum;
+            }
+            if( ChunkCount < 2 )
+            {
+                ChunkCount = 2;
+            }
+
+            mChunkSize = ( (size_t) ChunkSize + kCaptureSectorSize - 1 ) & ~( (size_t) kCaptureSectorSize - 1 );
+
+            if( !mFile.Open( Filename, DirectIO ) )
+            {
+                return false;
+            }
+
+            for( int i = 0; i < ChunkCount; i++ )
+            {
+                sChunk *chunk = new sChunk();
+                chunk->Data   = (unsigned char*) cDirectFile::AlignedAllocate( mChunkSize );
+                chunk->Used   = 0;
+                chunk->Offset = 0;
+                mChunks.push_back( chunk );
+                mFree.push_back( chunk );
+            }
+
+            mCameras.clear();
+            mIndex.clear();
+            mFrameStart.clear();
+
+            mRecords         = 0;
+            mStartTimeStamp  = 0;
+            mStarted         = false;
+            mCurrentOffset   = 0;
+            mBytesRecorded   = 0;
+            mPacketsRecorded = 0;
+            mPacketsDropped  = 0;
+            mChunksWritten   = 0;
+            mWriteErrors     = 0;
+
+            //== file header lives at the start of the first chunk ==--
+
+            mCurrent = mFree.back();
+            mFree.pop_back();
+            mCurrent->Offset = 0;
+            mCurrent->Used   = sizeof( sCaptureFileHeader );
+
+            sCaptureFileHeader *header = (sCaptureFileHeader*) mCurrent->Data;
+            memset( header, 0, sizeof( sCaptureFileHeader ) );
+            header->Magic      = kCaptureFileMagic;
+            header->Version    = kCaptureFileVersion;
+            header->HeaderSize = sizeof( sCaptureFileHeader );
+
+            mRunning = true;
+            mThread  = std::thread( &cCaptureRecorder::WriterThread, this );
+
+            return true;
+        }
+
+        //== Flush everything, append the index and finalize the header ==--
+
+        bool Close()
+        {
+            if( !IsOpen() )
+            {
+                return false;
+            }
+
+            sChunk *tail = 0;
+            {
+                std::unique_lock<std::mutex> lock( mLock );
+                tail     = mCurrent;
+                mCurrent = 0;
+                mRunning = false;
+            }
+            mWork.notify_all();
+            mThread.join();
+
+            //== the tail chunk and index are written through a buffered handle, so they don't need
+            //== to be padded to the sector size ==--
+
+            bool success = mFile.Reopen( false );
+
+            if( success )
+            {
+                unsigned long long indexOffset = tail->Offset + tail->Used;
+
+                success = mFile.WriteAt( tail->Data, tail->Used, tail->Offset );
+
+                sCaptureIndexHeader index;
+                index.Magic       = kCaptureIndexMagic;
+                index.CameraCount = (unsigned int) mCameras.size();
+                index.EntryCount  = mIndex.size();
+
+                success = success && mFile.WriteAt( (const unsigned char*) &index, sizeof( index ), indexOffset );
+
+                unsigned long long offset = indexOffset + sizeof( index );
+
+                if( !mCameras.empty() )
+                {
+                    size_t size = mCameras.size() * sizeof( sCaptureCameraInfo );
+                    success = success && mFile.WriteAt( (const unsigned char*) &mCameras[ 0 ], size, offset );
+                    offset += size;
+                }
+                if( !mIndex.empty() )
+                {
+                    size_t size = mIndex.size() * sizeof( sCaptureIndexEntry );
+                    success = success && mFile.WriteAt( (const unsigned char*) &mIndex[ 0 ], size, offset );
+                }
+
+                sCaptureFileHeader header;
+                memset( &header, 0, sizeof( header ) );
+                header.Magic          = kCaptureFileMagic;
+                header.Version        = kCaptureFileVersion;
+                header.IndexOffset    = indexOffset;
+                header.StartTimeStamp = mStartTimeStamp;
+                header.HeaderSize     = sizeof( sCaptureFileHeader );
+
+                success = success && mFile.WriteAt( (const unsigned char*) &header, sizeof( header ), 0 );
+            }
+
+            mFile.Close();
+
+            for( size_t i = 0; i < mChunks.size(); i++ )
+            {
+                cDirectFile::AlignedFree( mChunks[ i ]->Data );
+                delete mChunks[ i ];
+            }
+            mChunks.clear();
+            mFree.clear();
+            mFull.clear();
+
+            return success;
+        }
+
+        bool IsOpen() const { return mChunks.size() > 0; }
+
+        //== Register a camera, returns the camera index used by Record() and MarkFrame().  TimeStamp
+        //== is stored with the camera record only; the file's StartTimeStamp is the first packet's ==--
+
+        int  AddCamera( const sCaptureCameraInfo &Info, double TimeStamp = 0 )
+        {
+            int index = 0;
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                index = (int) mCameras.size();
+                mCameras.push_back( Info );
+                mFrameStart.push_back( kCaptureNoOffset );
+            }
+
+            if( !Append( index, CaptureRecordCamera, (const unsigned char*) &Info, sizeof( Info ), TimeStamp ) )
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mCameras.pop_back();
+                mFrameStart.pop_back();
+                return -1;
+            }
+
+            return index;
+        }
+
+        int  CameraIndex( int Serial )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            for( size_t i = 0; i < mCameras.size(); i++ )
+            {
+                if( mCameras[ i ].Serial == Serial )
+                {
+                    return (int) i;
+                }
+            }
+            return -1;
+        }
+
+        //== Append a packet, never blocks on disk.  Returns false if the packet was dropped ==--
+
+        bool Record( int CameraIndex, const unsigned char *Buffer, long BufferSize, double TimeStamp,
+            eCaptureRecordTypes Type = CaptureRecordPacket )
+        {
+            if( BufferSize < 0 || BufferSize > kMaxPacketSize )
+            {
+                mPacketsDropped++;
+                return false;
+            }
+
+            if( !Append( CameraIndex, Type, Buffer, (unsigned int) BufferSize, TimeStamp ) )
+            {
+                mPacketsDropped++;
+                return false;
+            }
+
+            mPacketsRecorded++;
+            return true;
+        }
+
+        //== Close out a camera frame: index it at the first record received since the previous
+        //== frame of the same camera.
+
+        void MarkFrame( int CameraIndex, int FrameID, unsigned long long HardwareTimeStamp )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+
+            if( CameraIndex < 0 || CameraIndex >= (int) mCameras.size() || mFrameStart[ CameraIndex ] == kCaptureNoOffset )
+            {
+                return;
+            }
+
+            sCaptureIndexEntry entry;
+            entry.CameraSerial      = mCameras[ CameraIndex ].Serial;
+            entry.FrameID           = FrameID;
+            entry.HardwareTimeStamp = HardwareTimeStamp;
+            entry.Offset            = mFrameStart[ CameraIndex ];
+
+            //== keep the index in file order, packets of cameras interleave ==--
+
+            std::vector<sCaptureIndexEntry>::iterator position = mIndex.end();
+            while( position != mIndex.begin() && ( position - 1 )->Offset > entry.Offset )
+            {
+                --position;
+            }
+            mIndex.insert( position, entry );
+
+            mFrameStart[ CameraIndex ] = kCaptureNoOffset;
+        }
+
+        //== Statistics ==--
+
+        long long BytesRecorded()   const { return mBytesRecorded; }
+        long long PacketsRecorded() const { return mPacketsRecorded; }
+        long long PacketsDropped()  const { return mPacketsDropped; }
+        long long ChunksWritten()   const { return mChunksWritten; }
+        long long WriteErrors()     const { return mWriteErrors; }
+        bool      IsDirectIO()      const { return mFile.IsDirectIO(); }
+
+    private:
+        struct sChunk
+        {
+            unsigned char *    Data;
+            size_t             Used;
+            unsigned long long Offset;
+        };
+
+        bool Append( int CameraIndex, eCaptureRecordTypes Type, const unsigned char *Buffer, unsigned int Size, double TimeStamp )
+        {
+            const size_t stride = (size_t) CaptureRecordStride( Size );
+
+            std::unique_lock<std::mutex> lock( mLock );
+
+            if( mCurrent == 0 || CameraIndex < 0 || CameraIndex >= (int) mCameras.size() )
+            {
+                return false;
+            }
+
+            //== always leave room for a padding record at the end of the chunk ==--
+
+            if( mCurrent->Used + stride + sizeof( sCaptureRecordHeader ) > mChunkSize )
+            {
+                if( mFree.empty() )
+                {
+                    return false;
+                }
+
+                Seal();
+            }
+
+            //== playback positions are relative to the first packet; camera records carry no host time ==--
+
+            if( Type != CaptureRecordCamera && !mStarted )
+            {
+                mStarted        = true;
+                mStartTimeStamp = TimeStamp;
+                if( mCurrent->Offset == 0 )
+                {
+                    ( (sCaptureFileHeader*) mCurrent->Data )->StartTimeStamp = TimeStamp;
+                }
+            }
+
+            unsigned char *destination = mCurrent->Data + mCurrent->Used;
+
+            sCaptureRecordHeader *record = (sCaptureRecordHeader*) destination;
+            record->Type        = (unsigned short) Type;
+            record->CameraIndex = (unsigned short) CameraIndex;
+            record->Size        = Size;
+            record->TimeStamp   = TimeStamp;
+
+            memcpy( destination + sizeof( sCaptureRecordHeader ), Buffer, Size );
+            memset( destination + sizeof( sCaptureRecordHeader ) + Size, 0, stride - sizeof( sCaptureRecordHeader ) - Size );
+
+            if( Type != CaptureRecordCamera && mFrameStart[ CameraIndex ] == kCaptureNoOffset )
+            {
+                mFrameStart[ CameraIndex ] = mCurrent->Offset + mCurrent->Used;
+            }
+
+            mCurrent->Used += stride;
+            mBytesRecorded += stride;
+            mRecords++;
+
+            return true;
+        }
+
+        //== Pad out the current chunk, hand it to the writer and start the next (lock held) ==--
+
+        void Seal()
+        {
+            sCaptureRecordHeader *padding = (sCaptureRecordHeader*) ( mCurrent->Data + mCurrent->Used );
+            padding->Type        = CaptureRecordPadding;
+            padding->CameraIndex = 0;
+            padding->Size        = (unsigned int) ( mChunkSize - mCurrent->Used - sizeof( sCaptureRecordHeader ) );
+            padding->TimeStamp   = 0;
+            memset( padding + 1, 0, padding->Size );
+            mCurrent->Used = mChunkSize;
+
+            mCurrentOffset = mCurrent->Offset + mChunkSize;
+            mFull.push_back( mCurrent );
+
+            mCurrent = mFree.back();
+            mFree.pop_back();
+            mCurrent->Offset = mCurrentOffset;
+            mCurrent->Used   = 0;
+
+            mWork.notify_one();
+        }
+
+        void WriterThread()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            while( true )
+            {
+                mWork.wait( lock, [this] { return !mFull.empty() || !mRunning; } );
+
+                if( mFull.empty() )
+                {
+                    break;
+                }
+
+                sChunk *chunk = mFull.front();
+                mFull.pop_front();
+
+                lock.unlock();
+
+                if( mFile.WriteAt( chunk->Data, mChunkSize, chunk->Offset ) )
+                {
+                    mChunksWritten++;
+                }
+                else
+                {
+                    mWriteErrors++;
+                }
+
+                lock.lock();
+                mFree.push_back( chunk );
+            }
+        }
+
+        cDirectFile                       mFile;
+        size_t                            mChunkSize;
+
+        std::vector<sChunk*>              mChunks;
+        std::vector<sChunk*>              mFree;
+        std::deque<sChunk*>               mFull;
+        sChunk *                          mCurrent;
+        unsigned long long                mCurrentOffset;
+
+        std::vector<sCaptureCameraInfo>   mCameras;
+        std::vector<sCaptureIndexEntry>   mIndex;
+        std::vector<unsigned long long>   mFrameStart;
+        double                            mStartTimeStamp;
+        bool                              mStarted;
+        long long                         mRecords;
+
+        bool                              mRunning;
+
+        std::atomic<long long>            mBytesRecorded;
+        std::atomic<long long>            mPacketsRecorded;
+        std::atomic<long long>            mPacketsDropped;
+        std::atomic<long long>            mChunksWritten;
+        std::atomic<long long>            mWriteErrors;
+
+        std::thread                       mThread;
+        std::mutex                        mLock;
+        std::condition_variable           mWork;
+    };
+
+    //== Capture info for a live or virtual camera, for cCaptureRecorder::AddCamera() ==--
+
+    inline sCaptureCameraInfo CaptureCameraInfo( Camera *CameraRef )
+    {
+        sCaptureCameraInfo info;
+        memset( &info, 0, sizeof( info ) );
+
+        info.Serial    = CameraRef->Serial();
+        info.Revision  = CameraRef->Revision();
+        info.SubModel  = CameraRef->SubModel();
+        info.Width     = CameraRef->PhysicalPixelWidth();
+        info.Height    = CameraRef->PhysicalPixelHeight();
+        info.FrameRate = CameraRef->FrameRate();
+        info.CameraID  = CameraRef->CameraID();
+        strncpy( info.Name, CameraRef->Name(), kCameraNameMaxLen - 1 );
+
+        return info;
+    }
+
+    //== Capture tap listener, the capture route: sits between a software input (e.g. the memory
+    //== or file input manager) and its listener, recording every packet before forwarding it.
+    //== Camera modules are not an alternative, their IncomingData / IncomingComm hooks are never
+    //== called by the library.
+    //==
+    //== Frame boundaries come from the camera that parses the packets: when the downstream
+    //== listener is a Camera, the tap attaches a module to it whose PostFrame indexes each frame
+    //== (FrameID, hardware time stamp) at the first packet recorded since the previous frame.
+    //== Frames handed over whole through IncomingFrame are indexed the same way.  With any other
+    //== listener the capture has no frame index and plays back by time only ==--
+
+    class cInputCaptureTap : public cInputListener
+    {
+    public:
+        cInputCaptureTap( cCaptureRecorder *Recorder, int CameraIndex, cInputListener *Downstream )
+            : mRecorder( Recorder ), mCameraIndex( CameraIndex ), mDownstream( Downstream ), mCamera( 0 ),
+              mMarker( Recorder, CameraIndex )
+        {
+        }
+
+        cInputCaptureTap( cCaptureRecorder *Recorder, int CameraIndex, Camera *Downstream )
+            : mRecorder( Recorder ), mCameraIndex( CameraIndex ), mDownstream( Downstream ), mCamera( Downstream ),
+              mMarker( Recorder, CameraIndex )
+        {
+            if( mCamera )
+            {
+                mCamera->AttachModule( &mMarker );
+            }
+        }
+
+        ~cInputCaptureTap()
+        {
+            if( mCamera )
+            {
+                mCamera->RemoveModule( &mMarker );
+            }
+        }
+
+        void IncomingData( unsigned char *Buffer, long BufferSize )
+        {
+            mRecorder->Record( mCameraIndex, Buffer, BufferSize, CameraManager::X().TimeStamp() );
+            mDownstream->IncomingData( Buffer, BufferSize );
+        }
+
+        void IncomingComm( unsigned char *Buffer, long BufferSize )
+        {
+            mRecorder->Record( mCameraIndex, Buffer, BufferSize, CameraManager::X().TimeStamp(), CaptureRecordComm );
+            mDownstream->IncomingComm( Buffer, BufferSize );
+        }
+
+        void IncomingFrame( Frame *FrameRef )
+        {
+            if( FrameRef )
+            {
+                mRecorder->MarkFrame( mCameraIndex, FrameRef->FrameID(), FrameRef->HardwareTimeStamp() );
+            }
+            mDownstream->IncomingFrame( FrameRef );
+        }
+
+        void IncomingDebugMsg( const char *Text )                              { mDownstream->IncomingDebugMsg( Text ); }
+        void IncomingDisconnect()                                              { mDownstream->IncomingDisconnect(); }
+        void SendVirtualConfigurationData( cVirtualConfigurationData *Config ) { mDownstream->SendVirtualConfigurationData( Config ); }
+
+    private:
+        cInputCaptureTap( const cInputCaptureTap& );
+        cInputCaptureTap& operator=( const cInputCaptureTap& );
+
+        //== Indexes each frame the downstream camera parses out of the recorded packets ==--
+
+        class cFrameMarker : public cCameraModule
+        {
+        public:
+            cFrameMarker( cCaptureRecorder *Recorder, int CameraIndex ) : mRecorder( Recorder ), mCameraIndex( CameraIndex ) {}
+
+            bool PostFrame( Camera * /*Camera*/, Frame *FrameRef )
+            {
+                mRecorder->MarkFrame( mCameraIndex, FrameRef->FrameID(), FrameRef->HardwareTimeStamp() );
+
+                return false;   //== frame continues on to the rest of the module chain ==--
+            }
+
+        private:
+            cCaptureRecorder * mRecorder;
+            int                mCameraIndex;
+        };
+
+        cCaptureRecorder * mRecorder;
+        int                mCameraIndex;
+        cInputListener *   mDownstream;
+        Camera *           mCamera;
+        cFrameMarker       mMarker;
+    };
+}
+
+#endif
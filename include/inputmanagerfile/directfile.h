@@ -0,0 +1,205 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__DIRECTFILE_H__
+#define __CAMERALIBRARY__DIRECTFILE_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <malloc.h>
+#else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Positional write-only file used by the recorders.  In direct mode writes bypass the OS
+    //== cache (O_DIRECT / FILE_FLAG_NO_BUFFERING), which requires sector aligned buffers, offsets
+    //== and sizes; AlignedAllocate() provides suitable buffers.
+
+    const int kDirectFileSectorSize = 4096;
+
+    class cDirectFile
+    {
+    public:
+        cDirectFile() : mDirectIO( false )
+#ifdef WIN32
+            , mFile( INVALID_HANDLE_VALUE )
+#else
+            , mFile( -1 )
+#endif
+        {
+        }
+
+        ~cDirectFile()
+        {
+            Close();
+        }
+
+        //== Open for writing, falls back to buffered access if direct access is unavailable ==--
+
+        bool Open( const char *Filename, bool DirectIO, bool Truncate = true )
+        {
+            Close();
+
+            mFilename = Filename;
+
+            return OpenFile( DirectIO, Truncate ) || ( DirectIO && OpenFile( false, Truncate ) );
+        }
+
+        //== Reopen the same file, e.g. buffered to write an unaligned tail ==--
+
+        bool Reopen( bool DirectIO )
+        {
+            Close();
+
+            return OpenFile( DirectIO, false );
+        }
+
+        void Close()
+        {
+#ifdef WIN32
+            if( mFile != INVALID_HANDLE_VALUE )
+            {
+                CloseHandle( mFile );
+            }
+            mFile = INVALID_HANDLE_VALUE;
+#else
+            if( mFile >= 0 )
+            {
+                close( mFile );
+            }
+            mFile = -1;
+#endif
+        }
+
+#ifdef WIN32
+        bool IsOpen() const { return mFile != INVALID_HANDLE_VALUE; }
+#else
+        bool IsOpen() const { return mFile >= 0; }
+#endif
+        bool IsDirectIO() const { return mDirectIO; }
+
+        bool WriteAt( const unsigned char *Buffer, size_t Size, unsigned long long Offset )
+        {
+            while( Size > 0 )
+            {
+#ifdef WIN32
+                OVERLAPPED position;
+                memset( &position, 0, sizeof( position ) );
+                position.Offset     = (DWORD) ( Offset & 0xFFFFFFFF );
+                position.OffsetHigh = (DWORD) ( Offset >> 32 );
+
+                DWORD written = 0;
+                if( !WriteFile( mFile, Buffer, (DWORD) Size, &written, &position ) || written == 0 )
+                {
+                    return false;
+                }
+#else
+                ssize_t written = pwrite( mFile, Buffer, Size, (off_t) Offset );
+                if( written < 0 && errno == EINTR )
+                {
+                    continue;
+                }
+                if( written <= 0 )
+                {
+                    return false;
+                }
+#endif
+                Buffer += written;
+                Size   -= (size_t) written;
+                Offset += (unsigned long long) written;
+            }
+            return true;
+        }
+
+        //== Flush file data to the device ==--
+
+        bool Sync()
+        {
+#ifdef WIN32
+            return FlushFileBuffers( mFile ) != 0;
+#elif defined( __APPLE__ )
+            return fsync( mFile ) == 0;
+#else
+            return fdatasync( mFile ) == 0;
+#endif
+        }
+
+        static void * AlignedAllocate( size_t Size )
+        {
+#ifdef WIN32
+            return _aligned_malloc( Size, kDirectFileSectorSize );
+#else
+            void *memory = 0;
+            return ( posix_memalign( &memory, kDirectFileSectorSize, Size ) == 0 ) ? memory : 0;
+#endif
+        }
+
+        static void AlignedFree( void *Memory )
+        {
+#ifdef WIN32
+            _aligned_free( Memory );
+#else
+            free( Memory );
+#endif
+        }
+
+    private:
+        cDirectFile( const cDirectFile& );
+        cDirectFile& operator=( const cDirectFile& );
+
+        bool OpenFile( bool DirectIO, bool Truncate )
+        {
+#ifdef WIN32
+            DWORD flags = FILE_ATTRIBUTE_NORMAL | ( DirectIO ? ( FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH ) : 0 );
+            mFile = CreateFileA( mFilename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                Truncate ? CREATE_ALWAYS : OPEN_EXISTING, flags, nullptr );
+            mDirectIO = DirectIO && mFile != INVALID_HANDLE_VALUE;
+            return mFile != INVALID_HANDLE_VALUE;
+#else
+            int flags = O_WRONLY | O_CREAT | ( Truncate ? O_TRUNC : 0 );
+#ifdef O_DIRECT
+            if( DirectIO )
+            {
+                flags |= O_DIRECT;
+            }
+#else
+            DirectIO = false;
+#endif
+            mFile = open( mFilename.c_str(), flags, 0644 );
+            mDirectIO = DirectIO && mFile >= 0;
+            return mFile >= 0;
+#endif
+        }
+
+        std::string mFilename;
+        bool        mDirectIO;
+
+#ifdef WIN32
+        HANDLE      mFile;
+#else
+        int         mFile;
+#endif
+    };
+}
+
+#endif
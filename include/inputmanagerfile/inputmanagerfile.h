@@ -1,2 +1,587 @@
-//== Placeholder: No public interface ==--
 
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__INPUTMANAGERFILE_H__
+#define __CAMERALIBRARY__INPUTMANAGERFILE_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <string.h>
+
+#include "inputmanagerbase.h"
+#include "inputmanagervirtual.h"
+#include "inputmanagerfile/capturefile.h"
+
+#include "Core/MemoryMappedFile.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== File input manager replays a raw capture file (see capturefile.h) into virtual cameras.
+    //== Packets are handed to each camera's cInputListener::IncomingData straight out of a
+    //== copy-on-write memory mapping, so they travel the same parsing, module and synchronization
+    //== chain as live data without being copied or read through a file buffer.
+    //==
+    //== Playback is paced on the recorded host time stamps scaled by the playback rate.  A rate of
+    //== zero disables pacing completely and throughput is then bounded by CPU only.
+
+    const double kPlaybackAsFastAsPossible = 0.0;
+
+    class cInputManagerFile : public InputManager
+    {
+    public:
+        cInputManagerFile() : mStartTimeStamp( 0 ), mDuration( 0 ), mPlaybackRate( 1.0 ), mLooping( false ), mRunning( false ), mFinished( false ),
+            mFirstRecord( 0 ), mEndOfRecords( 0 ), mCursor( 0 ), mSeekRequest( kNoSeek ), mPosition( 0 ),
+            mPacketsDelivered( 0 ), mBytesDelivered( 0 )
+        {
+        }
+
+        ~cInputManagerFile()
+        {
+            Close();
+        }
+
+        //== Open / close a capture file ==--
+
+        bool Open( const char *Filename )
+        {
+            Close();
+
+            if( !mFile.Open( Filename, true ) || mFile.Size() < sizeof( sCaptureFileHeader ) )
+            {
+                mFile.Close();
+                return false;
+            }
+
+            const sCaptureFileHeader *header = (const sCaptureFileHeader*) mFile.Data();
+
+            if( header->Magic != kCaptureFileMagic || header->Version > kCaptureFileVersion
+                || header->HeaderSize < sizeof( sCaptureFileHeader ) || header->HeaderSize > mFile.Size() )
+            {
+                mFile.Close();
+                return false;
+            }
+
+            mStartTimeStamp = header->StartTimeStamp;
+            mFirstRecord    = header->HeaderSize;
+            mEndOfRecords   = mFile.Size();
+
+            if( !LoadIndex( header->IndexOffset ) )
+            {
+                ScanRecords();
+            }
+
+            mListeners.assign( mCameras.size(), (cInputListener*) 0 );
+            mCursor      = mFirstRecord;
+            mSeekRequest = kNoSeek;     //== drop seeks queued before Open(), e.g. by SetPlaybackRate() ==--
+            mFinished    = false;
+
+            mFile.Advise( Core::cMemoryMappedFile::AccessSequential );
+
+            return true;
+        }
+
+        void Close()
+        {
+            Stop();
+
+            mFile.Close();
+            mCameras.clear();
+            mIndex.clear();
+            mFrameIndex.clear();
+            mListeners.clear();
+            mFirstRecord  = 0;
+            mEndOfRecords = 0;
+            mCursor       = 0;
+            mSeekRequest  = kNoSeek;
+        }
+
+        bool IsOpen() const { return mFile.IsOpen(); }
+
+        //== Recorded cameras ==--
+
+        int  CameraCount() const { return (int) mCameras.size(); }
+        const sCaptureCameraInfo & CameraInfo( int Index ) const { return mCameras[ Index ]; }
+
+        //== Route a recorded camera's packets to a listener (typically a virtual Camera) ==--
+
+        void AttachListener( int CameraIndex, cInputListener *Listener )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            if( CameraIndex >= 0 && CameraIndex < (int) mListeners.size() )
+            {
+                mListeners[ CameraIndex ] = Listener;
+            }
+        }
+
+        //== Create a virtual camera matching a recorded camera, register it with the
+        //== CameraManager and route the recorded packets into it.
+
+        Camera * CreateVirtualCamera( int CameraIndex )
+        {
+            if( CameraIndex < 0 || CameraIndex >= CameraCount() )
+            {
+                return 0;
+            }
+
+            const sCaptureCameraInfo &info = mCameras[ CameraIndex ];
+
+            cVirtualConfigurationData config;
+
+            strncpy( config.CameraName, info.Name, kCameraNameMaxLen );
+            config.CameraName[ kCameraNameMaxLen - 1 ] = 0;
+            config.CameraWidth     = info.Width;
+            config.CameraHeight    = info.Height;
+            config.CameraFrameRate = info.FrameRate;
+            config.CameraRevision  = info.Revision;
+            config.CameraSerial    = info.Serial;
+            config.CameraSubModel  = info.SubModel;
+            config.CameraID        = info.CameraID;
+
+            Camera *camera = CameraLibrary::CreateVirtualCamera( config );
+
+            if( camera == 0 )
+            {
+                return 0;
+            }
+
+            AttachListener( CameraIndex, camera );
+
+            return camera;
+        }
+
+        int  CreateVirtualCameras()
+        {
+            int created = 0;
+
+            for( int i = 0; i < CameraCount(); i++ )
+            {
+                if( CreateVirtualCamera( i ) )
+                {
+                    created++;
+                }
+            }
+
+            return created;
+        }
+
+        //== Playback rate is a multiple of real time.  kPlaybackAsFastAsPossible (0) disables pacing ==--
+
+        void   SetPlaybackRate( double Multiple )
+        {
+            mPlaybackRate = ( Multiple > 0 ) ? Multiple : kPlaybackAsFastAsPossible;
+
+            //== re-base pacing on the current position ==--
+            RequestSeek( mCursor );
+        }
+
+        double PlaybackRate() const { return mPlaybackRate; }
+
+        void   SetLooping( bool Enable ) { mLooping = Enable; }
+        bool   Looping() const { return mLooping; }
+
+        //== Playback control ==--
+
+        bool Start()
+        {
+            if( !IsOpen() || mRunning )
+            {
+                return IsOpen();
+            }
+
+            mRunning  = true;
+            mFinished = false;
+            mThread   = std::thread( &cInputManagerFile::PlaybackThread, this );
+
+            return true;
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mWake.notify_all();
+
+            if( mThread.joinable() )
+            {
+                mThread.join();
+            }
+        }
+
+        bool IsPlaying()  const { return mRunning && !mFinished; }
+        bool IsFinished() const { return mFinished; }
+
+        //== Seek to a time (in seconds from the start of the capture) ==--
+
+        bool SeekToTime( double Seconds )
+        {
+            if( !IsOpen() )
+            {
+                return false;
+            }
+
+            const double target = mStartTimeStamp + Seconds;
+
+            unsigned long long offset = mFirstRecord;
+
+            if( !mIndex.empty() )
+            {
+                //== index entries are in file order and so in host time order as well ==--
+
+                size_t low = 0, high = mIndex.size();
+
+                while( low < high )
+                {
+                    size_t mid = ( low + high ) / 2;
+                    if( RecordAt( mIndex[ mid ].Offset )->TimeStamp < target )
+                    {
+                        low = mid + 1;
+                    }
+                    else
+                    {
+                        high = mid;
+                    }
+                }
+
+                offset = ( low > 0 ) ? mIndex[ low - 1 ].Offset : mFirstRecord;
+            }
+
+            //== walk forward to the exact record ==--
+
+            while( offset < mEndOfRecords )
+            {
+                const sCaptureRecordHeader *record = RecordAt( offset );
+
+                if( record == 0 || record->TimeStamp >= target )
+                {
+                    break;
+                }
+
+                offset += CaptureRecordStride( record->Size );
+            }
+
+            RequestSeek( offset );
+
+            return true;
+        }
+
+        //== Seek to the first packet of a camera's frame.  Requires an indexed capture ==--
+
+        bool SeekToFrame( int CameraSerial, int FrameID )
+        {
+            sCaptureIndexEntry key;
+            key.CameraSerial = CameraSerial;
+            key.FrameID      = FrameID;
+            key.Offset       = 0;
+
+            std::vector<sCaptureIndexEntry>::const_iterator entry =
+                std::lower_bound( mFrameIndex.begin(), mFrameIndex.end(), key, FrameOrder );
+
+            if( entry == mFrameIndex.end() || entry->CameraSerial != CameraSerial )
+            {
+                return false;
+            }
+
+            RequestSeek( entry->Offset );
+
+            return true;
+        }
+
+        //== Playback statistics ==--
+
+        double    Duration() const { return mDuration; }
+        double    Position() const { return mPosition; }                //== seconds from capture start ==--
+        long long PacketsDelivered() const { return mPacketsDelivered; }
+        long long BytesDelivered() const { return mBytesDelivered; }
+
+    private:
+        static const unsigned long long kNoSeek = ~0ULL;
+
+        const sCaptureRecordHeader * RecordAt( unsigned long long Offset ) const
+        {
+            if( Offset > mEndOfRecords || mEndOfRecords - Offset < sizeof( sCaptureRecordHeader ) )
+            {
+                return 0;
+            }
+
+            const sCaptureRecordHeader *record = (const sCaptureRecordHeader*) ( mFile.Data() + Offset );
+
+            if( record->Size > mEndOfRecords - Offset - sizeof( sCaptureRecordHeader ) )
+            {
+                return 0;
+            }
+
+            return record;
+        }
+
+        //== mFrameIndex order: by camera, then frame, then file offset ==--
+
+        static bool FrameOrder( const sCaptureIndexEntry &A, const sCaptureIndexEntry &B )
+        {
+            if( A.CameraSerial != B.CameraSerial )
+            {
+                return A.CameraSerial < B.CameraSerial;
+            }
+            if( A.FrameID != B.FrameID )
+            {
+                return A.FrameID < B.FrameID;
+            }
+            return A.Offset < B.Offset;
+        }
+
+        bool LoadIndex( unsigned long long IndexOffset )
+        {
+            const unsigned long long size = mFile.Size();
+
+            if( IndexOffset < mFirstRecord || IndexOffset > size || size - IndexOffset < sizeof( sCaptureIndexHeader ) )
+            {
+                return false;
+            }
+
+            const sCaptureIndexHeader *index = (const sCaptureIndexHeader*) ( mFile.Data() + IndexOffset );
+
+            //== bound the counts by the bytes left before multiplying, a corrupt header must not wrap ==--
+
+            unsigned long long available = size - IndexOffset - sizeof( sCaptureIndexHeader );
+
+            if( index->Magic != kCaptureIndexMagic || index->CameraCount > available / sizeof( sCaptureCameraInfo ) )
+            {
+                return false;
+            }
+
+            available -= index->CameraCount * sizeof( sCaptureCameraInfo );
+
+            if( index->EntryCount > available / sizeof( sCaptureIndexEntry ) )
+            {
+                return false;
+            }
+
+            const sCaptureCameraInfo *cameras = (const sCaptureCameraInfo*) ( index + 1 );
+            const sCaptureIndexEntry *entries = (const sCaptureIndexEntry*) ( cameras + index->CameraCount );
+
+            mCameras.assign( cameras, cameras + index->CameraCount );
+            mIndex.assign( entries, entries + (size_t) index->EntryCount );
+            mEndOfRecords = IndexOffset;
+
+            //== entries must point at records, SeekToTime() dereferences them ==--
+
+            for( size_t i = 0; i < mIndex.size(); i++ )
+            {
+                if( RecordAt( mIndex[ i ].Offset ) == 0 )
+                {
+                    mCameras.clear();
+                    mIndex.clear();
+                    mEndOfRecords = size;
+                    return false;
+                }
+            }
+
+            //== the index is in file order, keep a copy sorted per camera by frame for SeekToFrame() ==--
+
+            mFrameIndex = mIndex;
+            std::sort( mFrameIndex.begin(), mFrameIndex.end(), FrameOrder );
+
+            UpdateDuration();
+
+            return true;
+        }
+
+        void ScanRecords()
+        {
+            //== unindexed capture (recording was interrupted), collect cameras by walking the records ==--
+
+            unsigned long long offset = mFirstRecord;
+
+            while( const sCaptureRecordHeader *record = RecordAt( offset ) )
+            {
+                if( record->Type == CaptureRecordCamera && record->Size >= sizeof( sCaptureCameraInfo ) )
+                {
+                    if( record->CameraIndex >= mCameras.size() )
+                    {
+                        mCameras.resize( record->CameraIndex + 1 );
+                    }
+                    memcpy( &mCameras[ record->CameraIndex ], record + 1, sizeof( sCaptureCameraInfo ) );
+                }
+
+                offset += CaptureRecordStride( record->Size );
+            }
+
+            mEndOfRecords = offset;
+
+            UpdateDuration();
+        }
+
+        void UpdateDuration()
+        {
+            mDuration = 0;
+
+            unsigned long long last = mIndex.empty() ? mFirstRecord : mIndex.back().Offset;
+
+            while( const sCaptureRecordHeader *record = RecordAt( last ) )
+            {
+                mDuration = record->TimeStamp - mStartTimeStamp;
+                last += CaptureRecordStride( record->Size );
+            }
+        }
+
+        void RequestSeek( unsigned long long Offset )
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mCursor      = Offset;
+                mSeekRequest = Offset;
+                mFinished    = false;
+            }
+            mWake.notify_all();
+        }
+
+        void PlaybackThread()
+        {
+            typedef std::chrono::steady_clock clock;
+
+            clock::time_point  clockBase     = clock::now();
+            double             timeStampBase = -1;
+            unsigned long long offset        = mCursor;
+
+            mFile.Prefetch( offset, kPrefetchWindow );
+            unsigned long long prefetched = offset + kPrefetchWindow;
+
+            while( mRunning )
+            {
+                unsigned long long seek = mSeekRequest.exchange( kNoSeek );
+
+                if( seek != kNoSeek )
+                {
+                    offset        = seek;
+                    timeStampBase = -1;
+                    prefetched    = offset;
+                }
+
+                const sCaptureRecordHeader *record = RecordAt( offset );
+
+                if( record == 0 )
+                {
+                    if( mLooping && offset != mFirstRecord )
+                    {
+                        RequestSeek( mFirstRecord );
+                        continue;
+                    }
+
+                    mFinished = true;
+
+                    std::unique_lock<std::mutex> lock( mLock );
+                    mWake.wait( lock, [this] { return !mRunning || mSeekRequest != kNoSeek; } );
+                    continue;
+                }
+
+                //== keep the kernel reading ahead of the playback cursor ==--
+
+                if( offset + kPrefetchWindow / 2 > prefetched )
+                {
+                    mFile.Prefetch( prefetched, kPrefetchWindow );
+                    prefetched += kPrefetchWindow;
+                }
+
+                if( record->Type == CaptureRecordPacket || record->Type == CaptureRecordComm )
+                {
+                    double rate = mPlaybackRate;
+
+                    if( rate > 0 )
+                    {
+                        if( timeStampBase < 0 )
+                        {
+                            timeStampBase = record->TimeStamp;
+                            clockBase     = clock::now();
+                        }
+
+                        clock::time_point due = clockBase + std::chrono::duration_cast<clock::duration>(
+                            std::chrono::duration<double>( ( record->TimeStamp - timeStampBase ) / rate ) );
+
+                        if( due > clock::now() )
+                        {
+                            std::unique_lock<std::mutex> lock( mLock );
+                            if( mWake.wait_until( lock, due, [this] { return !mRunning || mSeekRequest != kNoSeek; } ) )
+                            {
+                                continue;
+                            }
+                        }
+                    }
+
+                    cInputListener *listener = 0;
+                    {
+                        std::lock_guard<std::mutex> lock( mLock );
+                        if( record->CameraIndex < mListeners.size() )
+                        {
+                            listener = mListeners[ record->CameraIndex ];
+                        }
+                    }
+
+                    if( listener )
+                    {
+                        unsigned char *payload = (unsigned char*) ( record + 1 );
+
+                        if( record->Type == CaptureRecordPacket )
+                        {
+                            listener->IncomingData( payload, (long) record->Size );
+                        }
+                        else
+                        {
+                            listener->IncomingComm( payload, (long) record->Size );
+                        }
+
+                        mPacketsDelivered++;
+                        mBytesDelivered += record->Size;
+                    }
+
+                    mPosition = record->TimeStamp - mStartTimeStamp;
+                }
+
+                offset += CaptureRecordStride( record->Size );
+                mCursor = offset;
+            }
+        }
+
+        static const unsigned long long kPrefetchWindow = 16 * 1024 * 1024;
+
+        Core::cMemoryMappedFile          mFile;
+
+        std::vector<sCaptureCameraInfo>  mCameras;
+        std::vector<sCaptureIndexEntry>  mIndex;
+        std::vector<sCaptureIndexEntry>  mFrameIndex;
+        std::vector<cInputListener*>     mListeners;
+
+        double                           mStartTimeStamp;
+        double                           mDuration;
+        std::atomic<double>              mPlaybackRate;
+        std::atomic<bool>                mLooping;
+        std::atomic<bool>                mRunning;
+        std::atomic<bool>                mFinished;
+
+        unsigned long long               mFirstRecord;
+        unsigned long long               mEndOfRecords;
+        std::atomic<unsigned long long>  mCursor;
+        std::atomic<unsigned long long>  mSeekRequest;
+
+        std::atomic<double>              mPosition;
+        std::atomic<long long>           mPacketsDelivered;
+        std::atomic<long long>           mBytesDelivered;
+
+        std::thread                      mThread;
+        std::mutex                       mLock;
+        std::condition_variable          mWake;
+    };
+}
+
+#endif
@@ -0,0 +1,246 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__INPUTMANAGERMEMORY_H__
+#define __CAMERALIBRARY__INPUTMANAGERMEMORY_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "inputmanagerbase.h"
+#include "inputmanagervirtual.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Memory input manager lets the application inject raw camera packets from its own memory.
+    //== Each channel routes to a cInputListener (typically a virtual camera) and packets are
+    //== delivered through cInputListener::IncomingData without being copied.  Submitted buffers
+    //== belong to the caller again once the completion callback has been called.
+    //==
+    //== Submit() queues packets for the delivery thread, which preserves submission order.
+    //== Deliver() parses synchronously on the calling thread, which is the lowest overhead path
+    //== for benchmarking the packet parser or fuzzing it at full speed.
+
+    typedef void (*MemoryPacketCompletion)( unsigned char *Buffer, long BufferSize, void *UserData );
+
+    const int kMemoryInputDefaultQueueDepth = 1024;
+
+    class cInputManagerMemory : public InputManager
+    {
+    public:
+        cInputManagerMemory( int QueueDepth = kMemoryInputDefaultQueueDepth ) : mHead( 0 ), mCount( 0 ),
+            mInFlight( false ), mRunning( true ), mPacketsDelivered( 0 ), mBytesDelivered( 0 ), mPacketsRejected( 0 )
+        {
+            mQueue.resize( QueueDepth > 0 ? QueueDepth : 1 );
+            mThread = std::thread( &cInputManagerMemory::DeliveryThread, this );
+        }
+
+        ~cInputManagerMemory()
+        {
+            //== packets still queued are delivered and completed before the thread exits ==--
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mNotEmpty.notify_all();
+            mThread.join();
+        }
+
+        //== Channels ==--
+
+        int  AddChannel( cInputListener *Listener )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            mChannels.push_back( Listener );
+            return (int) mChannels.size() - 1;
+        }
+
+        int  ChannelCount() { std::lock_guard<std::mutex> lock( mLock ); return (int) mChannels.size(); }
+
+        //== Create a virtual camera and a channel feeding it, returns the channel index or -1 ==--
+
+        int  AddVirtualCamera( cVirtualConfigurationData &Config, Camera **CreatedCamera = 0 )
+        {
+            Camera *camera = CreateVirtualCamera( Config );
+
+            if( CreatedCamera )
+            {
+                *CreatedCamera = camera;
+            }
+
+            return camera ? AddChannel( camera ) : -1;
+        }
+
+        //== Queue a packet for asynchronous delivery.  Returns false, without calling Completion,
+        //== when the channel is invalid or the queue is full and Wait is false.  Completion callbacks
+        //== run on the delivery thread, which cannot wait for itself to drain the queue, so Submit()
+        //== from a callback never waits: with a full queue it is rejected whatever Wait says.
+
+        bool Submit( int Channel, unsigned char *Buffer, long BufferSize, MemoryPacketCompletion Completion = 0,
+            void *UserData = 0, bool Wait = true )
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            if( Channel < 0 || Channel >= (int) mChannels.size() )
+            {
+                return false;
+            }
+
+            if( mCount == mQueue.size() )
+            {
+                if( !Wait || IsDeliveryThread() )
+                {
+                    mPacketsRejected++;
+                    return false;
+                }
+                mNotFull.wait( lock, [this] { return mCount < mQueue.size(); } );
+            }
+
+            sPacket &packet   = mQueue[ ( mHead + mCount ) % mQueue.size() ];
+            packet.Channel    = Channel;
+            packet.Buffer     = Buffer;
+            packet.BufferSize = BufferSize;
+            packet.Completion = Completion;
+            packet.UserData   = UserData;
+            mCount++;
+
+            lock.unlock();
+            mNotEmpty.notify_one();
+
+            return true;
+        }
+
+        //== Parse a packet synchronously on the calling thread ==--
+
+        bool Deliver( int Channel, unsigned char *Buffer, long BufferSize )
+        {
+            cInputListener *listener = Listener( Channel );
+
+            if( listener == 0 )
+            {
+                return false;
+            }
+
+            listener->IncomingData( Buffer, BufferSize );
+
+            mPacketsDelivered++;
+            mBytesDelivered += BufferSize;
+
+            return true;
+        }
+
+        //== Block until every submitted packet has been delivered and completed.  Returns false at
+        //== once when called from a completion callback, which would otherwise wait on itself ==--
+
+        bool WaitForIdle()
+        {
+            if( IsDeliveryThread() )
+            {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock( mLock );
+            mIdle.wait( lock, [this] { return mCount == 0 && !mInFlight; } );
+            return true;
+        }
+
+        //== Statistics ==--
+
+        int       QueueDepth() const       { return (int) mQueue.size(); }
+        int       QueuedPackets()          { std::lock_guard<std::mutex> lock( mLock ); return (int) mCount; }
+        long long PacketsDelivered() const { return mPacketsDelivered; }
+        long long BytesDelivered() const   { return mBytesDelivered; }
+        long long PacketsRejected() const  { return mPacketsRejected; }
+
+    private:
+        struct sPacket
+        {
+            int                    Channel;
+            unsigned char *        Buffer;
+            long                   BufferSize;
+            MemoryPacketCompletion Completion;
+            void *                 UserData;
+        };
+
+        bool IsDeliveryThread() const { return std::this_thread::get_id() == mThread.get_id(); }
+
+        cInputListener * Listener( int Channel )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return ( Channel >= 0 && Channel < (int) mChannels.size() ) ? mChannels[ Channel ] : 0;
+        }
+
+        void DeliveryThread()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            while( true )
+            {
+                mNotEmpty.wait( lock, [this] { return mCount > 0 || !mRunning; } );
+
+                if( mCount == 0 )
+                {
+                    break;
+                }
+
+                sPacket packet = mQueue[ mHead ];
+                cInputListener *listener = mChannels[ packet.Channel ];
+                mHead = ( mHead + 1 ) % mQueue.size();
+                mCount--;
+                mInFlight = true;
+
+                lock.unlock();
+                mNotFull.notify_one();
+
+                if( listener )
+                {
+                    listener->IncomingData( packet.Buffer, packet.BufferSize );
+                    mPacketsDelivered++;
+                    mBytesDelivered += packet.BufferSize;
+                }
+
+                if( packet.Completion )
+                {
+                    packet.Completion( packet.Buffer, packet.BufferSize, packet.UserData );
+                }
+
+                lock.lock();
+                mInFlight = false;
+
+                if( mCount == 0 )
+                {
+                    mIdle.notify_all();
+                }
+            }
+        }
+
+        std::vector<cInputListener*> mChannels;
+
+        std::vector<sPacket>         mQueue;            //== fixed size ring, no allocation per packet ==--
+        size_t                       mHead;
+        size_t                       mCount;
+        bool                         mInFlight;
+        bool                         mRunning;
+
+        std::atomic<long long>       mPacketsDelivered;
+        std::atomic<long long>       mBytesDelivered;
+        std::atomic<long long>       mPacketsRejected;
+
+        std::thread                  mThread;
+        std::mutex                   mLock;
+        std::condition_variable      mNotEmpty;
+        std::condition_variable      mNotFull;
+        std::condition_variable      mIdle;
+    };
+}
+
+#endif
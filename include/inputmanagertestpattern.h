@@ -1,2 +1,654 @@
-//== Placeholder: No public interface ==--
 
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__INPUTMANAGERTESTPATTERN_H__
+#define __CAMERALIBRARY__INPUTMANAGERTESTPATTERN_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <string.h>
+
+#include "inputmanagerbase.h"
+#include "cameralibraryglobals.h"
+
+#include "Core/Frame.h"
+#include "Core/IReader.h"
+#include "Core/IWriter.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== The test pattern input manager is a synthetic load generator.  It simulates N cameras each
+    //== observing M moving markers at a given frame rate and video mode, with smooth marker motion,
+    //== centroid jitter and occlusion.  Every frame is a complete Core::cICameraFrame (objects,
+    //== segment runs and, for image modes, a rendered 8-bit image) so it can be pushed through
+    //== recording, take and rasterization code paths exactly like recorded camera data.
+    //==
+    //== Frames go straight to a cTestPatternListener.  The camera packet format is private to the
+    //== library, so no packets are synthesized and frames do not pass through Camera parsing,
+    //== camera modules or frame synchronization; this loads the consumers of frames, not the
+    //== camera pipeline.  To load that pipeline, replay a capture with cInputManagerFile.
+
+    const int          kTestPatternFrameVersion = 1;
+    const unsigned int kTestPatternTimeFreq     = 1000000;     //== hardware time stamp ticks / sec ==--
+    const int          kTestPatternFirstSerial  = 990000;
+
+    struct sTestPatternSettings
+    {
+        sTestPatternSettings()
+        {
+            CameraCount   = 4;
+            MarkerCount   = 20;
+            FrameRate     = 120;
+            VideoMode     = Core::ObjectMode;
+            Width         = 1280;
+            Height        = 1024;
+            Revision      = 0;
+            MarkerRadius  = 4.0f;
+            MarkerSpeed   = 250.0f;
+            Jitter        = 0.05f;
+            OcclusionRate = 0.01f;
+            OcclusionTime = 0.1f;
+            Seed          = 1;
+            ThreadCount   = 0;
+        }
+
+        int              CameraCount;    //== number of simulated cameras ==--
+        int              MarkerCount;    //== markers visible to every camera ==--
+        int              FrameRate;      //== frames per second, per camera ==--
+        Core::eVideoMode VideoMode;      //== Object/Segment/Precision modes produce objects & runs,
+                                         //== Grayscale/MJPEG modes additionally render an image ==--
+        int              Width;          //== imager size (in pixels) ==--
+        int              Height;
+        int              Revision;       //== reported camera revision ==--
+        float            MarkerRadius;   //== mean marker radius (in pixels) ==--
+        float            MarkerSpeed;    //== mean marker speed (in pixels / second) ==--
+        float            Jitter;         //== centroid noise standard deviation (in pixels) ==--
+        float            OcclusionRate;  //== probability per marker per frame of becoming occluded ==--
+        float            OcclusionTime;  //== mean occlusion duration (in seconds) ==--
+        unsigned int     Seed;           //== generators are deterministic for a given seed ==--
+        int              ThreadCount;    //== generator threads, zero for one per core ==--
+    };
+
+    struct sTestPatternObject
+    {
+        float X;
+        float Y;
+        float Area;
+        float Roundness;
+    };
+
+    struct sTestPatternSegment
+    {
+        int StartX;
+        int StartY;
+        int Length;
+        int Object;     //== index of the owning object ==--
+    };
+
+    const int kTestPatternObjectFields  = 4;
+    const int kTestPatternSegmentFields = 4;
+
+    static_assert( sizeof( sTestPatternObject )  == kTestPatternObjectFields  * sizeof( float ), "object must be flat floats" );
+    static_assert( sizeof( sTestPatternSegment ) == kTestPatternSegmentFields * sizeof( int ),   "segment must be flat ints" );
+
+    //== Synthetic camera frame ===========================================================================----
+
+    class cTestPatternFrame : public Core::cICameraFrame
+    {
+    public:
+        cTestPatternFrame() : mSerial( 0 ), mRevision( 0 ), mCameraID( 0 ), mFrameID( 0 ), mFrameType( Core::ObjectMode ),
+            mTimeStamp( 0 ), mHardwareTimeStamp( 0 )
+        {
+        }
+
+        //== Synthetic data accessors ==--
+
+        const sTestPatternObject  * Objects()  const { return mObjects.empty()  ? 0 : &mObjects[ 0 ];  }
+        const sTestPatternSegment * Segments() const { return mSegments.empty() ? 0 : &mSegments[ 0 ]; }
+        const unsigned char       * Image()    const { return mImage.empty()    ? 0 : &mImage[ 0 ];    }
+        int                         ImageSize() const { return (int) mImage.size(); }
+
+        //== Core::cICameraFrame ==--
+
+        void Save( Core::cIWriter *stream ) const
+        {
+            stream->WriteInt( kTestPatternFrameVersion );
+            stream->WriteInt( mSerial );
+            stream->WriteInt( mRevision );
+            stream->WriteInt( mCameraID );
+            stream->WriteInt( mFrameID );
+            stream->WriteInt( (int) mFrameType );
+            stream->WriteDouble( mTimeStamp );
+            stream->WriteLongLong( mHardwareTimeStamp );
+
+            //== objects are four floats and segments four ints, written as flat arrays ==--
+
+            stream->WriteInt( (int) mObjects.size() );
+            if( !mObjects.empty() )
+            {
+                stream->WriteArray( &mObjects[ 0 ].X, mObjects.size() * kTestPatternObjectFields );
+            }
+
+            stream->WriteInt( (int) mSegments.size() );
+            if( !mSegments.empty() )
+            {
+                stream->WriteArray( &mSegments[ 0 ].StartX, mSegments.size() * kTestPatternSegmentFields );
+            }
+
+            stream->WriteInt( (int) mImage.size() );
+            if( !mImage.empty() )
+            {
+                stream->WriteData( &mImage[ 0 ], mImage.size() );
+            }
+        }
+
+        bool Load( Core::cIReader *stream, int /*version*/ = kCompressedFrameVersion )
+        {
+            if( stream->ReadInt() != kTestPatternFrameVersion )
+            {
+                return false;
+            }
+
+            mSerial            = stream->ReadInt();
+            mRevision          = stream->ReadInt();
+            mCameraID          = stream->ReadInt();
+            mFrameID           = stream->ReadInt();
+            mFrameType         = (Core::eVideoMode) stream->ReadInt();
+            mTimeStamp         = stream->ReadDouble();
+            mHardwareTimeStamp = stream->ReadLongLong();
+
+            int count = stream->ReadInt();
+            if( count < 0 || count > kMaxObjectsPerFrame )
+            {
+                return false;
+            }
+            mObjects.resize( count );
+            if( count > 0 && stream->ReadArray( &mObjects[ 0 ].X, count * kTestPatternObjectFields )
+                != (unsigned long long) count * kTestPatternObjectFields )
+            {
+                return false;
+            }
+
+            count = stream->ReadInt();
+            if( count < 0 || count > kMaxSegmentsPerFrame )
+            {
+                return false;
+            }
+            mSegments.resize( count );
+            if( count > 0 && stream->ReadArray( &mSegments[ 0 ].StartX, count * kTestPatternSegmentFields )
+                != (unsigned long long) count * kTestPatternSegmentFields )
+            {
+                return false;
+            }
+
+            count = stream->ReadInt();
+            if( count < 0 || count > kMaxPacketSize * 8 )
+            {
+                return false;
+            }
+            mImage.resize( count );
+            if( count > 0 && stream->ReadData( &mImage[ 0 ], count ) != (unsigned long long) count )
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        //== the payload is this class's own layout, not the library's ObjectOnly format ==--
+
+        eCompressedFrameTypes CompressionType() const { return TestPattern; }
+
+        bool             IsInvalid() const         { return false; }
+        double           TimeStamp() const         { return mTimeStamp; }
+        int              ObjectCount() const       { return (int) mObjects.size(); }
+        int              SegmentCount() const      { return (int) mSegments.size(); }
+        int              FrameID() const           { return mFrameID; }
+        Core::eVideoMode FrameType() const         { return mFrameType; }
+        int              Serial() const            { return mSerial; }
+        int              Revision() const          { return mRevision; }
+        int              CameraID() const          { return mCameraID; }
+
+        long             MemorySize() const
+        {
+            return (long) ( sizeof( *this ) + mObjects.capacity() * sizeof( sTestPatternObject )
+                + mSegments.capacity() * sizeof( sTestPatternSegment ) + mImage.capacity() );
+        }
+
+        void             RemoveData()              { mObjects.clear(); mSegments.clear(); mImage.clear(); }
+        bool             IsEmpty() const           { return mObjects.empty() && mImage.empty(); }
+        bool             IsSyncFrame() const       { return false; }
+
+        long long        HardwareTimeStamp() const { return mHardwareTimeStamp; }
+        unsigned int     HardwareTimeFreq() const  { return kTestPatternTimeFreq; }
+
+        bool             IsTimeCodeValid() const   { return false; }
+        Core::cTimeCode  TimeCode() const          { return Core::cTimeCode(); }
+
+        int              IMUTelemetryCount() const { return 0; }
+        unsigned char *  IMUTelemetry( int /*index*/ ) const { return 0; }
+
+        unsigned char *  ObjectData() const        { return (unsigned char*) Objects(); }
+        unsigned char *  SegmentData() const       { return (unsigned char*) Segments(); }
+        unsigned char *  PacketData() const        { return (unsigned char*) Image(); }
+        int              PacketDataSize() const    { return ImageSize(); }
+
+    private:
+        friend class cTestPatternGenerator;
+
+        int              mSerial;
+        int              mRevision;
+        int              mCameraID;
+        int              mFrameID;
+        Core::eVideoMode mFrameType;
+        double           mTimeStamp;
+        long long        mHardwareTimeStamp;
+
+        std::vector<sTestPatternObject>  mObjects;
+        std::vector<sTestPatternSegment> mSegments;
+        std::vector<unsigned char>       mImage;
+    };
+
+    //== Synthetic camera =================================================================================----
+
+    //== One generator simulates one camera.  Generation is deterministic for a given seed and
+    //== camera index, and allocation free once the frame passed in has warmed up.
+
+    class cTestPatternGenerator
+    {
+    public:
+        cTestPatternGenerator() : mCameraIndex( 0 ), mFrameID( 0 ), mState( 1 ) {}
+
+        void Initialize( const sTestPatternSettings &Settings, int CameraIndex )
+        {
+            mSettings    = Settings;
+            mCameraIndex = CameraIndex;
+            mFrameID     = 0;
+            mState       = ( Settings.Seed + 1 ) * 2654435761u + CameraIndex * 40503u + 1;
+
+            mMarkers.resize( Settings.MarkerCount );
+
+            for( size_t i = 0; i < mMarkers.size(); i++ )
+            {
+                sMarker &marker = mMarkers[ i ];
+
+                float heading = Uniform() * 6.2831853f;
+                float speed   = Settings.MarkerSpeed * ( 0.5f + Uniform() );
+
+                marker.X        = Settings.Width  * ( 0.05f + 0.9f * Uniform() );
+                marker.Y        = Settings.Height * ( 0.05f + 0.9f * Uniform() );
+                marker.VX       = cosf( heading ) * speed;
+                marker.VY       = sinf( heading ) * speed;
+                marker.Radius   = Settings.MarkerRadius * ( 0.6f + 0.8f * Uniform() );
+                marker.Occluded = 0;
+            }
+        }
+
+        int  CameraIndex() const { return mCameraIndex; }
+        int  Serial() const { return kTestPatternFirstSerial + mCameraIndex; }
+
+        //== Advance the simulation by one frame period and fill Frame with the result ==--
+
+        void Generate( cTestPatternFrame &Frame )
+        {
+            const float dt = 1.0f / ( mSettings.FrameRate > 0 ? mSettings.FrameRate : 1 );
+
+            Frame.mSerial            = Serial();
+            Frame.mRevision          = mSettings.Revision;
+            Frame.mCameraID          = mCameraIndex + 1;
+            Frame.mFrameID           = mFrameID;
+            Frame.mFrameType         = mSettings.VideoMode;
+            Frame.mTimeStamp         = mFrameID * (double) dt;
+            Frame.mHardwareTimeStamp = (long long) ( mFrameID * (double) kTestPatternTimeFreq * dt );
+
+            Frame.mObjects.clear();
+            Frame.mSegments.clear();
+
+            const bool segments = mSettings.VideoMode == Core::SegmentMode || mSettings.VideoMode == Core::PrecisionMode
+                || mSettings.VideoMode == Core::BitPackedPrecisionMode;
+            const bool image    = mSettings.VideoMode == Core::GrayscaleMode || mSettings.VideoMode == Core::MJPEGMode
+                || mSettings.VideoMode == Core::InterleavedGrayscaleMode;
+
+            if( image )
+            {
+                Frame.mImage.assign( (size_t) mSettings.Width * mSettings.Height, 0 );
+            }
+            else
+            {
+                Frame.mImage.clear();
+            }
+
+            for( size_t i = 0; i < mMarkers.size(); i++ )
+            {
+                sMarker &marker = mMarkers[ i ];
+
+                Advance( marker, dt );
+
+                if( marker.Occluded > 0 || (int) Frame.mObjects.size() >= kMaxObjectsPerFrame )
+                {
+                    continue;
+                }
+
+                sTestPatternObject object;
+
+                object.X         = marker.X + Gaussian() * mSettings.Jitter;
+                object.Y         = marker.Y + Gaussian() * mSettings.Jitter;
+                object.Area      = 3.1415927f * marker.Radius * marker.Radius * ( 1.0f + 0.05f * Gaussian() );
+                object.Roundness = 0.98f - 0.04f * Uniform();
+
+                if( segments )
+                {
+                    AddSegments( Frame, object, marker.Radius );
+                }
+                if( image )
+                {
+                    RenderMarker( Frame, object, marker.Radius );
+                }
+
+                Frame.mObjects.push_back( object );
+            }
+
+            mFrameID++;
+        }
+
+    private:
+        struct sMarker
+        {
+            float X, Y;
+            float VX, VY;
+            float Radius;
+            float Occluded;     //== remaining occlusion time (in seconds) ==--
+        };
+
+        void Advance( sMarker &marker, float dt )
+        {
+            //== smooth motion: damped random acceleration around the mean speed ==--
+
+            float accel = mSettings.MarkerSpeed * 2.0f;
+
+            marker.VX += ( Gaussian() * accel - marker.VX * 0.1f ) * dt;
+            marker.VY += ( Gaussian() * accel - marker.VY * 0.1f ) * dt;
+            marker.X  += marker.VX * dt;
+            marker.Y  += marker.VY * dt;
+
+            float margin = marker.Radius + 1.0f;
+
+            if( marker.X < margin )                    { marker.X = margin;                    marker.VX =  fabsf( marker.VX ); }
+            if( marker.Y < margin )                    { marker.Y = margin;                    marker.VY =  fabsf( marker.VY ); }
+            if( marker.X > mSettings.Width  - margin ) { marker.X = mSettings.Width  - margin; marker.VX = -fabsf( marker.VX ); }
+            if( marker.Y > mSettings.Height - margin ) { marker.Y = mSettings.Height - margin; marker.VY = -fabsf( marker.VY ); }
+
+            if( marker.Occluded > 0 )
+            {
+                marker.Occluded -= dt;
+            }
+            else if( Uniform() < mSettings.OcclusionRate )
+            {
+                marker.Occluded = mSettings.OcclusionTime * 2.0f * Uniform();
+            }
+        }
+
+        void AddSegments( cTestPatternFrame &Frame, const sTestPatternObject &object, float radius )
+        {
+            int top    = (int) ceilf ( object.Y - radius );
+            int bottom = (int) floorf( object.Y + radius );
+
+            for( int y = top; y <= bottom && (int) Frame.mSegments.size() < kMaxSegmentsPerFrame; y++ )
+            {
+                float dy   = y - object.Y;
+                float half = sqrtf( radius * radius - dy * dy );
+                int   x1   = (int) ceilf ( object.X - half );
+                int   x2   = (int) floorf( object.X + half );
+
+                if( x1 < 0 ) x1 = 0;
+                if( x2 >= mSettings.Width ) x2 = mSettings.Width - 1;
+                if( y < 0 || y >= mSettings.Height || x2 < x1 )
+                {
+                    continue;
+                }
+
+                sTestPatternSegment segment;
+                segment.StartX = x1;
+                segment.StartY = y;
+                segment.Length = x2 - x1 + 1;
+                segment.Object = (int) Frame.mObjects.size();
+
+                Frame.mSegments.push_back( segment );
+            }
+        }
+
+        void RenderMarker( cTestPatternFrame &Frame, const sTestPatternObject &object, float radius )
+        {
+            //== bright disc with a one pixel anti-aliased falloff ==--
+
+            int x1 = (int) ( object.X - radius - 1 ), x2 = (int) ( object.X + radius + 1 );
+            int y1 = (int) ( object.Y - radius - 1 ), y2 = (int) ( object.Y + radius + 1 );
+
+            if( x1 < 0 ) x1 = 0;
+            if( y1 < 0 ) y1 = 0;
+            if( x2 >= mSettings.Width  ) x2 = mSettings.Width  - 1;
+            if( y2 >= mSettings.Height ) y2 = mSettings.Height - 1;
+
+            for( int y = y1; y <= y2; y++ )
+            {
+                unsigned char *row = &Frame.mImage[ (size_t) y * mSettings.Width ];
+
+                for( int x = x1; x <= x2; x++ )
+                {
+                    float dx = x - object.X, dy = y - object.Y;
+                    float edge = radius + 0.5f - sqrtf( dx * dx + dy * dy );
+
+                    if( edge > 0 )
+                    {
+                        int value = ( edge >= 1.0f ) ? 255 : (int) ( edge * 255 );
+                        if( value > row[ x ] )
+                        {
+                            row[ x ] = (unsigned char) value;
+                        }
+                    }
+                }
+            }
+        }
+
+        //== xorshift32 ==--
+
+        unsigned int Next()
+        {
+            mState ^= mState << 13;
+            mState ^= mState >> 17;
+            mState ^= mState << 5;
+            return mState;
+        }
+
+        float Uniform()
+        {
+            return ( Next() >> 8 ) * ( 1.0f / 16777216.0f );
+        }
+
+        float Gaussian()
+        {
+            //== Irwin-Hall approximation, plenty for noise generation and branch free.  The sum of
+            //== four uniforms has a variance of 4/12, so scale by sqrt(3) for a unit deviation ==--
+            return ( Uniform() + Uniform() + Uniform() + Uniform() - 2.0f ) * 1.7320508f;
+        }
+
+        sTestPatternSettings mSettings;
+        std::vector<sMarker> mMarkers;
+        int                  mCameraIndex;
+        int                  mFrameID;
+        unsigned int         mState;
+    };
+
+    //== Receives generated frames.  Called from generator threads; the frame is only valid for
+    //== the duration of the call.
+
+    class cTestPatternListener
+    {
+    public:
+        virtual ~cTestPatternListener() {}
+
+        virtual void TestPatternFrame( int CameraIndex, cTestPatternFrame *Frame ) = 0;
+    };
+
+    //== Test pattern input manager =======================================================================----
+
+    class cInputManagerTestPattern : public InputManager
+    {
+    public:
+        cInputManagerTestPattern() : mListener( 0 ), mRateMultiple( 1.0 ), mRunning( false ),
+            mFramesGenerated( 0 ), mObjectsGenerated( 0 )
+        {
+        }
+
+        ~cInputManagerTestPattern()
+        {
+            Stop();
+        }
+
+        void Configure( const sTestPatternSettings &Settings )
+        {
+            Stop();
+            mSettings = Settings;
+        }
+
+        const sTestPatternSettings & Settings() const { return mSettings; }
+
+        void AttachListener( cTestPatternListener *Listener ) { mListener = Listener; }
+
+        //== Generation rate as a multiple of real time, zero generates as fast as possible ==--
+
+        void   SetRateMultiple( double Multiple ) { mRateMultiple = ( Multiple > 0 ) ? Multiple : 0; }
+        double RateMultiple() const { return mRateMultiple; }
+
+        bool Start()
+        {
+            if( mRunning || mSettings.CameraCount <= 0 )
+            {
+                return mRunning;
+            }
+
+            mGenerators.assign( mSettings.CameraCount, cTestPatternGenerator() );
+            for( int i = 0; i < mSettings.CameraCount; i++ )
+            {
+                mGenerators[ i ].Initialize( mSettings, i );
+            }
+
+            int threads = mSettings.ThreadCount;
+            if( threads <= 0 )
+            {
+                threads = (int) std::thread::hardware_concurrency();
+            }
+            if( threads <= 0 )
+            {
+                threads = 1;
+            }
+            if( threads > mSettings.CameraCount )
+            {
+                threads = mSettings.CameraCount;
+            }
+
+            mFramesGenerated  = 0;
+            mObjectsGenerated = 0;
+            mRunning          = true;
+
+            for( int i = 0; i < threads; i++ )
+            {
+                mThreads.push_back( std::thread( &cInputManagerTestPattern::GeneratorThread, this, i, threads ) );
+            }
+
+            return true;
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mWake.notify_all();
+
+            for( size_t i = 0; i < mThreads.size(); i++ )
+            {
+                mThreads[ i ].join();
+            }
+            mThreads.clear();
+        }
+
+        bool IsRunning() const { return mRunning; }
+
+        //== Statistics ==--
+
+        long long FramesGenerated()  const { return mFramesGenerated; }
+        long long ObjectsGenerated() const { return mObjectsGenerated; }
+
+    private:
+        void GeneratorThread( int ThreadIndex, int ThreadCount )
+        {
+            typedef std::chrono::steady_clock clock;
+
+            cTestPatternFrame  frame;
+            clock::time_point  start = clock::now();
+            long long          tick  = 0;
+
+            while( mRunning )
+            {
+                double multiple = mRateMultiple;
+
+                if( multiple > 0 )
+                {
+                    clock::time_point due = start + std::chrono::duration_cast<clock::duration>(
+                        std::chrono::duration<double>( tick / ( mSettings.FrameRate * multiple ) ) );
+
+                    std::unique_lock<std::mutex> lock( mLock );
+                    if( mWake.wait_until( lock, due, [this] { return !mRunning; } ) )
+                    {
+                        break;
+                    }
+                }
+
+                //== each thread owns an interleaved subset of the cameras ==--
+
+                for( int camera = ThreadIndex; camera < mSettings.CameraCount; camera += ThreadCount )
+                {
+                    mGenerators[ camera ].Generate( frame );
+
+                    cTestPatternListener *listener = mListener;
+                    if( listener )
+                    {
+                        listener->TestPatternFrame( camera, &frame );
+                    }
+
+                    mFramesGenerated++;
+                    mObjectsGenerated += frame.ObjectCount();
+                }
+
+                tick++;
+            }
+        }
+
+        sTestPatternSettings               mSettings;
+        std::vector<cTestPatternGenerator> mGenerators;
+        std::atomic<cTestPatternListener*> mListener;
+        std::atomic<double>                mRateMultiple;
+        std::atomic<bool>                  mRunning;
+        std::atomic<long long>             mFramesGenerated;
+        std::atomic<long long>             mObjectsGenerated;
+
+        std::vector<std::thread>           mThreads;
+        std::mutex                         mLock;
+        std::condition_variable            mWake;
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__INPUTMANAGERVIRTUAL_H__
+#define __CAMERALIBRARY__INPUTMANAGERVIRTUAL_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include "inputmanagerbase.h"
+#include "cameramanager.h"
+#include "camera.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Create a virtual camera for a software input (file playback, memory injection), configure
+    //== it as the described device and register it with the CameraManager.  Packets pushed into
+    //== the returned camera's cInputListener interface are parsed exactly like live packets.
+
+    inline Camera * CreateVirtualCamera( cVirtualConfigurationData &Config )
+    {
+        Camera *camera = CameraManager::CameraFactory( Config.CameraRevision, true, Config.CameraSerial, true,
+            Config.CameraSubModel );
+
+        if( camera == 0 )
+        {
+            return 0;
+        }
+
+        camera->SendVirtualConfigurationData( &Config );
+
+        CameraManager::X().AddCamera( camera );
+
+        return camera;
+    }
+}
+
+#endif
@@ -0,0 +1,674 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__MJPEGDECODER_H__
+#define __CAMERALIBRARY__MJPEGDECODER_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#if defined(JPEGLIBIMPORTED)
+
+#include <setjmp.h>
+
+extern "C"
+{
+#include <jpeglib.h>
+}
+
+#endif
+
+#include "frame.h"
+#include "camera.h"
+#include "framerasterizer.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+#if defined(JPEGLIBIMPORTED)
+
+    //== Single threaded MJPEG to 8 bit grayscale decoder.  With late decompression enabled
+    //== (Camera::SetLateDecompression) Frame::CompressedImage holds a complete JPEG image, which
+    //== is decoded here with libjpeg (libjpeg-turbo or IJG 8 and later, for jpeg_mem_src).  The
+    //== decompressor is created once and reused for every image.
+    //==
+    //== Previews can decode at 1/2, 1/4 or 1/8 scale: libjpeg then runs a reduced size IDCT per
+    //== 8x8 block (just the DC coefficient at 1/8) instead of decoding every pixel and filtering
+    //== them away afterwards ==--
+
+    class cMJPEGDecoder
+    {
+    public:
+        cMJPEGDecoder()
+        {
+            mInfo.err = jpeg_std_error( &mError.Manager );
+            mError.Manager.error_exit     = ErrorExit;
+            mError.Manager.output_message = OutputMessage;
+            mError.Message[0] = '\0';
+            jpeg_create_decompress( &mInfo );
+        }
+
+        ~cMJPEGDecoder()
+        {
+            jpeg_destroy_decompress( &mInfo );
+        }
+
+        //== Decode a JPEG image into Image (Width x Height, Width bytes per row).  Scale is 1, 2, 4
+        //== or 8, giving an image of ceil(width/Scale) x ceil(height/Scale) ==--
+
+        bool Decode( const unsigned char *Data, int Size, std::vector<unsigned char> &Image, int &Width, int &Height,
+                     int Scale = 1 )
+        {
+            Width  = 0;
+            Height = 0;
+
+            if( !Data || Size <= 0 || !IsValidScale( Scale ) )
+            {
+                return false;
+            }
+
+            mError.Message[0] = '\0';
+
+            if( setjmp( mError.Jump ) )
+            {
+                jpeg_abort_decompress( &mInfo );
+                return false;
+            }
+
+            jpeg_mem_src( &mInfo, const_cast<unsigned char*>( Data ), (unsigned long) Size );
+
+            if( jpeg_read_header( &mInfo, TRUE ) != JPEG_HEADER_OK )
+            {
+                jpeg_abort_decompress( &mInfo );
+                return false;
+            }
+
+            mInfo.out_color_space = JCS_GRAYSCALE;
+            mInfo.scale_num       = 1;
+            mInfo.scale_denom     = Scale;
+            mInfo.dct_method      = ( Scale > 1 ) ? JDCT_IFAST : JDCT_ISLOW;
+
+            jpeg_start_decompress( &mInfo );
+
+            int width  = (int) mInfo.output_width;
+            int height = (int) mInfo.output_height;
+
+            if( Image.size() < (size_t) width * height )
+            {
+                Image.resize( (size_t) width * height );
+            }
+
+            while( mInfo.output_scanline < mInfo.output_height )
+            {
+                JSAMPROW rows[4];
+                for( int i = 0; i < 4; i++ )
+                {
+                    unsigned int row = mInfo.output_scanline + i;
+                    rows[i] = &Image[ (size_t) ( row < mInfo.output_height ? row : mInfo.output_height - 1 ) * width ];
+                }
+                jpeg_read_scanlines( &mInfo, rows, 4 );
+            }
+
+            jpeg_finish_decompress( &mInfo );
+
+            Width  = width;
+            Height = height;
+            return true;
+        }
+
+        //== Draw a late decompressed MJPEG frame into a target, reduced by the smallest integer
+        //== factor that fits it (top left aligned).  As much of the reduction as possible is done
+        //== by a scaled decode, the rest by a box filter.  False if the frame has no JPEG data,
+        //== in which case Frame::Rasterize is the way to draw it ==--
+
+        bool Rasterize( Frame *FrameRef, unsigned int Width, unsigned int Height, unsigned int Span,
+                        unsigned int BitsPerPixel, void *Buffer )
+        {
+            if( !FrameRef || !Buffer )
+            {
+                return false;
+            }
+
+            int size = FrameRef->CompressedImageSize();
+            if( size <= 0 )
+            {
+                return false;
+            }
+
+            if( mCompressed.size() < (size_t) size )
+            {
+                mCompressed.resize( size );
+            }
+            size = FrameRef->CompressedImage( &mCompressed[0], size );
+
+            int factor = Core::cBoxDownsample::FitFactor( FrameRef->Width(), FrameRef->Height(), (int) Width, (int) Height );
+            if( factor < 1 )
+            {
+                return false;
+            }
+
+            int scale = ScaleForFactor( factor );
+            int width, height;
+
+            if( !Decode( &mCompressed[0], size, mImage, width, height, scale ) )
+            {
+                return false;
+            }
+
+            //== the decoded image is rounded up, so the box filter may need a larger factor than factor / scale ==--
+
+            int remaining = Core::cBoxDownsample::FitFactor( width, height, (int) Width, (int) Height );
+
+            return Core::cBoxDownsample::Downsample( &mImage[0], width,
+                                                     Core::cBoxDownsample::OutputSize( width,  remaining ),
+                                                     Core::cBoxDownsample::OutputSize( height, remaining ), remaining,
+                                                     (unsigned char*) Buffer, (int) Span, (int) BitsPerPixel );
+        }
+
+        bool Rasterize( Frame *FrameRef, Bitmap *BitmapRef )
+        {
+            return BitmapRef && Rasterize( FrameRef, BitmapRef->PixelWidth(), BitmapRef->PixelHeight(),
+                                           BitmapRef->ByteSpan(), BitmapRef->GetBitsPerPixel(), BitmapRef->GetBits() );
+        }
+
+        //== Largest decode scale (1, 2, 4 or 8) that does no more than an overall reduction by Factor ==--
+
+        static int ScaleForFactor( int Factor )
+        {
+            return ( Factor >= 8 ) ? 8 : ( Factor >= 4 ) ? 4 : ( Factor >= 2 ) ? 2 : 1;
+        }
+
+        static bool IsValidScale( int Scale )
+        {
+            return Scale == 1 || Scale == 2 || Scale == 4 || Scale == 8;
+        }
+
+        const char * LastError() const { return mError.Message; }
+
+        //== True when built with libjpeg (JPEGLIBIMPORTED) ==--
+
+        static bool IsAvailable() { return true; }
+
+    private:
+        struct sErrorManager
+        {
+            jpeg_error_mgr  Manager;        //== must stay first, libjpeg hands back this pointer ==--
+            jmp_buf         Jump;
+            char            Message[ JMSG_LENGTH_MAX ];
+        };
+
+        static void ErrorExit( j_common_ptr Info )
+        {
+            sErrorManager *error = reinterpret_cast<sErrorManager*>( Info->err );
+            ( *Info->err->format_message )( Info, error->Message );
+            longjmp( error->Jump, 1 );
+        }
+
+        static void OutputMessage( j_common_ptr )
+        {
+            //== warnings (e.g. a missing EOI marker) are not printed ==--
+        }
+
+        cMJPEGDecoder( const cMJPEGDecoder& );
+        cMJPEGDecoder& operator=( const cMJPEGDecoder& );
+
+        jpeg_decompress_struct      mInfo;
+        sErrorManager               mError;
+        std::vector<unsigned char>  mCompressed;
+        std::vector<unsigned char>  mImage;
+    };
+
+#else
+
+    //== Built without libjpeg (define JPEGLIBIMPORTED and link libjpeg-turbo or IJG libjpeg 8 or
+    //== later); every decode fails, so frames are left to Frame::Rasterize.  IsAvailable() returns
+    //== false so callers can tell this apart from a corrupt image ==--
+
+    class cMJPEGDecoder
+    {
+    public:
+        cMJPEGDecoder() {}
+
+        bool Decode( const unsigned char * /*Data*/, int /*Size*/, std::vector<unsigned char> & /*Image*/, int &Width,
+                     int &Height, int /*Scale*/ = 1 )
+        {
+            Width  = 0;
+            Height = 0;
+            return false;
+        }
+
+        bool Rasterize( Frame * /*FrameRef*/, unsigned int /*Width*/, unsigned int /*Height*/, unsigned int /*Span*/,
+                        unsigned int /*BitsPerPixel*/, void * /*Buffer*/ )
+        {
+            return false;
+        }
+
+        bool Rasterize( Frame * /*FrameRef*/, Bitmap * /*BitmapRef*/ ) { return false; }
+
+        static int ScaleForFactor( int Factor )
+        {
+            return ( Factor >= 8 ) ? 8 : ( Factor >= 4 ) ? 4 : ( Factor >= 2 ) ? 2 : 1;
+        }
+
+        static bool IsValidScale( int Scale )
+        {
+            return Scale == 1 || Scale == 2 || Scale == 4 || Scale == 8;
+        }
+
+        const char * LastError() const { return "built without libjpeg"; }
+
+        static bool IsAvailable() { return false; }
+
+    private:
+        cMJPEGDecoder( const cMJPEGDecoder& );
+        cMJPEGDecoder& operator=( const cMJPEGDecoder& );
+    };
+
+#endif
+
+    //== A frame handed to the decode pool.  It becomes ready once a worker has decoded it (or failed
+    //== to); the image is only touched by the worker until then and is read only afterwards ==--
+
+    class cMJPEGDecodedFrame
+    {
+    public:
+        cMJPEGDecodedFrame( int Serial, int FrameID, double TimeStamp, int Scale = 1 )
+            : mSerial( Serial ), mFrameID( FrameID ), mTimeStamp( TimeStamp ), mScale( Scale ), mWidth( 0 ), mHeight( 0 ),
+              mDecodeSeconds( 0 ), mSucceeded( false ), mReady( false ) {}
+
+        int     Serial()        const { return mSerial; }
+        int     FrameID()       const { return mFrameID; }
+        double  TimeStamp()     const { return mTimeStamp; }
+        int     Scale()         const { return mScale; }
+
+        bool    IsReady()       const { return mReady; }
+        bool    Succeeded()     const { return mReady && mSucceeded; }
+
+        //== Block until decoded; returns false if decoding failed, or on timeout (-1 waits forever) ==--
+
+        bool    Wait( int TimeoutMilliseconds = -1 ) const
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+            if( TimeoutMilliseconds < 0 )
+            {
+                mDone.wait( lock, [this] { return mReady.load(); } );
+            }
+            else if( !mDone.wait_for( lock, std::chrono::milliseconds( TimeoutMilliseconds ), [this] { return mReady.load(); } ) )
+            {
+                return false;
+            }
+            return mSucceeded;
+        }
+
+        //== Valid once ready, reduced by Scale from the camera image ==--
+
+        int     Width()         const { return mWidth; }
+        int     Height()        const { return mHeight; }
+        double  DecodeSeconds() const { return mDecodeSeconds; }
+        const unsigned char * Image() const { return mImage.empty() ? 0 : &mImage[0]; }
+
+        //== Draw the decoded image, reduced to fit when the target is smaller ==--
+
+        bool    Rasterize( unsigned int Width, unsigned int Height, unsigned int Span, unsigned int BitsPerPixel, void *Buffer ) const
+        {
+            if( !Succeeded() || !Buffer )
+            {
+                return false;
+            }
+
+            int factor = Core::cBoxDownsample::FitFactor( mWidth, mHeight, (int) Width, (int) Height );
+            if( factor < 1 )
+            {
+                return false;
+            }
+
+            int width  = Core::cBoxDownsample::OutputSize( mWidth,  factor );
+            int height = Core::cBoxDownsample::OutputSize( mHeight, factor );
+
+            return Core::cBoxDownsample::Downsample( &mImage[0], mWidth, width, height, factor,
+                                                     (unsigned char*) Buffer, (int) Span, (int) BitsPerPixel );
+        }
+
+        bool    Rasterize( Bitmap *BitmapRef ) const
+        {
+            return BitmapRef && Rasterize( BitmapRef->PixelWidth(), BitmapRef->PixelHeight(), BitmapRef->ByteSpan(),
+                                           BitmapRef->GetBitsPerPixel(), BitmapRef->GetBits() );
+        }
+
+    private:
+        friend class cMJPEGDecodePool;
+
+        cMJPEGDecodedFrame( const cMJPEGDecodedFrame& );
+        cMJPEGDecodedFrame& operator=( const cMJPEGDecodedFrame& );
+
+        void    Complete( bool Succeeded, double Seconds )
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mSucceeded     = Succeeded;
+                mDecodeSeconds = Seconds;
+                mReady         = true;
+            }
+            mDone.notify_all();
+        }
+
+        int                         mSerial;
+        int                         mFrameID;
+        double                      mTimeStamp;
+        int                         mScale;
+        std::vector<unsigned char>  mCompressed;
+        std::vector<unsigned char>  mImage;
+        int                         mWidth;
+        int                         mHeight;
+        double                      mDecodeSeconds;
+        bool                        mSucceeded;
+        std::atomic<bool>           mReady;
+        mutable std::mutex          mLock;
+        mutable std::condition_variable mDone;
+    };
+
+    typedef std::shared_ptr<cMJPEGDecodedFrame> MJPEGDecodedFramePtr;
+
+    struct sMJPEGDecodeSettings
+    {
+        int     ThreadCount;            //== Decode threads, 0 for one per core ===================----
+        int     MaxPendingPerCamera;    //== Frames queued or decoding per camera before Submit ===----
+                                        //== rejects further frames from that camera ============----
+
+        sMJPEGDecodeSettings() : ThreadCount( 0 ), MaxPendingPerCamera( 2 ) {}
+    };
+
+    //== Pool of decode threads shared by any number of cameras.  Submit() copies the frame's JPEG
+    //== data, so the Frame can be released straight away, and returns a cMJPEGDecodedFrame that is
+    //== marked ready when decoded.  Each camera may only have MaxPendingPerCamera frames in the
+    //== pool; past that Submit() returns null, so a camera the pool can't keep up with drops
+    //== frames instead of growing the queue or delaying the others ==--
+
+    class cMJPEGDecodePool
+    {
+    public:
+        cMJPEGDecodePool( const sMJPEGDecodeSettings &Settings = sMJPEGDecodeSettings() )
+            : mSettings( Settings ), mRunning( true ), mBusy( 0 ), mDecoded( 0 ), mFailed( 0 ), mRejected( 0 ),
+              mDecodeSeconds( 0 ), mMaxDecodeSeconds( 0 )
+        {
+            if( mSettings.ThreadCount <= 0 )
+            {
+                mSettings.ThreadCount = std::max( 1, (int) std::thread::hardware_concurrency() );
+            }
+            if( mSettings.MaxPendingPerCamera <= 0 )
+            {
+                mSettings.MaxPendingPerCamera = 1;
+            }
+            for( int i = 0; i < mSettings.ThreadCount; i++ )
+            {
+                mThreads.push_back( std::thread( &cMJPEGDecodePool::WorkerThread, this ) );
+            }
+        }
+
+        ~cMJPEGDecodePool()
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mWork.notify_all();
+            for( size_t i = 0; i < mThreads.size(); i++ )
+            {
+                mThreads[i].join();
+            }
+
+            //== anything still queued completes as failed so no waiter is left hanging ==--
+
+            for( size_t i = 0; i < mQueue.size(); i++ )
+            {
+                mQueue[i]->Complete( false, 0 );
+            }
+        }
+
+        //== Process wide pool sized by core count, created on first use.  It is never destroyed by a
+        //== static destructor, since joining threads there deadlocks when a DLL unloads; call
+        //== ShutdownShared() before unloading (e.g. next to CameraManager::X().Shutdown()) once
+        //== nothing uses the pool any more ==--
+
+        static cMJPEGDecodePool & Shared()
+        {
+            std::lock_guard<std::mutex> lock( SharedLock() );
+
+            cMJPEGDecodePool *&pool = SharedPool();
+            if( !pool )
+            {
+                pool = new cMJPEGDecodePool();
+            }
+            return *pool;
+        }
+
+        static void ShutdownShared()
+        {
+            cMJPEGDecodePool *pool = 0;
+            {
+                std::lock_guard<std::mutex> lock( SharedLock() );
+                std::swap( pool, SharedPool() );
+            }
+            delete pool;
+        }
+
+        //== False when built without libjpeg; Submit() then rejects every frame ==--
+
+        static bool IsAvailable() { return cMJPEGDecoder::IsAvailable(); }
+
+        //== Queue an MJPEG frame, null if it has no compressed image, its camera is at its limit or
+        //== the pool is not available.  Scale 2, 4 or 8 decodes a reduced image for previews ==--
+
+        MJPEGDecodedFramePtr Submit( Frame *FrameRef, int Scale = 1 )
+        {
+            if( !FrameRef || !IsAvailable() || !cMJPEGDecoder::IsValidScale( Scale ) )
+            {
+                return MJPEGDecodedFramePtr();
+            }
+
+            Camera *camera = FrameRef->GetCamera();
+            int serial     = camera ? camera->Serial() : 0;
+            int size       = FrameRef->CompressedImageSize();
+
+            if( size <= 0 || !Reserve( serial ) )
+            {
+                return MJPEGDecodedFramePtr();
+            }
+
+            MJPEGDecodedFramePtr job( new cMJPEGDecodedFrame( serial, FrameRef->FrameID(), FrameRef->TimeStamp(), Scale ) );
+            job->mCompressed.resize( size );
+            size = FrameRef->CompressedImage( &job->mCompressed[0], size );
+            job->mCompressed.resize( size > 0 ? size : 0 );
+
+            Enqueue( job );
+            return job;
+        }
+
+        //== Queue JPEG data from any other source (e.g. a recording) ==--
+
+        MJPEGDecodedFramePtr Submit( int Serial, int FrameID, double TimeStamp, const unsigned char *Data, int Size,
+                                     int Scale = 1 )
+        {
+            if( !Data || Size <= 0 || !IsAvailable() || !cMJPEGDecoder::IsValidScale( Scale ) || !Reserve( Serial ) )
+            {
+                return MJPEGDecodedFramePtr();
+            }
+
+            MJPEGDecodedFramePtr job( new cMJPEGDecodedFrame( Serial, FrameID, TimeStamp, Scale ) );
+            job->mCompressed.assign( Data, Data + Size );
+
+            Enqueue( job );
+            return job;
+        }
+
+        //== Block until every submitted frame has been decoded ==--
+
+        void WaitIdle()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+            mIdle.wait( lock, [this] { return mQueue.empty() && mBusy == 0; } );
+        }
+
+        int     ThreadCount()   const { return (int) mThreads.size(); }
+
+        int     Pending( int Serial )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            std::map<int, int>::const_iterator pending = mPending.find( Serial );
+            return ( pending == mPending.end() ) ? 0 : pending->second;
+        }
+
+        int     QueueDepth()
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return (int) mQueue.size();
+        }
+
+        //== Statistics ==--
+
+        long long DecodedCount()  const { return mDecoded; }
+        long long FailedCount()   const { return mFailed; }
+        long long RejectedCount() const { return mRejected; }
+
+        double  DecodeSeconds()
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return mDecodeSeconds;
+        }
+
+        double  AverageDecodeMilliseconds()
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            long long count = mDecoded + mFailed;
+            return ( count > 0 ) ? 1000.0 * mDecodeSeconds / count : 0;
+        }
+
+        double  MaxDecodeMilliseconds()
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return 1000.0 * mMaxDecodeSeconds;
+        }
+
+    private:
+        cMJPEGDecodePool( const cMJPEGDecodePool& );
+        cMJPEGDecodePool& operator=( const cMJPEGDecodePool& );
+
+        static cMJPEGDecodePool *& SharedPool()
+        {
+            static cMJPEGDecodePool *pool = 0;
+            return pool;
+        }
+
+        static std::mutex & SharedLock()
+        {
+            static std::mutex lock;
+            return lock;
+        }
+
+        bool Reserve( int Serial )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+
+            int &pending = mPending[ Serial ];
+            if( !mRunning || pending >= mSettings.MaxPendingPerCamera )
+            {
+                mRejected++;
+                return false;
+            }
+            pending++;
+            return true;
+        }
+
+        void Enqueue( const MJPEGDecodedFramePtr &Job )
+        {
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mQueue.push_back( Job );
+            }
+            mWork.notify_one();
+        }
+
+        void WorkerThread()
+        {
+            cMJPEGDecoder decoder;
+
+            for( ;; )
+            {
+                MJPEGDecodedFramePtr job;
+                {
+                    std::unique_lock<std::mutex> lock( mLock );
+                    mWork.wait( lock, [this] { return !mRunning || !mQueue.empty(); } );
+                    if( !mRunning )
+                    {
+                        return;
+                    }
+                    job = mQueue.front();
+                    mQueue.pop_front();
+                    mBusy++;
+                }
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                bool success = decoder.Decode( job->mCompressed.empty() ? 0 : &job->mCompressed[0], (int) job->mCompressed.size(),
+                                               job->mImage, job->mWidth, job->mHeight, job->mScale );
+
+                double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+                std::vector<unsigned char>().swap( job->mCompressed );
+
+                {
+                    std::lock_guard<std::mutex> lock( mLock );
+                    mPending[ job->Serial() ]--;
+                    mBusy--;
+                    mDecodeSeconds += seconds;
+                    if( seconds > mMaxDecodeSeconds )
+                    {
+                        mMaxDecodeSeconds = seconds;
+                    }
+                    if( success )
+                    {
+                        mDecoded++;
+                    }
+                    else
+                    {
+                        mFailed++;
+                    }
+                }
+
+                job->Complete( success, seconds );
+                mIdle.notify_all();
+            }
+        }
+
+        sMJPEGDecodeSettings                mSettings;
+        std::vector<std::thread>            mThreads;
+        std::deque<MJPEGDecodedFramePtr>    mQueue;
+        std::map<int, int>                  mPending;
+        std::mutex                          mLock;
+        std::condition_variable             mWork;
+        std::condition_variable             mIdle;
+        bool                                mRunning;
+        int                                 mBusy;
+        std::atomic<long long>              mDecoded;
+        std::atomic<long long>              mFailed;
+        std::atomic<long long>              mRejected;
+        double                              mDecodeSeconds;
+        double                              mMaxDecodeSeconds;
+    };
+}
+
+#endif
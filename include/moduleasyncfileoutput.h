@@ -0,0 +1,591 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__MODULEASYNCFILEOUTPUT_H__
+#define __CAMERALIBRARY__MODULEASYNCFILEOUTPUT_H__
+
+//== Requires C++11.  Not included by cameralibrary.h; include this header directly to use cModuleFileOutput.
+
+//== INCLUDES ===========================================================================================----
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <string.h>
+
+#include "cameramodulebase.h"
+#include "camera.h"
+#include "frame.h"
+#include "object.h"
+#include "tinyobjects.h"
+#include "inputmanagerfile/directfile.h"
+
+#if defined(ZLIBIMPORTED)
+#include "ziphelpers.h"
+#endif
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== File output module.  Attach to any number of cameras to record every frame they deliver.
+    //== PostFrame reserves room in the active write buffer under the lock, copies the frame (header,
+    //== objects and optionally its image) into it after unlocking, and returns; cameras therefore fill
+    //== their records concurrently.  A writer thread flushes full buffers to disk once every record
+    //== reserved in them has been filled.  Memory is bounded by the
+    //== buffer count: when every buffer is waiting on the disk a frame is held for at most
+    //== MaxWaitMilliseconds and is then dropped and counted.
+    //==
+    //== File layout: sFileOutputHeader followed by records, each an sFileOutputRecord, ObjectCount
+    //== sFileOutputObjects and ImageSize bytes of image, padded to 8 bytes.  With TinyObjects set,
+    //== frames are FileOutputRecordTinyFrame records holding ObjectCount cTinyObjects (10 bytes,
+    //== 1/256 pixel centroids, see cTinyObjects; areas over 255 pixels are clamped and counted in
+    //== TinyAreaClamped()) instead.  Padding records fill out the end of each
+    //== buffer so every buffer is written at full size, as direct IO requires.
+    //==
+    //== With Compress set the header and records, without the padding, are instead the uncompressed
+    //== content of a chunked zlib stream (see cZipChunkWriter), compressed in parallel and read back
+    //== at any offset through cZipChunkReader.  DirectIO and Sync do not apply to compressed output.
+    //== Compression needs zlib (define ZLIBIMPORTED and link zlib); without it Open fails when
+    //== Compress is set.
+
+    const unsigned int kFileOutputMagic   = 0x4F46504E; //== 'NPFO' ==--
+    const unsigned int kFileOutputVersion = 2;    //== 2: FileOutputRecordTinyFrame ==--
+
+    const int kFileOutputDefaultBufferSize  = 32 * 1024 * 1024;
+    const int kFileOutputDefaultBufferCount = 2;
+    const int kFileOutputMinimumBufferSize  = 64 * 1024;
+
+    enum eFileOutputRecordTypes
+    {
+        FileOutputRecordPadding   = 0,
+        FileOutputRecordFrame     = 1,
+        FileOutputRecordTinyFrame = 2
+    };
+
+    enum eFileOutputSync
+    {
+        FileOutputSyncNone = 0,     //== leave flushing to the OS ==--
+        FileOutputSyncOnClose,      //== flush once when the file is closed ==--
+        FileOutputSyncPerBuffer     //== flush after every buffer written ==--
+    };
+
+    struct sFileOutputHeader
+    {
+        unsigned int       Magic;
+        unsigned int       Version;
+        unsigned int       HeaderSize;
+        unsigned int       Reserved;
+    };
+
+    struct sFileOutputRecord
+    {
+        unsigned int       Type;
+        unsigned int       Size;                //== bytes following this header, including alignment ==--
+        int                Serial;
+        int                FrameID;
+        int                FrameType;           //== Core::eVideoMode ==--
+        int                ObjectCount;
+        int                ImageSize;           //== grayscale or compressed (MJPEG / H.264) image bytes ==--
+        int                Compressed;
+        double             TimeStamp;
+        unsigned long long HardwareTimeStamp;
+    };
+
+    struct sFileOutputObject
+    {
+        float              X;
+        float              Y;
+        float              Area;
+        float              Roundness;
+    };
+
+    inline unsigned int FileOutputRecordStride( unsigned int PayloadSize )
+    {
+        return ( (unsigned int) sizeof( sFileOutputRecord ) + PayloadSize + 7 ) & ~7u;
+    }
+
+    struct sFileOutputSettings
+    {
+        sFileOutputSettings() : BufferSize( kFileOutputDefaultBufferSize ), BufferCount( kFileOutputDefaultBufferCount ),
+            DirectIO( true ), Sync( FileOutputSyncOnClose ), RecordImages( false ), TinyObjects( false ),
+            MaxWaitMilliseconds( 0 ), Compress( false ) { }
+
+        int             BufferSize;             //== rounded up to the sector size, must hold the largest frame ==--
+        int             BufferCount;            //== at least 2; bounds the memory used by the module ==--
+        bool            DirectIO;               //== bypass the OS cache, falls back to buffered writes ==--
+        eFileOutputSync Sync;
+        bool            RecordImages;           //== include grayscale / compressed image data ==--
+        bool            TinyObjects;            //== quantize objects to cTinyObject, 10 bytes instead of 16 ==--
+        int             MaxWaitMilliseconds;    //== backpressure: how long PostFrame may wait for a buffer ==--
+        bool            Compress;               //== write a chunked zlib stream instead of raw buffers ==--
+#if defined(ZLIBIMPORTED)
+        sZipStreamSettings Compression;         //== chunk size, level and threads when Compress is set ==--
+#endif
+    };
+
+    class cModuleFileOutput : public cCameraModule
+    {
+    public:
+        cModuleFileOutput() : mBufferSize( 0 ), mCurrent( 0 ), mRunning( false ), mFramesRecorded( 0 ),
+            mFramesDropped( 0 ), mBytesRecorded( 0 ), mBytesWritten( 0 ), mBuffersWritten( 0 ), mWriteErrors( 0 ),
+            mWriteNanoseconds( 0 ), mMaxQueueDepth( 0 ), mTinyAreaClamped( 0 )
+        {
+        }
+
+        ~cModuleFileOutput()
+        {
+            Close();
+        }
+
+        bool Open( const char *Filename, const sFileOutputSettings &Settings = sFileOutputSettings() )
+        {
+            Close();
+
+            mSettings = Settings;
+
+            int bufferSize = ( Settings.BufferSize > kFileOutputMinimumBufferSize ) ? Settings.BufferSize : kFileOutputMinimumBufferSize;
+            int bufferCount = ( Settings.BufferCount > 2 ) ? Settings.BufferCount : 2;
+
+            mBufferSize = ( (size_t) bufferSize + kDirectFileSectorSize - 1 ) & ~( (size_t) kDirectFileSectorSize - 1 );
+
+#if defined(ZLIBIMPORTED)
+            if( Settings.Compress ? !mZip.Open( Filename, Settings.Compression ) : !mFile.Open( Filename, Settings.DirectIO ) )
+#else
+            if( Settings.Compress || !mFile.Open( Filename, Settings.DirectIO ) )
+#endif
+            {
+                return false;
+            }
+
+            for( int i = 0; i < bufferCount; i++ )
+            {
+                sBuffer *buffer = new sBuffer();
+                buffer->Data   = (unsigned char*) cDirectFile::AlignedAllocate( mBufferSize );
+                buffer->Used    = 0;
+                buffer->Offset  = 0;
+                buffer->Writers = 0;
+                mBuffers.push_back( buffer );
+                mFree.push_back( buffer );
+            }
+
+            mFramesRecorded   = 0;
+            mFramesDropped    = 0;
+            mBytesRecorded    = 0;
+            mBytesWritten     = 0;
+            mBuffersWritten   = 0;
+            mWriteErrors      = 0;
+            mWriteNanoseconds = 0;
+            mMaxQueueDepth    = 0;
+            mTinyAreaClamped  = 0;
+            mOpened           = std::chrono::steady_clock::now();
+
+            //== file header lives at the start of the first buffer ==--
+
+            mCurrent = mFree.back();
+            mFree.pop_back();
+            mCurrent->Used = sizeof( sFileOutputHeader );
+
+            sFileOutputHeader *header = (sFileOutputHeader*) mCurrent->Data;
+            memset( header, 0, sizeof( sFileOutputHeader ) );
+            header->Magic      = kFileOutputMagic;
+            header->Version    = kFileOutputVersion;
+            header->HeaderSize = sizeof( sFileOutputHeader );
+
+            mRunning = true;
+            mThread  = std::thread( &cModuleFileOutput::WriterThread, this );
+
+            return true;
+        }
+
+        //== Write out everything recorded and close the file ==--
+
+        bool Close()
+        {
+            if( !IsOpen() )
+            {
+                return false;
+            }
+
+            sBuffer *tail = 0;
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                tail     = mCurrent;
+                mCurrent = 0;
+                mRunning = false;
+            }
+            mWork.notify_all();
+            mFreed.notify_all();
+            mThread.join();
+
+            {
+                std::unique_lock<std::mutex> lock( mLock );
+                mWork.wait( lock, [tail] { return tail->Writers == 0; } );
+            }
+
+            bool success;
+
+#if defined(ZLIBIMPORTED)
+            if( mSettings.Compress )
+            {
+                mZip.Write( tail->Data, tail->Used );
+                success = mZip.Close();
+            }
+            else
+#endif
+            {
+                //== the partial tail buffer is written through a buffered handle, unpadded ==--
+
+                success = mFile.Reopen( false ) && mFile.WriteAt( tail->Data, tail->Used, tail->Offset );
+
+                if( success && mSettings.Sync != FileOutputSyncNone )
+                {
+                    success = mFile.Sync();
+                }
+
+                mFile.Close();
+            }
+
+            for( size_t i = 0; i < mBuffers.size(); i++ )
+            {
+                cDirectFile::AlignedFree( mBuffers[ i ]->Data );
+                delete mBuffers[ i ];
+            }
+            mBuffers.clear();
+            mFree.clear();
+            mFull.clear();
+
+            return success && mWriteErrors == 0;
+        }
+
+        bool IsOpen() const { return mBuffers.size() > 0; }
+
+        //== Statistics ==--
+
+        int       QueueDepth()                                      //== buffers waiting on the writer ==--
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return (int) mFull.size();
+        }
+        int       MaxQueueDepth()   const { return mMaxQueueDepth; }
+        int       BufferCount()     const { return (int) mBuffers.size(); }
+        long long FramesRecorded()  const { return mFramesRecorded; }
+        long long FramesDropped()   const { return mFramesDropped; }
+        long long BytesRecorded()   const { return mBytesRecorded; }
+        long long BytesWritten()    const { return mBytesWritten; }
+        long long BuffersWritten()  const { return mBuffersWritten; }
+        long long WriteErrors()     const { return mWriteErrors; }
+        long long TinyAreaClamped() const { return mTinyAreaClamped; }  //== objects stored with area 255 ==--
+        bool      IsDirectIO()      const { return mFile.IsDirectIO(); }
+
+        //== Bytes per second the disk (or the compressor, with Compress set) accepted while the writer was busy ==--
+
+        double    WriteThroughput() const
+        {
+            long long nanoseconds = mWriteNanoseconds;
+            return ( nanoseconds > 0 ) ? (double) mBytesWritten * 1e9 / (double) nanoseconds : 0;
+        }
+
+        //== Bytes per second recorded since Open(); sustained recording needs WriteThroughput() above this ==--
+
+        double    RecordRate() const
+        {
+            double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - mOpened ).count();
+            return ( seconds > 0 ) ? (double) mBytesRecorded / seconds : 0;
+        }
+
+        //== cCameraModule ==--
+
+        bool PostFrame( Camera *Camera, Frame *Frame )
+        {
+            Record( Camera, Frame );
+
+            return false;   //== frame continues on to the rest of the module chain ==--
+        }
+
+    private:
+        struct sBuffer
+        {
+            unsigned char *    Data;
+            size_t             Used;
+            unsigned long long Offset;
+            int                Writers;             //== records reserved but not yet filled, under mLock ==--
+        };
+
+        bool Record( Camera *Camera, Frame *Frame )
+        {
+            const int objectCount = Frame->ObjectCount();
+
+            int  imageSize  = 0;
+            bool compressed = false;
+
+            if( mSettings.RecordImages && Frame->IsGrayscale() )
+            {
+                imageSize  = Frame->CompressedImageSize();
+                compressed = imageSize > 0;
+                if( !compressed )
+                {
+                    imageSize = Frame->GetGrayscaleData() ? Frame->GetGrayscaleDataSize() : 0;
+                }
+            }
+
+            const bool         tiny       = mSettings.TinyObjects;
+            const unsigned int objectSize = tiny ? (unsigned int) sizeof( cTinyObject ) : (unsigned int) sizeof( sFileOutputObject );
+            const unsigned int payload    = objectCount * objectSize + (unsigned int) imageSize;
+            const size_t       stride  = FileOutputRecordStride( payload );
+
+            //== reserve the record under the lock, fill it after unlocking ==--
+
+            std::unique_lock<std::mutex> lock( mLock );
+
+            if( mCurrent == 0 || !Reserve( lock, stride ) )
+            {
+                mFramesDropped++;
+                return false;
+            }
+
+            sBuffer *buffer = mCurrent;
+            unsigned char *destination = buffer->Data + buffer->Used;
+
+            buffer->Used += stride;
+            buffer->Writers++;
+            mBytesRecorded += stride;
+            mFramesRecorded++;
+
+            lock.unlock();
+
+            sFileOutputRecord *record = (sFileOutputRecord*) destination;
+            record->Type              = tiny ? FileOutputRecordTinyFrame : FileOutputRecordFrame;
+            record->Size              = (unsigned int) ( stride - sizeof( sFileOutputRecord ) );
+            record->Serial            = Camera->Serial();
+            record->FrameID           = Frame->FrameID();
+            record->FrameType         = (int) Frame->FrameType();
+            record->ObjectCount       = objectCount;
+            record->ImageSize         = imageSize;
+            record->Compressed        = compressed ? 1 : 0;
+            record->TimeStamp         = Frame->TimeStamp();
+            record->HardwareTimeStamp = Frame->HardwareTimeStamp();
+
+            unsigned char *image = (unsigned char*) ( record + 1 ) + objectCount * objectSize;
+
+            if( tiny )
+            {
+                //== gather to columns on the stack, then quantize each run in one bulk pass ==--
+
+                const int kRun = 64;
+
+                float x[ kRun ], y[ kRun ], area[ kRun ], roundness[ kRun ];
+
+                cTinyObject *objects = (cTinyObject*) ( record + 1 );
+
+                for( int first = 0; first < objectCount; first += kRun )
+                {
+                    int count = ( objectCount - first < kRun ) ? objectCount - first : kRun;
+
+                    for( int i = 0; i < count; i++ )
+                    {
+                        cObject *object = Frame->Object( first + i );
+                        x[ i ]         = object->X();
+                        y[ i ]         = object->Y();
+                        area[ i ]      = object->Area();
+                        roundness[ i ] = object->Roundness();
+                    }
+
+                    int clamped = cTinyObjects::Pack( x, y, area, roundness, count, objects + first );
+                    if( clamped > 0 )
+                    {
+                        mTinyAreaClamped += clamped;
+                    }
+                }
+            }
+            else
+            {
+                sFileOutputObject *objects = (sFileOutputObject*) ( record + 1 );
+                for( int i = 0; i < objectCount; i++ )
+                {
+                    cObject *object = Frame->Object( i );
+                    objects[ i ].X         = object->X();
+                    objects[ i ].Y         = object->Y();
+                    objects[ i ].Area      = object->Area();
+                    objects[ i ].Roundness = object->Roundness();
+                }
+            }
+
+            if( compressed )
+            {
+                Frame->CompressedImage( image, imageSize );
+            }
+            else if( imageSize > 0 )
+            {
+                memcpy( image, Frame->GetGrayscaleData(), imageSize );
+            }
+            memset( image + imageSize, 0, stride - sizeof( sFileOutputRecord ) - payload );
+
+            lock.lock();
+            if( --buffer->Writers == 0 )
+            {
+                mWork.notify_all();     //== the writer or Close may be waiting on this buffer ==--
+            }
+
+            return true;
+        }
+
+        //== Make room for a record in the current buffer, sealing it if needed.  Waits at most
+        //== MaxWaitMilliseconds for the writer to free a buffer (lock held) ==--
+
+        bool Reserve( std::unique_lock<std::mutex> &lock, size_t Stride )
+        {
+            //== always leave room for a padding record at the end of the buffer ==--
+
+            if( Stride + sizeof( sFileOutputHeader ) + sizeof( sFileOutputRecord ) > mBufferSize )
+            {
+                return false;
+            }
+            if( mCurrent->Used + Stride + sizeof( sFileOutputRecord ) <= mBufferSize )
+            {
+                return true;
+            }
+
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+                + std::chrono::milliseconds( mSettings.MaxWaitMilliseconds );
+
+            while( mCurrent != 0 && mCurrent->Used + Stride + sizeof( sFileOutputRecord ) > mBufferSize )
+            {
+                if( !mFree.empty() )
+                {
+                    Seal();
+                    return true;
+                }
+                if( mFreed.wait_until( lock, deadline ) == std::cv_status::timeout )
+                {
+                    break;
+                }
+            }
+
+            return mCurrent != 0 && mCurrent->Used + Stride + sizeof( sFileOutputRecord ) <= mBufferSize;
+        }
+
+        //== Pad out the current buffer, queue it for the writer and start the next (lock held) ==--
+
+        void Seal()
+        {
+            sFileOutputRecord *padding = (sFileOutputRecord*) ( mCurrent->Data + mCurrent->Used );
+            memset( padding, 0, sizeof( sFileOutputRecord ) );
+            padding->Type = FileOutputRecordPadding;
+            padding->Size = (unsigned int) ( mBufferSize - mCurrent->Used - sizeof( sFileOutputRecord ) );
+
+            unsigned long long next = mCurrent->Offset + mBufferSize;
+
+            mFull.push_back( mCurrent );
+            if( (int) mFull.size() > mMaxQueueDepth )
+            {
+                mMaxQueueDepth = (int) mFull.size();
+            }
+
+            mCurrent = mFree.back();
+            mFree.pop_back();
+            mCurrent->Offset = next;
+            mCurrent->Used   = 0;
+
+            mWork.notify_all();
+        }
+
+        void WriterThread()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            while( true )
+            {
+                mWork.wait( lock, [this] { return ( !mFull.empty() && mFull.front()->Writers == 0 ) || ( !mRunning && mFull.empty() ); } );
+
+                if( mFull.empty() )
+                {
+                    break;
+                }
+
+                sBuffer *buffer = mFull.front();
+
+                lock.unlock();
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                bool   success = true;
+                size_t size    = mBufferSize;
+
+#if defined(ZLIBIMPORTED)
+                if( mSettings.Compress )
+                {
+                    //== records only; the compressor reports its own write errors on Close ==--
+
+                    size = buffer->Used;
+                    mZip.Write( buffer->Data, size );
+                }
+                else
+#endif
+                {
+                    success = mFile.WriteAt( buffer->Data, mBufferSize, buffer->Offset );
+
+                    if( success && mSettings.Sync == FileOutputSyncPerBuffer )
+                    {
+                        success = mFile.Sync();
+                    }
+                }
+
+                mWriteNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+
+                if( success )
+                {
+                    mBytesWritten += size;
+                    mBuffersWritten++;
+                }
+                else
+                {
+                    mWriteErrors++;
+                }
+
+                lock.lock();
+                mFull.pop_front();
+                mFree.push_back( buffer );
+                mFreed.notify_one();
+            }
+        }
+
+        sFileOutputSettings               mSettings;
+        cDirectFile                       mFile;
+#if defined(ZLIBIMPORTED)
+        cZipChunkWriter                   mZip;
+#endif
+        size_t                            mBufferSize;
+
+        std::vector<sBuffer*>             mBuffers;
+        std::vector<sBuffer*>             mFree;
+        std::deque<sBuffer*>              mFull;
+        sBuffer *                         mCurrent;
+
+        bool                              mRunning;
+
+        std::atomic<long long>            mFramesRecorded;
+        std::atomic<long long>            mFramesDropped;
+        std::atomic<long long>            mBytesRecorded;
+        std::atomic<long long>            mBytesWritten;
+        std::atomic<long long>            mBuffersWritten;
+        std::atomic<long long>            mWriteErrors;
+        std::atomic<long long>            mWriteNanoseconds;
+        std::atomic<int>                  mMaxQueueDepth;
+        std::atomic<long long>            mTinyAreaClamped;
+        std::chrono::steady_clock::time_point mOpened;
+
+        std::thread                       mThread;
+        std::mutex                        mLock;
+        std::condition_variable           mWork;
+        std::condition_variable           mFreed;
+    };
+}
+
+#endif
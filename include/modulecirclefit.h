@@ -1,2 +1,618 @@
-//== Placeholder: No public interface ==--
 
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__MODULECIRCLEFIT_H__
+#define __CAMERALIBRARY__MODULECIRCLEFIT_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <math.h>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+#include "cameramodulebase.h"
+#include "frame.h"
+#include "framesegments.h"
+#include "Core/SIMD.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Result for one object.  X and Y are the fitted center with pixel centers at integer
+    //== coordinates; Residual is the weighted RMS distance (pixels) of the edge points from the
+    //== circle.  Objects that were not fitted (too small, degenerate or past the time budget)
+    //== keep the centroid of their segments, with Fitted false and a Residual of -1 ==--
+
+    struct sCircleFit
+    {
+        float   X;
+        float   Y;
+        float   Radius;
+        float   Residual;
+        int     PointCount;
+        bool    Fitted;
+    };
+
+    struct sCircleFitSettings
+    {
+        double  TimeBudgetMilliseconds; //== Per frame, 0 for no limit; later objects are skipped =----
+        int     MinimumRows;            //== Objects spanning fewer rows are not fitted ===========----
+        float   CapWeight;              //== Weight of top and bottom edge points, which are ======----
+                                        //== quantized to whole rows ==============================----
+        int     RefineIterations;       //== Reweighted refits after the first fit ================----
+        float   OutlierDistance;        //== Pixels from the circle beyond which points are =======----
+                                        //== down-weighted in refits ==============================----
+
+        sCircleFitSettings() : TimeBudgetMilliseconds( 1.0 ), MinimumRows( 3 ), CapWeight( 0.25f ),
+                               RefineIterations( 2 ), OutlierDistance( 0.5f ) {}
+    };
+
+    //== Circle fit module.  Attach one per camera; each instance refines that camera's objects on
+    //== the camera's own thread in PrePostFrame, so cameras are fitted in parallel without sharing
+    //== state.  The edge points of every object (both ends of each segment, plus the top and
+    //== bottom edges of its first and last rows) are fitted by weighted linear least squares
+    //== (Kasa) about their weighted mean, then refit with outlying points down-weighted so that
+    //== partly occluded markers still find their center.  The 2x2 solves for the centers run
+    //== four objects at a time with SSE2 / NEON, and the point distances four points at a time.
+    //==
+    //== cObject belongs to the library, so fitted centers and residuals are not written back into
+    //== the objects; query them per frame and object index with Result() or Residual().  Frames
+    //== are fitted as they arrive, ahead of the application taking them from the frame queue, so
+    //== the results of the last kCircleFitHistory frames are kept, keyed by FrameID ==--
+
+    const int kCircleFitHistory = 8;
+
+    class cModuleCircleFit : public cCameraModule
+    {
+    public:
+        cModuleCircleFit( const sCircleFitSettings &Settings = sCircleFitSettings() )
+            : mSettings( Settings ), mEnabled( true ), mLatest( kCircleFitHistory - 1 ), mLastFitMilliseconds( 0 ),
+              mObjectsFitted( 0 ), mObjectsSkipped( 0 )
+        {
+            for( int i = 0; i < kCircleFitHistory; i++ )
+            {
+                mHistory[i].FrameID = -1;
+            }
+        }
+        ~cModuleCircleFit() {}
+
+        void SetEnabled( bool Enabled ) { mEnabled = Enabled; }
+        bool Enabled() const            { return mEnabled; }
+
+        void SetSettings( const sCircleFitSettings &Settings )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            mSettings = Settings;
+        }
+
+        //== cCameraModule ==--
+
+        void PrePostFrame( Camera * /*Camera*/, Frame *Frame )
+        {
+            if( mEnabled && Frame )
+            {
+                FitFrame( Frame );
+            }
+        }
+
+        //== Fit a frame's objects now (PrePostFrame does this for every frame of the camera) ==--
+
+        void FitFrame( Frame *FrameRef )
+        {
+            sCircleFitSettings settings;
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                settings = mSettings;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            mSegments.Gather( FrameRef );
+
+            int objectCount = mSegments.ObjectCount();
+            mWork.resize( objectCount );
+            mCentroidX.resize( objectCount );
+            mCentroidY.resize( objectCount );
+            mArea.resize( objectCount );
+
+            if( objectCount > 0 )
+            {
+                mSegments.Centroids( &mCentroidX[0], &mCentroidY[0], &mArea[0] );
+            }
+
+            for( int i = 0; i < objectCount; i++ )
+            {
+                sCircleFit &fit = mWork[i];
+                fit.X          = mCentroidX[i];
+                fit.Y          = mCentroidY[i];
+                fit.Radius     = sqrtf( mArea[i] / 3.14159265f );
+                fit.Residual   = -1.0f;
+                fit.PointCount = 0;
+                fit.Fitted     = false;
+            }
+
+            //== batches of objects until the time budget runs out ==--
+
+            int fitted = 0;
+            int done   = 0;
+
+            while( done < objectCount )
+            {
+                int end = ( done + kBatchSize < objectCount ) ? done + kBatchSize : objectCount;
+
+                fitted += FitBatch( done, end, settings );
+                done    = end;
+
+                if( settings.TimeBudgetMilliseconds > 0 && Milliseconds( start ) > settings.TimeBudgetMilliseconds )
+                {
+                    break;
+                }
+            }
+
+            double elapsed = Milliseconds( start );
+
+            //== the oldest slot takes the results; its vector becomes the next frame's work space ==--
+
+            std::lock_guard<std::mutex> lock( mLock );
+            mLatest = ( mLatest + 1 ) % kCircleFitHistory;
+            mHistory[ mLatest ].Fits.swap( mWork );
+            mHistory[ mLatest ].FrameID = FrameRef->FrameID();
+            mLastFitMilliseconds = elapsed;
+            mObjectsFitted      += fitted;
+            mObjectsSkipped     += objectCount - done;
+        }
+
+        //== Result of an object of one of the last kCircleFitHistory fitted frames, false if the
+        //== frame is not among them ==--
+
+        bool Result( int FrameID, int ObjectIndex, sCircleFit &Fit )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+
+            const sFrameFits *frame = Find( FrameID );
+            if( !frame || ObjectIndex < 0 || ObjectIndex >= (int) frame->Fits.size() )
+            {
+                return false;
+            }
+            Fit = frame->Fits[ ObjectIndex ];
+            return true;
+        }
+
+        //== Fit residual of an object in pixels, -1 if it was not fitted ==--
+
+        float Residual( int FrameID, int ObjectIndex )
+        {
+            sCircleFit fit;
+            return Result( FrameID, ObjectIndex, fit ) ? fit.Residual : -1.0f;
+        }
+
+        //== Copy every result of the latest frame, returns its FrameID (-1 before the first frame) ==--
+
+        int  Results( std::vector<sCircleFit> &Fits )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            Fits = mHistory[ mLatest ].Fits;
+            return mHistory[ mLatest ].FrameID;
+        }
+
+        //== Copy every result of one of the last kCircleFitHistory frames, false if it is not among them ==--
+
+        bool Results( int FrameID, std::vector<sCircleFit> &Fits )
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+
+            const sFrameFits *frame = Find( FrameID );
+            if( !frame )
+            {
+                return false;
+            }
+            Fits = frame->Fits;
+            return true;
+        }
+
+        double      LastFitMilliseconds() { std::lock_guard<std::mutex> lock( mLock ); return mLastFitMilliseconds; }
+        long long   ObjectsFitted()       { std::lock_guard<std::mutex> lock( mLock ); return mObjectsFitted; }
+        long long   ObjectsSkipped()      { std::lock_guard<std::mutex> lock( mLock ); return mObjectsSkipped; }
+
+    private:
+        static const int kBatchSize = 64;
+
+        struct sFrameFits
+        {
+            int                     FrameID;
+            std::vector<sCircleFit> Fits;
+        };
+
+        cModuleCircleFit( const cModuleCircleFit& );
+        cModuleCircleFit& operator=( const cModuleCircleFit& );
+
+        //== Slot holding a frame's results, newest first (lock held) ==--
+
+        const sFrameFits * Find( int FrameID ) const
+        {
+            for( int i = 0; i < kCircleFitHistory; i++ )
+            {
+                const sFrameFits &frame = mHistory[ ( mLatest + kCircleFitHistory - i ) % kCircleFitHistory ];
+                if( frame.FrameID == FrameID && FrameID != -1 )
+                {
+                    return &frame;
+                }
+            }
+            return 0;
+        }
+
+        static double Milliseconds( std::chrono::steady_clock::time_point Start )
+        {
+            return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - Start ).count();
+        }
+
+        //== Fit objects [First, End), returns the number fitted ==--
+
+        int  FitBatch( int First, int End, const sCircleFitSettings &Settings )
+        {
+            int count = End - First;
+
+            mPointStart.resize( count + 1 );
+            mPointX.clear();
+            mPointY.clear();
+            mPointW.clear();
+            mOrigin.resize( 2 * count );
+
+            //== 1. edge points, relative to each object's first segment to keep floats small ==--
+
+            const unsigned short *startX = mSegments.StartX();
+            const unsigned short *startY = mSegments.StartY();
+            const unsigned short *length = mSegments.Length();
+
+            for( int o = 0; o < count; o++ )
+            {
+                sSegmentSpan span = mSegments.Segments( First + o );
+                mPointStart[o] = (int) mPointX.size();
+
+                if( span.Count == 0 )
+                {
+                    mOrigin[ 2 * o ] = mOrigin[ 2 * o + 1 ] = 0;
+                    continue;
+                }
+
+                int originX = startX[ span.First ];
+                int originY = startY[ span.First ];
+                int top     = originY;
+                int bottom  = originY;
+
+                for( int i = span.First; i < span.First + span.Count; i++ )
+                {
+                    top    = ( startY[i] < top )    ? startY[i] : top;
+                    bottom = ( startY[i] > bottom ) ? startY[i] : bottom;
+                }
+
+                mOrigin[ 2 * o ]     = originX;
+                mOrigin[ 2 * o + 1 ] = originY;
+
+                if( bottom - top + 1 < Settings.MinimumRows )
+                {
+                    continue;
+                }
+
+                for( int i = span.First; i < span.First + span.Count; i++ )
+                {
+                    float x1 = (float) ( startX[i] - originX ) - 0.5f;
+                    float x2 = x1 + length[i];
+                    float y  = (float) ( startY[i] - originY );
+
+                    AddPoint( x1, y, 1.0f );
+                    AddPoint( x2, y, 1.0f );
+
+                    if( startY[i] == top || startY[i] == bottom )
+                    {
+                        float capY = y + ( ( startY[i] == top ) ? -0.5f : 0.5f );
+                        for( int k = 0; k < length[i]; k++ )
+                        {
+                            AddPoint( x1 + 0.5f + k, capY, Settings.CapWeight );
+                        }
+                    }
+                }
+            }
+            mPointStart[ count ] = (int) mPointX.size();
+
+            //== 2. fit, then refit with points far from the circle (occlusions, merged markers)
+            //== down-weighted by OutlierDistance / distance ==--
+
+            mFitW = mPointW;
+            mDistance.resize( mPointX.size() );
+            mCenterX.resize( count );
+            mCenterY.resize( count );
+            mRadius.resize( count );
+
+            for( int pass = 0; ; pass++ )
+            {
+                Moments( count );
+                SolveCenters( count );
+
+                for( int o = 0; o < count; o++ )
+                {
+                    Distances( mPointStart[o], mPointStart[ o + 1 ], mCenterX[o], mCenterY[o], mRadius[o] );
+                }
+
+                if( pass >= Settings.RefineIterations || !( Settings.OutlierDistance > 0 ) )
+                {
+                    break;
+                }
+
+                for( size_t p = 0; p < mFitW.size(); p++ )
+                {
+                    float d  = fabsf( mDistance[p] );
+                    mFitW[p] = ( d > Settings.OutlierDistance ) ? mPointW[p] * Settings.OutlierDistance / d : mPointW[p];
+                }
+            }
+
+            //== 3. results, with residuals over every edge point at its original weight ==--
+
+            int fitted = 0;
+            for( int o = 0; o < count; o++ )
+            {
+                int points = mPointStart[ o + 1 ] - mPointStart[o];
+
+                if( points < kMinimumPoints || !( mRadius[o] > 0 ) )
+                {
+                    continue;
+                }
+
+                double sum = 0, weight = 0;
+                for( int p = mPointStart[o]; p < mPointStart[ o + 1 ]; p++ )
+                {
+                    sum    += mPointW[p] * mDistance[p] * mDistance[p];
+                    weight += mPointW[p];
+                }
+
+                sCircleFit &fit = mWork[ First + o ];
+                fit.X          = mOrigin[ 2 * o ]     + mCenterX[o];
+                fit.Y          = mOrigin[ 2 * o + 1 ] + mCenterY[o];
+                fit.Radius     = mRadius[o];
+                fit.Residual   = ( weight > 0 ) ? (float) sqrt( sum / weight ) : -1.0f;
+                fit.PointCount = points;
+                fit.Fitted     = true;
+                fitted++;
+            }
+
+            return fitted;
+        }
+
+        //== Weighted centered moments of each object's points, using mFitW ==--
+
+        void Moments( int Count )
+        {
+            mMoments.resize( kMomentCount * Count );
+            float *meanX = &mMoments[ MeanX * Count ];
+            float *meanY = &mMoments[ MeanY * Count ];
+            float *sw    = &mMoments[ SumW  * Count ];
+            float *sxx   = &mMoments[ SumXX * Count ];
+            float *syy   = &mMoments[ SumYY * Count ];
+            float *sxy   = &mMoments[ SumXY * Count ];
+            float *sxz   = &mMoments[ SumXZ * Count ];
+            float *syz   = &mMoments[ SumYZ * Count ];
+            float *sz    = &mMoments[ SumZ  * Count ];
+
+            for( int o = 0; o < Count; o++ )
+            {
+                double w = 0, wx = 0, wy = 0;
+                for( int p = mPointStart[o]; p < mPointStart[ o + 1 ]; p++ )
+                {
+                    w  += mFitW[p];
+                    wx += mFitW[p] * mPointX[p];
+                    wy += mFitW[p] * mPointY[p];
+                }
+
+                double mx = ( w > 0 ) ? wx / w : 0;
+                double my = ( w > 0 ) ? wy / w : 0;
+                double xx = 0, yy = 0, xy = 0, xz = 0, yz = 0, z = 0;
+
+                for( int p = mPointStart[o]; p < mPointStart[ o + 1 ]; p++ )
+                {
+                    double pw = mFitW[p];
+                    double x  = mPointX[p] - mx;
+                    double y  = mPointY[p] - my;
+                    double r2 = x * x + y * y;
+                    xx += pw * x * x;
+                    yy += pw * y * y;
+                    xy += pw * x * y;
+                    xz += pw * x * r2;
+                    yz += pw * y * r2;
+                    z  += pw * r2;
+                }
+
+                meanX[o] = (float) mx;   meanY[o] = (float) my;   sw[o]  = (float) w;
+                sxx[o]   = (float) xx;   syy[o]   = (float) yy;   sxy[o] = (float) xy;
+                sxz[o]   = (float) xz;   syz[o]   = (float) yz;   sz[o]  = (float) z;
+            }
+        }
+
+        void AddPoint( float X, float Y, float W )
+        {
+            mPointX.push_back( X );
+            mPointY.push_back( Y );
+            mPointW.push_back( W );
+        }
+
+        //== With centered coordinates the Kasa equations for x^2 + y^2 + D x + E y + F = 0 split into
+        //== a 2x2 system in D and E and F = -Sz / Sw; radius^2 = ( D^2 + E^2 ) / 4 - F.  Degenerate
+        //== objects get a radius of 0 ==--
+
+        void SolveCenters( int Count )
+        {
+            const float *meanX = &mMoments[ MeanX * Count ];
+            const float *meanY = &mMoments[ MeanY * Count ];
+            const float *sw    = &mMoments[ SumW  * Count ];
+            const float *sxx   = &mMoments[ SumXX * Count ];
+            const float *syy   = &mMoments[ SumYY * Count ];
+            const float *sxy   = &mMoments[ SumXY * Count ];
+            const float *sxz   = &mMoments[ SumXZ * Count ];
+            const float *syz   = &mMoments[ SumYZ * Count ];
+            const float *sz    = &mMoments[ SumZ  * Count ];
+            const float  minDet = 1e-4f;    //== relative to Sxx * Syy, rejects collinear points ==--
+
+            int o = 0;
+
+#if defined( CORE_SIMD_SSE2 )
+            const __m128  half    = _mm_set1_ps( 0.5f );
+            const __m128  epsilon = _mm_set1_ps( minDet );
+            const __m128  sign    = _mm_set1_ps( -0.0f );
+
+            for( ; o + 4 <= Count; o += 4 )
+            {
+                __m128 a   = _mm_loadu_ps( sxx + o );
+                __m128 b   = _mm_loadu_ps( sxy + o );
+                __m128 c   = _mm_loadu_ps( syy + o );
+                __m128 rx  = _mm_xor_ps( _mm_loadu_ps( sxz + o ), sign );
+                __m128 ry  = _mm_xor_ps( _mm_loadu_ps( syz + o ), sign );
+                __m128 w   = _mm_loadu_ps( sw + o );
+
+                __m128 det = _mm_sub_ps( _mm_mul_ps( a, c ), _mm_mul_ps( b, b ) );
+                __m128 ok  = _mm_and_ps( _mm_cmpgt_ps( det, _mm_mul_ps( epsilon, _mm_mul_ps( a, c ) ) ), _mm_cmpgt_ps( w, _mm_setzero_ps() ) );
+                __m128 inv = _mm_and_ps( ok, _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_or_ps( det, _mm_andnot_ps( ok, _mm_set1_ps( 1.0f ) ) ) ) );
+
+                __m128 d   = _mm_mul_ps( _mm_sub_ps( _mm_mul_ps( rx, c ), _mm_mul_ps( ry, b ) ), inv );
+                __m128 e   = _mm_mul_ps( _mm_sub_ps( _mm_mul_ps( ry, a ), _mm_mul_ps( rx, b ) ), inv );
+                __m128 f   = _mm_and_ps( ok, _mm_div_ps( _mm_xor_ps( _mm_loadu_ps( sz + o ), sign ), _mm_or_ps( w, _mm_andnot_ps( ok, _mm_set1_ps( 1.0f ) ) ) ) );
+
+                __m128 cx  = _mm_mul_ps( d, half );
+                __m128 cy  = _mm_mul_ps( e, half );
+                __m128 r2  = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( cx, cx ), _mm_mul_ps( cy, cy ) ), f );
+                __m128 r   = _mm_and_ps( _mm_and_ps( ok, _mm_cmpgt_ps( r2, _mm_setzero_ps() ) ), _mm_sqrt_ps( _mm_max_ps( r2, _mm_setzero_ps() ) ) );
+
+                _mm_storeu_ps( &mCenterX[o], _mm_sub_ps( _mm_loadu_ps( meanX + o ), cx ) );
+                _mm_storeu_ps( &mCenterY[o], _mm_sub_ps( _mm_loadu_ps( meanY + o ), cy ) );
+                _mm_storeu_ps( &mRadius[o],  r );
+            }
+#elif defined( CORE_SIMD_NEON )
+            const float32x4_t half    = vdupq_n_f32( 0.5f );
+            const float32x4_t zero    = vdupq_n_f32( 0.0f );
+            const float32x4_t one     = vdupq_n_f32( 1.0f );
+
+            for( ; o + 4 <= Count; o += 4 )
+            {
+                float32x4_t a   = vld1q_f32( sxx + o );
+                float32x4_t b   = vld1q_f32( sxy + o );
+                float32x4_t c   = vld1q_f32( syy + o );
+                float32x4_t rx  = vnegq_f32( vld1q_f32( sxz + o ) );
+                float32x4_t ry  = vnegq_f32( vld1q_f32( syz + o ) );
+                float32x4_t w   = vld1q_f32( sw + o );
+
+                float32x4_t det = vsubq_f32( vmulq_f32( a, c ), vmulq_f32( b, b ) );
+                uint32x4_t  ok  = vandq_u32( vcgtq_f32( det, vmulq_n_f32( vmulq_f32( a, c ), minDet ) ), vcgtq_f32( w, zero ) );
+                float32x4_t inv = vbslq_f32( ok, vdivq_f32( one, vbslq_f32( ok, det, one ) ), zero );
+
+                float32x4_t d   = vmulq_f32( vsubq_f32( vmulq_f32( rx, c ), vmulq_f32( ry, b ) ), inv );
+                float32x4_t e   = vmulq_f32( vsubq_f32( vmulq_f32( ry, a ), vmulq_f32( rx, b ) ), inv );
+                float32x4_t f   = vbslq_f32( ok, vdivq_f32( vnegq_f32( vld1q_f32( sz + o ) ), vbslq_f32( ok, w, one ) ), zero );
+
+                float32x4_t cx  = vmulq_f32( d, half );
+                float32x4_t cy  = vmulq_f32( e, half );
+                float32x4_t r2  = vsubq_f32( vaddq_f32( vmulq_f32( cx, cx ), vmulq_f32( cy, cy ) ), f );
+                uint32x4_t  pos = vandq_u32( ok, vcgtq_f32( r2, zero ) );
+
+                vst1q_f32( &mCenterX[o], vsubq_f32( vld1q_f32( meanX + o ), cx ) );
+                vst1q_f32( &mCenterY[o], vsubq_f32( vld1q_f32( meanY + o ), cy ) );
+                vst1q_f32( &mRadius[o],  vbslq_f32( pos, vsqrtq_f32( vmaxq_f32( r2, zero ) ), zero ) );
+            }
+#endif
+            for( ; o < Count; o++ )
+            {
+                float a   = sxx[o], b = sxy[o], c = syy[o];
+                float det = a * c - b * b;
+                bool  ok  = det > minDet * ( a * c ) && sw[o] > 0;
+
+                float inv = ok ? 1.0f / det : 0.0f;
+                float d   = ( -sxz[o] * c + syz[o] * b ) * inv;
+                float e   = ( -syz[o] * a + sxz[o] * b ) * inv;
+                float f   = ok ? -sz[o] / sw[o] : 0.0f;
+
+                float cx  = d * 0.5f;
+                float cy  = e * 0.5f;
+                float r2  = cx * cx + cy * cy - f;
+
+                mCenterX[o] = meanX[o] - cx;
+                mCenterY[o] = meanY[o] - cy;
+                mRadius[o]  = ( ok && r2 > 0 ) ? sqrtf( r2 ) : 0.0f;
+            }
+        }
+
+        //== Signed distance of points [Begin, End) from the circle into mDistance ==--
+
+        void Distances( int Begin, int End, float CenterX, float CenterY, float Radius )
+        {
+            int p = Begin;
+
+#if defined( CORE_SIMD_SSE2 )
+            const __m128 cx = _mm_set1_ps( CenterX );
+            const __m128 cy = _mm_set1_ps( CenterY );
+            const __m128 r  = _mm_set1_ps( Radius );
+
+            for( ; p + 4 <= End; p += 4 )
+            {
+                __m128 dx = _mm_sub_ps( _mm_loadu_ps( &mPointX[p] ), cx );
+                __m128 dy = _mm_sub_ps( _mm_loadu_ps( &mPointY[p] ), cy );
+                _mm_storeu_ps( &mDistance[p], _mm_sub_ps( _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ) ), r ) );
+            }
+#elif defined( CORE_SIMD_NEON )
+            const float32x4_t cx = vdupq_n_f32( CenterX );
+            const float32x4_t cy = vdupq_n_f32( CenterY );
+            const float32x4_t r  = vdupq_n_f32( Radius );
+
+            for( ; p + 4 <= End; p += 4 )
+            {
+                float32x4_t dx = vsubq_f32( vld1q_f32( &mPointX[p] ), cx );
+                float32x4_t dy = vsubq_f32( vld1q_f32( &mPointY[p] ), cy );
+                vst1q_f32( &mDistance[p], vsubq_f32( vsqrtq_f32( vaddq_f32( vmulq_f32( dx, dx ), vmulq_f32( dy, dy ) ) ), r ) );
+            }
+#endif
+            for( ; p < End; p++ )
+            {
+                float dx = mPointX[p] - CenterX;
+                float dy = mPointY[p] - CenterY;
+                mDistance[p] = sqrtf( dx * dx + dy * dy ) - Radius;
+            }
+        }
+
+        enum eMoments
+        {
+            MeanX = 0, MeanY, SumW, SumXX, SumYY, SumXY, SumXZ, SumYZ, SumZ,
+            kMomentCount
+        };
+
+        static const int kMinimumPoints = 6;
+
+        std::mutex                  mLock;
+        sCircleFitSettings          mSettings;
+        bool                        mEnabled;
+
+        cFrameSegments              mSegments;
+        std::vector<float>          mCentroidX;
+        std::vector<float>          mCentroidY;
+        std::vector<int>            mArea;
+        std::vector<int>            mPointStart;
+        std::vector<float>          mPointX;
+        std::vector<float>          mPointY;
+        std::vector<float>          mPointW;
+        std::vector<float>          mFitW;
+        std::vector<float>          mDistance;
+        std::vector<int>            mOrigin;
+        std::vector<float>          mMoments;
+        std::vector<float>          mCenterX;
+        std::vector<float>          mCenterY;
+        std::vector<float>          mRadius;
+        std::vector<sCircleFit>     mWork;
+
+        sFrameFits                  mHistory[ kCircleFitHistory ];
+        int                         mLatest;
+        double                      mLastFitMilliseconds;
+        long long                   mObjectsFitted;
+        long long                   mObjectsSkipped;
+    };
+}
+
+#endif
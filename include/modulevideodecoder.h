@@ -0,0 +1,338 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__MODULEVIDEODECODER_H__
+#define __CAMERALIBRARY__MODULEVIDEODECODER_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include "cameramodulebase.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    struct sVideoDecoderSettings
+    {
+        int     ThreadCount;            //== Decode threads, 0 for one per core ===================----
+        bool    FrameThreading;         //== Add frame threading to slice threading.  Scales =====----
+                                        //== better, but a picture only comes out ThreadCount-1 ==----
+                                        //== packets later, so it lands in a later Frame ========----
+
+        sVideoDecoderSettings() : ThreadCount( 0 ), FrameThreading( false ) {}
+    };
+
+    struct sVideoDecoderStatistics
+    {
+        long long   FramesDecoded;
+        long long   DecodeErrors;
+        double      LastLatencyMilliseconds;    //== Packet posted to picture converted ====----
+        double      AverageLatencyMilliseconds;
+        double      MaxLatencyMilliseconds;
+        double      LastConvertMilliseconds;    //== YUV to RGBA conversion alone =========----
+
+        sVideoDecoderStatistics() : FramesDecoded( 0 ), DecodeErrors( 0 ), LastLatencyMilliseconds( 0 ),
+            AverageLatencyMilliseconds( 0 ), MaxLatencyMilliseconds( 0 ), LastConvertMilliseconds( 0 ) {}
+    };
+}
+
+#if defined(LIBAVIMPORTED)
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <thread>
+
+//== Libav Includes ==========================================================================-----
+
+extern "C"
+{
+#include <libavutil/pixfmt.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include "Core/YUVConvert.h"
+
+namespace CameraLibrary
+{
+    //== H.264 decoder module for color cameras.  Attach one per camera in Core::VideoMode:
+    //==
+    //==     camera->AttachModule( new cModuleVideoDecoder() );
+    //==
+    //== Decoding runs on libav's slice threads.  One AVFrame is reused for every packet and its
+    //== reference counted planes come from libav's buffer pool, so neither is reallocated per
+    //== frame.  4:2:0 pictures are converted to RGBA straight into the frame buffer in one SIMD
+    //== pass (Core::cYUVConvert); other pixel formats go through swscale.
+    //==
+    //== A packet that yields no picture clears the frame buffer and reports no decode.  With
+    //== FrameThreading the picture returned for a packet is that of an earlier packet, which is
+    //== why latency is measured per picture, from its packet being posted to it being converted ==--
+
+    class cModuleVideoDecoder : public cCameraModule
+    {
+    public:
+        cModuleVideoDecoder( const sVideoDecoderSettings &Settings = sVideoDecoderSettings() )
+            : mSettings( Settings ), mInitialized( false ), mDecoderContext( 0 ), mColorConversionContext( 0 ),
+              mPicture( 0 ), mNextPacket( 0 ), mLatencySeconds( 0 ), mLatencySamples( 0 )
+        {
+            memset( mPostTimes, 0, sizeof( mPostTimes ) );
+        }
+
+        ~cModuleVideoDecoder()
+        {
+            Shutdown();
+        }
+
+        bool PostVideoData( Camera * /*Camera*/, unsigned char *Buffer, long BufferSize, Frame * /*Frame*/, int FrameWidth, int FrameHeight,
+                            unsigned char *AlignedFrameBuffer, long AlignedFrameBufferSize ) override
+        {
+            if( !mInitialized )
+            {
+                mInitialized = Initialize();
+            }
+
+            if( !mInitialized )
+            {
+                //== without a decoder just clear the output buffer to black ==--
+                memset( AlignedFrameBuffer, 0, AlignedFrameBufferSize );
+                return false;
+            }
+
+            AVPacket packet;
+            av_init_packet( &packet );
+
+            packet.data = Buffer;
+            packet.size = (int) BufferSize;
+            packet.pts  = mNextPacket++;
+
+            mPostTimes[ packet.pts % kLatencyHistory ] = Now();
+
+            AVFrame *picture = mPicture;
+
+            int finished = 0;
+            int result   = avcodec_decode_video2( mDecoderContext, picture, &finished, &packet );
+
+            if( result < 0 )
+            {
+                char error[ 256 ];
+                av_strerror( result, error, sizeof( error ) );
+                printf( "avcodec_decode_video2 >> returned error: %s\n", error );
+                avcodec_flush_buffers( mDecoderContext );
+
+                std::lock_guard<std::mutex> lock( mStatisticsLock );
+                mStatistics.DecodeErrors++;
+            }
+            else if( finished && picture->data[ 0 ] && FrameHeight > 0 )
+            {
+                double converted = Convert( picture, AlignedFrameBuffer, (int) ( AlignedFrameBufferSize / FrameHeight ), FrameWidth, FrameHeight );
+
+                UpdateStatistics( picture->pkt_pts, converted );
+
+                av_frame_unref( picture );  //== planes go back to the decoder's buffer pool ==--
+
+                return true;  //== Report that we decoded the data into the frame buffer ==--
+            }
+
+            //== no picture for this packet, don't present a stale one ==--
+
+            av_frame_unref( picture );
+            memset( AlignedFrameBuffer, 0, AlignedFrameBufferSize );
+
+            return false;
+        }
+
+        sVideoDecoderStatistics Statistics()
+        {
+            std::lock_guard<std::mutex> lock( mStatisticsLock );
+            return mStatistics;
+        }
+
+        unsigned char * AlignedMemoryAllocation( long Size )
+        {
+            return (unsigned char*) av_malloc( Size );
+        }
+
+    private:
+        static const int kLatencyHistory = 64;  //== packets in flight covered by latency tracking ==--
+
+        cModuleVideoDecoder( const cModuleVideoDecoder& );
+        cModuleVideoDecoder& operator=( const cModuleVideoDecoder& );
+
+        static double Now()
+        {
+            return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+        }
+
+        bool Initialize()
+        {
+            av_register_all();
+
+            AVCodec *decoder = avcodec_find_decoder( AV_CODEC_ID_H264 );
+            if( !decoder )
+            {
+                printf( "unable to find h264 decoder\n" );
+                return false;
+            }
+
+            mDecoderContext = avcodec_alloc_context3( decoder );
+            if( !mDecoderContext )
+            {
+                printf( "unable to allocate decoder context\n" );
+                return false;
+            }
+
+            int threads = mSettings.ThreadCount;
+            if( threads <= 0 )
+            {
+                threads = std::max( 1, (int) std::thread::hardware_concurrency() );
+            }
+
+            mDecoderContext->ticks_per_frame   = 1;
+            mDecoderContext->thread_count      = threads;
+            mDecoderContext->thread_type       = mSettings.FrameThreading ? ( FF_THREAD_FRAME | FF_THREAD_SLICE ) : FF_THREAD_SLICE;
+            mDecoderContext->refcounted_frames = 1;    //== decoded planes come from libav's buffer pool ==--
+
+            int result = avcodec_open2( mDecoderContext, decoder, 0 );
+            if( result < 0 )
+            {
+                char error[ 256 ];
+                av_strerror( result, error, sizeof( error ) );
+                printf( "unable to open decoder: %s : (%d)\n", error, result );
+                avcodec_free_context( &mDecoderContext );
+                return false;
+            }
+
+            mPicture = av_frame_alloc();
+            if( !mPicture )
+            {
+                printf( "unable to allocate libav frame\n" );
+                avcodec_free_context( &mDecoderContext );
+                return false;
+            }
+
+            return true;
+        }
+
+        void Shutdown()
+        {
+            if( mPicture )
+            {
+                av_frame_free( &mPicture );
+            }
+
+            if( mColorConversionContext )
+            {
+                sws_freeContext( mColorConversionContext );
+                mColorConversionContext = 0;
+            }
+
+            if( mDecoderContext )
+            {
+                avcodec_free_context( &mDecoderContext );
+            }
+
+            mInitialized = false;
+        }
+
+        //== Convert into the frame buffer, returns the conversion time in seconds ==--
+
+        double Convert( const AVFrame *Picture, unsigned char *Destination, int DestinationSpan, int FrameWidth, int FrameHeight )
+        {
+            double start = Now();
+
+            int width  = std::min( std::min( Picture->width, FrameWidth ), DestinationSpan / 4 );
+            int height = std::min( Picture->height, FrameHeight );
+
+            if( Picture->format == AV_PIX_FMT_YUV420P || Picture->format == AV_PIX_FMT_YUVJ420P )
+            {
+                bool fullRange = ( Picture->format == AV_PIX_FMT_YUVJ420P || Picture->color_range == AVCOL_RANGE_JPEG );
+
+                Core::cYUVConvert::I420ToRGBA( Picture->data[0], Picture->linesize[0], Picture->data[1], Picture->linesize[1],
+                                               Picture->data[2], Picture->linesize[2], width, height, Destination, DestinationSpan,
+                                               fullRange ? Core::cYUVConvert::BT601Full() : Core::cYUVConvert::BT601() );
+            }
+            else
+            {
+                mColorConversionContext = sws_getCachedContext( mColorConversionContext,
+                    Picture->width, Picture->height, (AVPixelFormat) Picture->format, width, height,
+                    AV_PIX_FMT_RGBA, SWS_BILINEAR, 0, 0, 0 );
+
+                if( mColorConversionContext )
+                {
+                    uint8_t *planes[4]  = { Destination, 0, 0, 0 };
+                    int      spans[4]   = { DestinationSpan, 0, 0, 0 };
+
+                    sws_scale( mColorConversionContext, (uint8_t const * const *) Picture->data, Picture->linesize,
+                               0, Picture->height, planes, spans );
+                }
+            }
+
+            return Now() - start;
+        }
+
+        void UpdateStatistics( int64_t PacketNumber, double ConvertSeconds )
+        {
+            double now = Now();
+
+            std::lock_guard<std::mutex> lock( mStatisticsLock );
+
+            mStatistics.FramesDecoded++;
+            mStatistics.LastConvertMilliseconds = 1000.0 * ConvertSeconds;
+
+            //== pictures older than the history (or without a packet number) have no latency sample ==--
+
+            if( PacketNumber < 0 || PacketNumber == AV_NOPTS_VALUE || mNextPacket - PacketNumber > kLatencyHistory )
+            {
+                return;
+            }
+
+            double latency = 1000.0 * ( now - mPostTimes[ PacketNumber % kLatencyHistory ] );
+
+            mLatencySeconds += latency / 1000.0;
+            mLatencySamples++;
+            mStatistics.LastLatencyMilliseconds    = latency;
+            mStatistics.AverageLatencyMilliseconds = 1000.0 * mLatencySeconds / mLatencySamples;
+            mStatistics.MaxLatencyMilliseconds     = std::max( mStatistics.MaxLatencyMilliseconds, latency );
+        }
+
+        sVideoDecoderSettings       mSettings;
+        bool                        mInitialized;
+
+        AVCodecContext *            mDecoderContext;
+        SwsContext *                mColorConversionContext;
+        AVFrame *                   mPicture;
+
+        int64_t                     mNextPacket;
+        double                      mPostTimes[ kLatencyHistory ];
+        double                      mLatencySeconds;
+        long long                   mLatencySamples;            //== pictures with a latency sample ==--
+
+        std::mutex                  mStatisticsLock;
+        sVideoDecoderStatistics     mStatistics;
+    };
+}
+
+#else
+
+namespace CameraLibrary
+{
+    //== Built without libav (define LIBAVIMPORTED and link libavcodec, libavformat, libavutil
+    //== and libswscale); attaching this module decodes nothing ==--
+
+    class cModuleVideoDecoder : public cCameraModule
+    {
+    public:
+        cModuleVideoDecoder( const sVideoDecoderSettings & /*Settings*/ = sVideoDecoderSettings() ) {}
+
+        sVideoDecoderStatistics Statistics() { return sVideoDecoderStatistics(); }
+    };
+}
+
+#endif
+
+#endif
@@ -0,0 +1,409 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__OVERLAYBUFFER_H__
+#define __CAMERALIBRARY__OVERLAYBUFFER_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "bitmap.h"
+#include "framerasterizer.h"
+#include "Core/SpanFill.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Retained overlay command buffer.  Drawing calls mirror the Bitmap primitives but only record
+    //== horizontal spans; Render() then sorts every span by scanline (stable, so later primitives
+    //== still draw over earlier ones) and draws the target one row at a time, filling opaque spans
+    //== with Core::cSpanFill and blending translucent ones with its SIMD blend.  Spans are clipped
+    //== at render time, so one buffer can be rendered into targets of any size.
+    //==
+    //== Text has no span form here (the fonts live in the library), so Print commands are kept as
+    //== is and drawn with the Bitmap::Print functions after the spans ==--
+
+    class cOverlayBuffer
+    {
+    public:
+        enum FontSize
+        {
+            FontSmall = 0,
+            FontMedium,
+            FontLarge
+        };
+
+        cOverlayBuffer() : mLastColor( 0 ) {}
+
+        //== Drop every command but keep the memory for the next frame ==--
+
+        void Clear()
+        {
+            mSpans.clear();
+            mText.clear();
+            mPalette.clear();
+            mPaletteIndex.clear();
+            mLastColor = 0;
+        }
+
+        int  SpanCount() const { return (int) mSpans.size(); }
+        int  TextCount() const { return (int) mText.size(); }
+        bool IsEmpty()   const { return mSpans.empty() && mText.empty(); }
+
+        //== Primitives.  Alpha is 0 (invisible) to 255 (opaque); the PIXEL's own alpha byte is ignored ==--
+
+        void HorizontalLine( int X, int Y, int X2, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            if( X2 < X )
+            {
+                int swap = X; X = X2; X2 = swap;
+            }
+            AddSpan( Y, X, X2, ColorIndex( Color ), Alpha );
+        }
+
+        void PutPixel( int X, int Y, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            AddSpan( Y, X, X, ColorIndex( Color ), Alpha );
+        }
+
+        void Line( int X1, int Y1, int X2, int Y2, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            //== Bresenham, emitting one span per run of pixels on the same row ==--
+
+            int dx = abs( X2 - X1 ), sx = ( X1 < X2 ) ? 1 : -1;
+            int dy = -abs( Y2 - Y1 ), sy = ( Y1 < Y2 ) ? 1 : -1;
+            int error = dx + dy;
+            int runStart = X1;
+            int color = ColorIndex( Color );
+
+            for( ;; )
+            {
+                if( X1 == X2 && Y1 == Y2 )
+                {
+                    break;
+                }
+                int e2 = 2 * error;
+                if( e2 <= dx )
+                {
+                    //== the next pixel changes row, so the current run ends here ==--
+
+                    AddRun( Y1, runStart, X1, color, Alpha );
+                    if( e2 >= dy )
+                    {
+                        error += dy;
+                        X1 += sx;
+                    }
+                    error += dx;
+                    Y1 += sy;
+                    runStart = X1;
+                }
+                else
+                {
+                    error += dy;
+                    X1 += sx;
+                }
+            }
+            AddRun( Y1, runStart, X1, color, Alpha );
+        }
+
+        void Rectangle( int X1, int Y1, int X2, int Y2, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            if( X2 < X1 ) { int swap = X1; X1 = X2; X2 = swap; }
+            if( Y2 < Y1 ) { int swap = Y1; Y1 = Y2; Y2 = swap; }
+
+            int color = ColorIndex( Color );
+
+            AddSpan( Y1, X1, X2, color, Alpha );
+            for( int y = Y1 + 1; y < Y2; y++ )
+            {
+                AddSpan( y, X1, X1, color, Alpha );
+                if( X2 != X1 )
+                {
+                    AddSpan( y, X2, X2, color, Alpha );
+                }
+            }
+            if( Y2 != Y1 )
+            {
+                AddSpan( Y2, X1, X2, color, Alpha );
+            }
+        }
+
+        void SolidRectangle( int X1, int Y1, int X2, int Y2, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            if( X2 < X1 ) { int swap = X1; X1 = X2; X2 = swap; }
+            if( Y2 < Y1 ) { int swap = Y1; Y1 = Y2; Y2 = swap; }
+
+            int color = ColorIndex( Color );
+
+            for( int y = Y1; y <= Y2; y++ )
+            {
+                AddSpan( y, X1, X2, color, Alpha );
+            }
+        }
+
+        void FillCircle( int X, int Y, int Radius, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            if( Radius < 0 )
+            {
+                return;
+            }
+
+            int color = ColorIndex( Color );
+            for( int dy = -Radius; dy <= Radius; dy++ )
+            {
+                int extent = HalfWidth( Radius, dy );
+                AddSpan( Y + dy, X - extent, X + extent, color, Alpha );
+            }
+        }
+
+        //== One pixel wide ring.  Each row covers the circle from its own outer extent in to just past
+        //== the next row's outer extent, so steep parts of the outline have no gaps ==--
+
+        void Circle( int X, int Y, int Radius, PIXEL Color = PIXELCOLOR(255,255,255), int Alpha = 255 )
+        {
+            if( Radius < 0 )
+            {
+                return;
+            }
+
+            int color = ColorIndex( Color );
+            for( int dy = -Radius; dy <= Radius; dy++ )
+            {
+                int row   = abs( dy );
+                int outer = HalfWidth( Radius, row );
+                int next  = ( row < Radius ) ? HalfWidth( Radius, row + 1 ) : -1;
+                int inner = ( row < Radius ) ? HalfWidth( Radius - 1, row ) : -1;
+
+                int edge = ( inner + 1 < next + 1 ) ? inner + 1 : next + 1;
+                if( edge > outer ) edge = outer;
+                if( edge < 0 )     edge = 0;
+
+                if( edge == 0 )
+                {
+                    AddSpan( Y + dy, X - outer, X + outer, color, Alpha );
+                }
+                else
+                {
+                    AddSpan( Y + dy, X - outer, X - edge, color, Alpha );
+                    AddSpan( Y + dy, X + edge, X + outer, color, Alpha );
+                }
+            }
+        }
+
+        void Print( int X, int Y, const char *String, PIXEL Color = PIXELCOLOR(255,255,255), FontSize Size = FontSmall )
+        {
+            sText text;
+            text.X      = X;
+            text.Y      = Y;
+            text.String = String ? String : "";
+            text.Color  = Color;
+            text.Size   = Size;
+            mText.push_back( text );
+        }
+
+        //== Draw every command.  The raw buffer form can't draw text, which needs a Bitmap ==--
+
+        void Render( Bitmap *BitmapRef )
+        {
+            if( !BitmapRef )
+            {
+                return;
+            }
+
+            Render( BitmapRef->PixelWidth(), BitmapRef->PixelHeight(), BitmapRef->ByteSpan(),
+                    BitmapRef->GetBitsPerPixel(), BitmapRef->GetBits() );
+
+            for( size_t i = 0; i < mText.size(); i++ )
+            {
+                const sText &text = mText[i];
+                switch( text.Size )
+                {
+                case FontLarge:
+                    BitmapRef->PrintLarge( text.X, text.Y, text.String.c_str(), text.Color );
+                    break;
+                case FontMedium:
+                    BitmapRef->PrintMedium( text.X, text.Y, text.String.c_str(), text.Color );
+                    break;
+                default:
+                    BitmapRef->Print( text.X, text.Y, text.String.c_str(), text.Color );
+                    break;
+                }
+            }
+        }
+
+        void Render( unsigned int Width, unsigned int Height, unsigned int Span, unsigned int BitsPerPixel, void *Buffer )
+        {
+            int bytesPerPixel = (int) BitsPerPixel / 8;
+
+            if( !Buffer || mSpans.empty() || Width == 0 || Height == 0 || bytesPerPixel < 1 || bytesPerPixel > 4
+                || Span < Width * bytesPerPixel )
+            {
+                return;
+            }
+
+            //== counting sort of the visible spans by row, copied so the row pass reads them in order ==--
+
+            mRowStart.assign( Height + 1, 0 );
+            for( size_t i = 0; i < mSpans.size(); i++ )
+            {
+                unsigned int y = (unsigned int) mSpans[i].Y;
+                if( y < Height )
+                {
+                    mRowStart[ y + 1 ]++;
+                }
+            }
+            for( unsigned int y = 0; y < Height; y++ )
+            {
+                mRowStart[ y + 1 ] += mRowStart[ y ];
+            }
+
+            mSorted.resize( mRowStart[ Height ] );
+            mRowFill.assign( mRowStart.begin(), mRowStart.end() - 1 );
+            for( size_t i = 0; i < mSpans.size(); i++ )
+            {
+                unsigned int y = (unsigned int) mSpans[i].Y;
+                if( y < Height )
+                {
+                    mSorted[ mRowFill[ y ]++ ] = mSpans[i];
+                }
+            }
+
+            //== one pass over the target, clipping each span as it is drawn ==--
+
+            mPatterns.resize( mPalette.size() );
+            for( size_t i = 0; i < mPalette.size(); i++ )
+            {
+                unsigned char pixel[ 4 ];
+                cFrameRasterizer::PackPixel( mPalette[i], bytesPerPixel, pixel );
+                Core::cSpanFill::MakePattern( pixel, bytesPerPixel, mPatterns[i] );
+            }
+
+            for( unsigned int y = 0; y < Height; y++ )
+            {
+                unsigned char *row = (unsigned char*) Buffer + (size_t) y * Span;
+
+                for( int i = mRowStart[ y ]; i < mRowStart[ y + 1 ]; i++ )
+                {
+                    const sSpan &span = mSorted[i];
+
+                    int x1 = ( span.X1 < 0 ) ? 0 : span.X1;
+                    int x2 = ( span.X2 >= (int) Width ) ? (int) Width - 1 : span.X2;
+                    if( x2 < x1 )
+                    {
+                        continue;
+                    }
+
+                    Core::cSpanFill::Blend( row + (size_t) x1 * bytesPerPixel, x2 - x1 + 1, mPatterns[ span.PaletteIndex ], span.Alpha );
+                }
+            }
+        }
+
+    private:
+        struct sSpan
+        {
+            int            Y;
+            int            X1;
+            int            X2;
+            unsigned int   PaletteIndex : 24;   //== into mPalette ==--
+            unsigned int   Alpha        : 8;
+        };
+
+        struct sText
+        {
+            int         X;
+            int         Y;
+            std::string String;
+            PIXEL       Color;
+            FontSize    Size;
+        };
+
+        //== Spans refer to colors by palette index so Render() packs each color only once ==--
+
+        int  ColorIndex( PIXEL Color )
+        {
+            if( mLastColor < (int) mPalette.size() && mPalette[ mLastColor ] == Color )
+            {
+                return mLastColor;
+            }
+
+            std::unordered_map<PIXEL, int>::const_iterator known = mPaletteIndex.find( Color );
+            if( known != mPaletteIndex.end() )
+            {
+                return mLastColor = known->second;
+            }
+
+            //== the index field holds 24 bits; past that, further new colors reuse the last entry ==--
+
+            if( (int) mPalette.size() >= kMaxPalette )
+            {
+                return mLastColor = kMaxPalette - 1;
+            }
+
+            mLastColor = (int) mPalette.size();
+            mPalette.push_back( Color );
+            mPaletteIndex[ Color ] = mLastColor;
+            return mLastColor;
+        }
+
+        void AddRun( int Y, int X1, int X2, int PaletteIndex, int Alpha )
+        {
+            if( X2 < X1 )
+            {
+                AddSpan( Y, X2, X1, PaletteIndex, Alpha );
+            }
+            else
+            {
+                AddSpan( Y, X1, X2, PaletteIndex, Alpha );
+            }
+        }
+
+        void AddSpan( int Y, int X1, int X2, int PaletteIndex, int Alpha )
+        {
+            if( X2 < X1 || Alpha <= 0 )
+            {
+                return;
+            }
+
+            sSpan span;
+            span.Y            = Y;
+            span.X1           = X1;
+            span.X2           = X2;
+            span.PaletteIndex = (unsigned int) PaletteIndex;
+            span.Alpha        = (unsigned int) ( ( Alpha > 255 ) ? 255 : Alpha );
+            mSpans.push_back( span );
+        }
+
+        //== Half width of a circle of Radius on the row Row pixels from its center ==--
+
+        static int HalfWidth( int Radius, int Row )
+        {
+            int squared = Radius * Radius - Row * Row;
+            return ( squared < 0 ) ? -1 : (int) ( sqrt( (double) squared ) + 0.5 );
+        }
+
+        static const int kMaxPalette = 1 << 24;
+
+        std::vector<sSpan>  mSpans;
+        std::vector<sText>  mText;
+        std::vector<PIXEL>  mPalette;
+        std::unordered_map<PIXEL, int> mPaletteIndex;
+        int                 mLastColor;
+
+        //== render scratch, kept between frames ==--
+
+        std::vector<int>    mRowStart;
+        std::vector<int>    mRowFill;
+        std::vector<sSpan>  mSorted;
+        std::vector<Core::cSpanFill::sPattern> mPatterns;
+    };
+}
+
+#endif
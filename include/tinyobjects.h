@@ -0,0 +1,316 @@
+
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__TINYOBJECTS_H__
+#define __CAMERALIBRARY__TINYOBJECTS_H__
+
+//== INCLUDES ===========================================================================================----
+
+#include <stddef.h>
+#include <string.h>
+
+#include "object.h"
+#include "Core/SIMD.h"
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Bulk conversion between arrays of cTinyObject and structure-of-arrays floats, for streams of
+    //== 2D data where converting one cObject at a time dominates.  Quantization:
+    //==   X, Y       whole pixels in X / Y and 1/256 pixel in XMantissa / YMantissa, clamped to
+    //==              0 .. 65535 + 255/256 and rounded to the nearest 1/256
+    //==   Roundness  1/255 steps, clamped to 0 .. 1
+    //==   Area       whole pixels, clamped to 0 .. 255
+    //==
+    //== This quantization is cTinyObjects' own.  cTinyObject::PopulateFrom and WriteTo are compiled
+    //== into the library and theirs is not published, so the two may round or scale differently:
+    //== unpack objects packed here with Unpack, and objects filled by PopulateFrom with WriteTo.
+    //==
+    //== Area has a single byte, so markers covering more than 255 pixels (about 18 pixels across)
+    //== are stored as 255 and lose the rest of their area.  Pack returns how many objects were
+    //== clamped so callers can count them or keep such frames at full precision.
+    //==
+    //== The vector kernels convert four objects per step and give the same results as the scalar
+    //== kernels, which also finish the tails ==--
+
+    class cTinyObjects
+    {
+    public:
+        static void Unpack( const cTinyObject *Objects, int Count, float *X, float *Y, float *Area, float *Roundness,
+                            Core::eSIMDLevel Level = Core::BestSIMDLevel() )
+        {
+            int i = 0;
+
+#if defined( CORE_SIMD_SSE2 )
+            if( Level >= Core::SIMDSSE2 )
+            {
+                i = UnpackSSE2( Objects, Count, X, Y, Area, Roundness );
+            }
+#endif
+#if defined( CORE_SIMD_NEON )
+            if( Level >= Core::SIMDNEON )
+            {
+                i = UnpackNEON( Objects, Count, X, Y, Area, Roundness );
+            }
+#endif
+            for( ; i < Count; i++ )
+            {
+                const cTinyObject &object = Objects[i];
+                X[i]         = (float) object.X + (float) object.XMantissa * ( 1.0f / 256.0f );
+                Y[i]         = (float) object.Y + (float) object.YMantissa * ( 1.0f / 256.0f );
+                Area[i]      = (float) object.Area;
+                Roundness[i] = (float) object.Roundness * ( 1.0f / 255.0f );
+            }
+        }
+
+        //== Returns the number of objects whose area did not fit in a byte and was stored as 255 ==--
+
+        static int  Pack( const float *X, const float *Y, const float *Area, const float *Roundness, int Count,
+                          cTinyObject *Objects, Core::eSIMDLevel Level = Core::BestSIMDLevel() )
+        {
+            int clamped = 0;
+            for( int k = 0; k < Count; k++ )
+            {
+                clamped += ( Area[k] >= 255.5f ) ? 1 : 0;
+            }
+
+            int i = 0;
+
+#if defined( CORE_SIMD_SSE2 )
+            if( Level >= Core::SIMDSSE2 )
+            {
+                i = PackSSE2( X, Y, Area, Roundness, Count, Objects );
+            }
+#endif
+#if defined( CORE_SIMD_NEON )
+            if( Level >= Core::SIMDNEON )
+            {
+                i = PackNEON( X, Y, Area, Roundness, Count, Objects );
+            }
+#endif
+            for( ; i < Count; i++ )
+            {
+                unsigned int x = Quantize( X[i] * 256.0f, PositionLimit() );
+                unsigned int y = Quantize( Y[i] * 256.0f, PositionLimit() );
+
+                //== built in a zeroed temporary so the padding bytes match the vector kernels ==--
+
+                cTinyObject object;
+                memset( &object, 0, sizeof( object ) );
+                object.X         = (unsigned short) ( x >> 8 );
+                object.XMantissa = (unsigned char) ( x & 255 );
+                object.Y         = (unsigned short) ( y >> 8 );
+                object.YMantissa = (unsigned char) ( y & 255 );
+                object.Roundness = (unsigned char) Quantize( Roundness[i] * 255.0f, 255.0f );
+                object.Area      = (unsigned char) Quantize( Area[i], 255.0f );
+                memcpy( Objects + i, &object, sizeof( object ) );
+            }
+
+            return clamped;
+        }
+
+    private:
+        //== The vector kernels address fields by byte offset: X, XMantissa, Y, YMantissa, Roundness,
+        //== Area at 0, 2, 4, 6, 7, 8, one object per 10 bytes ==--
+
+        static_assert( offsetof( cTinyObject, XMantissa ) == 2 && offsetof( cTinyObject, Y ) == 4 &&
+                       offsetof( cTinyObject, YMantissa ) == 6 && offsetof( cTinyObject, Roundness ) == 7 &&
+                       offsetof( cTinyObject, Area ) == 8 && sizeof( cTinyObject ) == 10, "cTinyObject layout" );
+
+        static const int kStride = (int) sizeof( cTinyObject );
+
+        static float PositionLimit() { return 16777215.0f; }     //== 65535 + 255/256 in 1/256 steps ==--
+
+        //== max( Value, 0 ) + 0.5, capped at Limit and truncated, in the order the vector kernels use;
+        //== NaN becomes 0 ==--
+
+        static unsigned int Quantize( float Value, float Limit )
+        {
+            Value = ( Value > 0.0f ) ? Value : 0.0f;
+            Value = Value + 0.5f;
+            Value = ( Value < Limit ) ? Value : Limit;
+            return (unsigned int) Value;
+        }
+
+        //== Objects whose 16 byte load stays inside the array ==--
+
+        static int VectorCount( int Count )
+        {
+            int count = 0;
+            while( count + 4 <= Count && (long long) ( count + 3 ) * kStride + 16 <= (long long) Count * kStride )
+            {
+                count += 4;
+            }
+            return count;
+        }
+
+        //== dwords 0, 1 and 2 of each of four objects into 8 bytes + 2 bytes of each destination ==--
+
+        static void StoreObjects( const unsigned int *Dwords, cTinyObject *Objects )
+        {
+            for( int k = 0; k < 4; k++ )
+            {
+                unsigned char *object = (unsigned char*) ( Objects + k );
+                unsigned short area   = (unsigned short) Dwords[ 8 + k ];
+                unsigned int   low    = Dwords[k];
+                unsigned int   high   = Dwords[ 4 + k ];
+                memcpy( object,     &low,  4 );
+                memcpy( object + 4, &high, 4 );
+                memcpy( object + 8, &area, 2 );
+            }
+        }
+
+#if defined( CORE_SIMD_SSE2 )
+        static int UnpackSSE2( const cTinyObject *Objects, int Count, float *X, float *Y, float *Area, float *Roundness )
+        {
+            const __m128i low16  = _mm_set1_epi32( 0xFFFF );
+            const __m128i low8   = _mm_set1_epi32( 0xFF );
+            const __m128  step   = _mm_set1_ps( 1.0f / 256.0f );
+            const __m128  unit   = _mm_set1_ps( 1.0f / 255.0f );
+            const unsigned char *data = (const unsigned char*) Objects;
+
+            int vectorCount = VectorCount( Count );
+            for( int i = 0; i < vectorCount; i += 4, data += 4 * kStride )
+            {
+                __m128i o0 = _mm_loadu_si128( (const __m128i*) data );
+                __m128i o1 = _mm_loadu_si128( (const __m128i*) ( data + kStride ) );
+                __m128i o2 = _mm_loadu_si128( (const __m128i*) ( data + 2 * kStride ) );
+                __m128i o3 = _mm_loadu_si128( (const __m128i*) ( data + 3 * kStride ) );
+
+                //== transpose: dword n of objects 0..3 into dn ==--
+
+                __m128i t01 = _mm_unpacklo_epi32( o0, o1 );
+                __m128i t23 = _mm_unpacklo_epi32( o2, o3 );
+                __m128i d0  = _mm_unpacklo_epi64( t01, t23 );
+                __m128i d1  = _mm_unpackhi_epi64( t01, t23 );
+                __m128i d2  = _mm_unpacklo_epi64( _mm_unpackhi_epi32( o0, o1 ), _mm_unpackhi_epi32( o2, o3 ) );
+
+                __m128 x = _mm_add_ps( _mm_cvtepi32_ps( _mm_and_si128( d0, low16 ) ),
+                                       _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( d0, 16 ), low8 ) ), step ) );
+                __m128 y = _mm_add_ps( _mm_cvtepi32_ps( _mm_and_si128( d1, low16 ) ),
+                                       _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( d1, 16 ), low8 ) ), step ) );
+
+                _mm_storeu_ps( X + i,         x );
+                _mm_storeu_ps( Y + i,         y );
+                _mm_storeu_ps( Roundness + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( d1, 24 ) ), unit ) );
+                _mm_storeu_ps( Area + i,      _mm_cvtepi32_ps( _mm_and_si128( d2, low8 ) ) );
+            }
+            return vectorCount;
+        }
+
+        static __m128i QuantizeSSE2( __m128 Value, __m128 Limit )
+        {
+            Value = _mm_max_ps( Value, _mm_setzero_ps() );
+            Value = _mm_add_ps( Value, _mm_set1_ps( 0.5f ) );
+            Value = _mm_min_ps( Value, Limit );
+            return _mm_cvttps_epi32( Value );
+        }
+
+        static int PackSSE2( const float *X, const float *Y, const float *Area, const float *Roundness, int Count,
+                             cTinyObject *Objects )
+        {
+            const __m128  position = _mm_set1_ps( PositionLimit() );
+            const __m128  limit8   = _mm_set1_ps( 255.0f );
+            const __m128  scale    = _mm_set1_ps( 256.0f );
+            const __m128i low8     = _mm_set1_epi32( 0xFF );
+
+            unsigned int dwords[ 12 ];
+
+            int i = 0;
+            for( ; i + 4 <= Count; i += 4 )
+            {
+                __m128i x = QuantizeSSE2( _mm_mul_ps( _mm_loadu_ps( X + i ), scale ), position );
+                __m128i y = QuantizeSSE2( _mm_mul_ps( _mm_loadu_ps( Y + i ), scale ), position );
+                __m128i r = QuantizeSSE2( _mm_mul_ps( _mm_loadu_ps( Roundness + i ), limit8 ), limit8 );
+                __m128i a = QuantizeSSE2( _mm_loadu_ps( Area + i ), limit8 );
+
+                //== whole pixels to the low 16 bits, mantissas to byte 2, roundness to byte 3 ==--
+
+                __m128i d0 = _mm_or_si128( _mm_srli_epi32( x, 8 ), _mm_slli_epi32( _mm_and_si128( x, low8 ), 16 ) );
+                __m128i d1 = _mm_or_si128( _mm_or_si128( _mm_srli_epi32( y, 8 ), _mm_slli_epi32( _mm_and_si128( y, low8 ), 16 ) ),
+                                           _mm_slli_epi32( r, 24 ) );
+
+                _mm_storeu_si128( (__m128i*) dwords,       d0 );
+                _mm_storeu_si128( (__m128i*) ( dwords + 4 ), d1 );
+                _mm_storeu_si128( (__m128i*) ( dwords + 8 ), a );
+                StoreObjects( dwords, Objects + i );
+            }
+            return i;
+        }
+#endif
+
+#if defined( CORE_SIMD_NEON )
+        static int UnpackNEON( const cTinyObject *Objects, int Count, float *X, float *Y, float *Area, float *Roundness )
+        {
+            const uint32x4_t low16 = vdupq_n_u32( 0xFFFF );
+            const uint32x4_t low8  = vdupq_n_u32( 0xFF );
+            const unsigned char *data = (const unsigned char*) Objects;
+
+            int vectorCount = VectorCount( Count );
+            for( int i = 0; i < vectorCount; i += 4, data += 4 * kStride )
+            {
+                uint32x4x2_t t01 = vzipq_u32( vreinterpretq_u32_u8( vld1q_u8( data ) ),
+                                              vreinterpretq_u32_u8( vld1q_u8( data + kStride ) ) );
+                uint32x4x2_t t23 = vzipq_u32( vreinterpretq_u32_u8( vld1q_u8( data + 2 * kStride ) ),
+                                              vreinterpretq_u32_u8( vld1q_u8( data + 3 * kStride ) ) );
+
+                uint32x4_t d0 = vcombine_u32( vget_low_u32( t01.val[0] ),  vget_low_u32( t23.val[0] ) );
+                uint32x4_t d1 = vcombine_u32( vget_high_u32( t01.val[0] ), vget_high_u32( t23.val[0] ) );
+                uint32x4_t d2 = vcombine_u32( vget_low_u32( t01.val[1] ),  vget_low_u32( t23.val[1] ) );
+
+                float32x4_t x = vaddq_f32( vcvtq_f32_u32( vandq_u32( d0, low16 ) ),
+                                           vmulq_n_f32( vcvtq_f32_u32( vandq_u32( vshrq_n_u32( d0, 16 ), low8 ) ), 1.0f / 256.0f ) );
+                float32x4_t y = vaddq_f32( vcvtq_f32_u32( vandq_u32( d1, low16 ) ),
+                                           vmulq_n_f32( vcvtq_f32_u32( vandq_u32( vshrq_n_u32( d1, 16 ), low8 ) ), 1.0f / 256.0f ) );
+
+                vst1q_f32( X + i,         x );
+                vst1q_f32( Y + i,         y );
+                vst1q_f32( Roundness + i, vmulq_n_f32( vcvtq_f32_u32( vshrq_n_u32( d1, 24 ) ), 1.0f / 255.0f ) );
+                vst1q_f32( Area + i,      vcvtq_f32_u32( vandq_u32( d2, low8 ) ) );
+            }
+            return vectorCount;
+        }
+
+        static uint32x4_t QuantizeNEON( float32x4_t Value, float32x4_t Limit )
+        {
+            //== vmaxq_f32 would keep NaN; compare and select so NaN becomes 0 as in Quantize() ==--
+
+            Value = vbslq_f32( vcgtq_f32( Value, vdupq_n_f32( 0.0f ) ), Value, vdupq_n_f32( 0.0f ) );
+            Value = vaddq_f32( Value, vdupq_n_f32( 0.5f ) );
+            Value = vbslq_f32( vcltq_f32( Value, Limit ), Value, Limit );
+            return vcvtq_u32_f32( Value );
+        }
+
+        static int PackNEON( const float *X, const float *Y, const float *Area, const float *Roundness, int Count,
+                             cTinyObject *Objects )
+        {
+            const float32x4_t position = vdupq_n_f32( PositionLimit() );
+            const float32x4_t limit8   = vdupq_n_f32( 255.0f );
+            const uint32x4_t  low8     = vdupq_n_u32( 0xFF );
+
+            unsigned int dwords[ 12 ];
+
+            int i = 0;
+            for( ; i + 4 <= Count; i += 4 )
+            {
+                uint32x4_t x = QuantizeNEON( vmulq_n_f32( vld1q_f32( X + i ), 256.0f ), position );
+                uint32x4_t y = QuantizeNEON( vmulq_n_f32( vld1q_f32( Y + i ), 256.0f ), position );
+                uint32x4_t r = QuantizeNEON( vmulq_n_f32( vld1q_f32( Roundness + i ), 255.0f ), limit8 );
+                uint32x4_t a = QuantizeNEON( vld1q_f32( Area + i ), limit8 );
+
+                vst1q_u32( dwords,     vorrq_u32( vshrq_n_u32( x, 8 ), vshlq_n_u32( vandq_u32( x, low8 ), 16 ) ) );
+                vst1q_u32( dwords + 4, vorrq_u32( vorrq_u32( vshrq_n_u32( y, 8 ), vshlq_n_u32( vandq_u32( y, low8 ), 16 ) ),
+                                                  vshlq_n_u32( r, 24 ) ) );
+                vst1q_u32( dwords + 8, a );
+                StoreObjects( dwords, Objects + i );
+            }
+            return i;
+        }
+#endif
+    };
+}
+
+#endif
@@ -1,2 +1,681 @@
-//== Placeholder: No public interface ==--
 
+//======================================================================================================-----
+//== Copyright NaturalPoint, All Rights Reserved
+//======================================================================================================-----
+
+#ifndef __CAMERALIBRARY__ZIPHELPERS_H__
+#define __CAMERALIBRARY__ZIPHELPERS_H__
+
+//== INCLUDES ===========================================================================================----
+
+#if defined(ZLIBIMPORTED)
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "Core/MemoryMappedFile.h"
+#include "inputmanagerfile/directfile.h"
+
+#endif
+
+//== GLOBAL DEFINITIONS AND SETTINGS ====================================================================----
+
+namespace CameraLibrary
+{
+    //== Chunked zlib streams.  Data written to a cZipChunkWriter is cut into chunks that are
+    //== compressed in parallel by a pool of worker threads and written in order, each as its own
+    //== zlib stream.  Any chunk can therefore be located through the index and decompressed on its
+    //== own, which makes the stream seekable by uncompressed offset.
+    //==
+    //== File layout:
+    //==   sZipStreamHeader
+    //==   sZipChunkHeader + compressed data, for every chunk
+    //==   sZipChunkIndex x ChunkCount, sZipStreamTrailer
+    //==
+    //== A chunk that zlib fails on, or does not shrink, is stored uncompressed and marked with
+    //== kZipChunkStoredMagic, so no data is lost.  A stream without its trailer (e.g. an
+    //== interrupted recording) is recovered by walking the chunk headers.
+    //==
+    //== The writer and reader need zlib and C++11: define ZLIBIMPORTED and link zlib.  Without it
+    //== only the file format definitions below are available.
+
+    const unsigned int kZipStreamMagic      = 0x5A53504E;   //== 'NPSZ' ==--
+    const unsigned int kZipChunkMagic       = 0x4B43504E;   //== 'NPCK' ==--
+    const unsigned int kZipChunkStoredMagic = 0x5343504E;   //== 'NPCS', uncompressed chunk, version 2 ==--
+    const unsigned int kZipStreamVersion    = 2;
+
+    const int kZipDefaultChunkSize = 1024 * 1024;
+
+    struct sZipStreamHeader
+    {
+        unsigned int       Magic;
+        unsigned int       Version;
+        unsigned int       ChunkSize;
+        int                Level;
+    };
+
+    struct sZipChunkHeader
+    {
+        unsigned int       Magic;
+        unsigned int       CompressedSize;
+        unsigned int       UncompressedSize;
+        unsigned int       Checksum;            //== adler32 of the uncompressed data ==--
+        unsigned long long UncompressedOffset;
+    };
+
+    struct sZipChunkIndex
+    {
+        unsigned long long FileOffset;          //== of the chunk header ==--
+        unsigned long long UncompressedOffset;
+        unsigned int       CompressedSize;
+        unsigned int       UncompressedSize;
+    };
+
+    struct sZipStreamTrailer
+    {
+        unsigned long long IndexOffset;
+        unsigned long long ChunkCount;
+        unsigned int       Magic;
+        unsigned int       Reserved;
+    };
+
+    struct sZipStreamSettings
+    {
+        sZipStreamSettings() : ChunkSize( kZipDefaultChunkSize ), Level( 1 ), ThreadCount( 0 ), MaxPendingChunks( 0 ) { }
+
+        int ChunkSize;          //== uncompressed bytes per chunk ==--
+        int Level;              //== zlib level, 0 (store) .. 9 (best), default 1 (Z_BEST_SPEED) ==--
+        int ThreadCount;        //== compression threads, 0 = one per core ==--
+        int MaxPendingChunks;   //== chunks buffered ahead of the disk, 0 = 2 per thread ==--
+    };
+
+}
+
+#if defined(ZLIBIMPORTED)
+
+namespace CameraLibrary
+{
+    //== Parallel chunk compressor.  Write() returns as soon as the data is buffered; it only waits
+    //== when MaxPendingChunks chunks are already queued, which bounds memory use ==--
+
+    class cZipChunkWriter
+    {
+    public:
+        cZipChunkWriter() : mCurrent( 0 ), mOffset( 0 ), mFileOffset( 0 ), mNextSequence( 0 ), mNextWrite( 0 ),
+            mWriting( false ), mRunning( false ), mBytesIn( 0 ), mBytesOut( 0 ), mWriteErrors( 0 )
+        {
+        }
+
+        ~cZipChunkWriter()
+        {
+            Close();
+        }
+
+        bool Open( const char *Filename, const sZipStreamSettings &Settings = sZipStreamSettings() )
+        {
+            Close();
+
+            mSettings = Settings;
+            if( mSettings.ChunkSize < 4096 )
+            {
+                mSettings.ChunkSize = 4096;
+            }
+            if( mSettings.Level < Z_NO_COMPRESSION || mSettings.Level > Z_BEST_COMPRESSION )
+            {
+                mSettings.Level = Z_DEFAULT_COMPRESSION;
+            }
+            if( mSettings.ThreadCount <= 0 )
+            {
+                mSettings.ThreadCount = std::max( 1, (int) std::thread::hardware_concurrency() );
+            }
+            if( mSettings.MaxPendingChunks <= 0 )
+            {
+                mSettings.MaxPendingChunks = 2 * mSettings.ThreadCount;
+            }
+
+            if( !mFile.Open( Filename, false ) )
+            {
+                return false;
+            }
+
+            sZipStreamHeader header;
+            header.Magic     = kZipStreamMagic;
+            header.Version   = kZipStreamVersion;
+            header.ChunkSize = (unsigned int) mSettings.ChunkSize;
+            header.Level     = mSettings.Level;
+
+            if( !mFile.WriteAt( (const unsigned char*) &header, sizeof( header ), 0 ) )
+            {
+                mFile.Close();
+                return false;
+            }
+
+            const size_t bound = sizeof( sZipChunkHeader ) + compressBound( (uLong) mSettings.ChunkSize );
+
+            for( int i = 0; i < mSettings.MaxPendingChunks + 1; i++ )
+            {
+                sChunk *chunk = new sChunk();
+                chunk->Input.resize( mSettings.ChunkSize );
+                chunk->Output.resize( bound );
+                mChunks.push_back( chunk );
+                mFree.push_back( chunk );
+            }
+
+            mIndex.clear();
+            mOffset       = 0;
+            mFileOffset   = sizeof( sZipStreamHeader );
+            mNextSequence = 0;
+            mNextWrite    = 0;
+            mBytesIn      = 0;
+            mBytesOut     = 0;
+            mWriteErrors  = 0;
+            mCurrent      = Acquire();
+            mRunning      = true;
+
+            for( int i = 0; i < mSettings.ThreadCount; i++ )
+            {
+                mThreads.push_back( std::thread( &cZipChunkWriter::WorkerThread, this ) );
+            }
+
+            return true;
+        }
+
+        //== Compress the remaining data, then write the index and trailer ==--
+
+        bool Close()
+        {
+            if( mChunks.empty() )
+            {
+                return false;
+            }
+
+            Flush();
+
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mRunning = false;
+            }
+            mWork.notify_all();
+            for( size_t i = 0; i < mThreads.size(); i++ )
+            {
+                mThreads[ i ].join();
+            }
+            mThreads.clear();
+
+            bool success = ( mWriteErrors == 0 );
+
+            sZipStreamTrailer trailer;
+            trailer.IndexOffset = mFileOffset;
+            trailer.ChunkCount  = mIndex.size();
+            trailer.Magic       = kZipStreamMagic;
+            trailer.Reserved    = 0;
+
+            if( !mIndex.empty() )
+            {
+                success = mFile.WriteAt( (const unsigned char*) &mIndex[ 0 ], mIndex.size() * sizeof( sZipChunkIndex ), mFileOffset ) && success;
+            }
+            success = mFile.WriteAt( (const unsigned char*) &trailer, sizeof( trailer ),
+                mFileOffset + mIndex.size() * sizeof( sZipChunkIndex ) ) && success;
+
+            mFile.Close();
+
+            for( size_t i = 0; i < mChunks.size(); i++ )
+            {
+                delete mChunks[ i ];
+            }
+            mChunks.clear();
+            mFree.clear();
+            mQueue.clear();
+            mCurrent = 0;
+
+            return success;
+        }
+
+        bool IsOpen() const { return !mChunks.empty(); }
+
+        //== Append data, splitting it across chunks as needed ==--
+
+        void Write( const unsigned char *Buffer, size_t Size )
+        {
+            while( Size > 0 && mCurrent )
+            {
+                size_t count = std::min( Size, (size_t) mSettings.ChunkSize - mCurrent->Used );
+
+                memcpy( &mCurrent->Input[ mCurrent->Used ], Buffer, count );
+                mCurrent->Used += count;
+                Buffer         += count;
+                Size           -= count;
+
+                if( mCurrent->Used == (size_t) mSettings.ChunkSize )
+                {
+                    Submit();
+                }
+            }
+        }
+
+        //== Append a record that must not straddle two chunks, so every chunk holds whole records.
+        //== Records larger than a chunk are split like Write() ==--
+
+        void WriteRecord( const unsigned char *Buffer, size_t Size )
+        {
+            if( mCurrent && mCurrent->Used > 0 && mCurrent->Used + Size > (size_t) mSettings.ChunkSize )
+            {
+                Submit();
+            }
+            Write( Buffer, Size );
+        }
+
+        //== End the current chunk early, e.g. to place a seek point ==--
+
+        void Flush()
+        {
+            if( mCurrent && mCurrent->Used > 0 )
+            {
+                Submit();
+            }
+        }
+
+        //== Statistics ==--
+
+        unsigned long long BytesIn()       const { return mBytesIn; }
+        unsigned long long BytesOut()      const { return mBytesOut; }
+        long long          WriteErrors()   const { return mWriteErrors; }
+        int                ThreadCount()   const { return mSettings.ThreadCount; }
+        int                PendingChunks()
+        {
+            std::lock_guard<std::mutex> lock( mLock );
+            return (int) ( mChunks.size() - mFree.size() ) - ( mCurrent ? 1 : 0 );
+        }
+
+    private:
+        struct sChunk
+        {
+            sChunk() : Used( 0 ), Sequence( 0 ), Offset( 0 ), CompressedSize( 0 ), Done( false ) { }
+
+            std::vector<unsigned char> Input;
+            std::vector<unsigned char> Output;      //== sZipChunkHeader + compressed data ==--
+            size_t                     Used;
+            unsigned long long         Sequence;
+            unsigned long long         Offset;      //== uncompressed offset ==--
+            size_t                     CompressedSize;
+            bool                       Done;
+        };
+
+        //== Next free chunk, waits while MaxPendingChunks are in flight ==--
+
+        sChunk * Acquire()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+            mFreed.wait( lock, [this] { return !mFree.empty(); } );
+
+            sChunk *chunk = mFree.back();
+            mFree.pop_back();
+            chunk->Used = 0;
+            chunk->Done = false;
+            return chunk;
+        }
+
+        void Submit()
+        {
+            mCurrent->Offset = mOffset;
+            mOffset  += mCurrent->Used;
+            mBytesIn += mCurrent->Used;
+            {
+                std::lock_guard<std::mutex> lock( mLock );
+                mCurrent->Sequence = mNextSequence++;
+                mQueue.push_back( mCurrent );
+            }
+            mWork.notify_one();
+
+            mCurrent = Acquire();
+        }
+
+        void WorkerThread()
+        {
+            std::unique_lock<std::mutex> lock( mLock );
+
+            while( true )
+            {
+                mWork.wait( lock, [this] { return !mQueue.empty() || !mRunning; } );
+
+                if( mQueue.empty() )
+                {
+                    break;
+                }
+
+                sChunk *chunk = mQueue.front();
+                mQueue.pop_front();
+
+                lock.unlock();
+
+                Compress( chunk );
+
+                lock.lock();
+                chunk->Done = true;
+
+                //== whichever worker completes the next chunk in sequence writes out every
+                //== completed chunk that is now in order ==--
+
+                if( chunk->Sequence == mNextWrite && !mWriting )
+                {
+                    mWriting = true;
+                    WriteCompleted( lock );
+                    mWriting = false;
+                }
+            }
+        }
+
+        void Compress( sChunk *chunk )
+        {
+            sZipChunkHeader *header = (sZipChunkHeader*) &chunk->Output[ 0 ];
+
+            uLongf size = (uLongf) ( chunk->Output.size() - sizeof( sZipChunkHeader ) );
+
+            //== keep the data even when zlib fails; Output is compressBound() sized, so it always fits ==--
+
+            bool stored = compress2( &chunk->Output[ sizeof( sZipChunkHeader ) ], &size, &chunk->Input[ 0 ], (uLong) chunk->Used,
+                mSettings.Level ) != Z_OK || size >= chunk->Used;
+
+            if( stored )
+            {
+                memcpy( &chunk->Output[ sizeof( sZipChunkHeader ) ], &chunk->Input[ 0 ], chunk->Used );
+                size = (uLongf) chunk->Used;
+            }
+
+            header->Magic              = stored ? kZipChunkStoredMagic : kZipChunkMagic;
+            header->CompressedSize     = (unsigned int) size;
+            header->UncompressedSize   = (unsigned int) chunk->Used;
+            header->Checksum           = (unsigned int) adler32( adler32( 0, Z_NULL, 0 ), &chunk->Input[ 0 ], (uInt) chunk->Used );
+            header->UncompressedOffset = chunk->Offset;
+
+            chunk->CompressedSize = size;
+        }
+
+        //== Write completed chunks in sequence order (lock held on entry and exit) ==--
+
+        void WriteCompleted( std::unique_lock<std::mutex> &lock )
+        {
+            while( true )
+            {
+                sChunk *next = 0;
+                for( size_t i = 0; i < mChunks.size(); i++ )
+                {
+                    if( mChunks[ i ]->Done && mChunks[ i ]->Sequence == mNextWrite )
+                    {
+                        next = mChunks[ i ];
+                        break;
+                    }
+                }
+                if( !next )
+                {
+                    return;
+                }
+
+                next->Done = false;
+
+                sZipChunkIndex entry;
+                entry.FileOffset         = mFileOffset;
+                entry.UncompressedOffset = next->Offset;
+                entry.CompressedSize     = (unsigned int) next->CompressedSize;
+                entry.UncompressedSize   = (unsigned int) next->Used;
+
+                const size_t size = sizeof( sZipChunkHeader ) + next->CompressedSize;
+                mFileOffset += size;
+
+                lock.unlock();
+
+                if( !mFile.WriteAt( &next->Output[ 0 ], size, entry.FileOffset ) )
+                {
+                    mWriteErrors++;
+                }
+                mBytesOut += size;
+
+                lock.lock();
+
+                mIndex.push_back( entry );
+                mNextWrite++;
+                mFree.push_back( next );
+                mFreed.notify_one();
+            }
+        }
+
+        sZipStreamSettings                mSettings;
+        cDirectFile                       mFile;
+
+        std::vector<sChunk*>              mChunks;
+        std::vector<sChunk*>              mFree;
+        std::deque<sChunk*>               mQueue;
+        sChunk *                          mCurrent;
+
+        std::vector<sZipChunkIndex>       mIndex;
+        unsigned long long                mOffset;
+        unsigned long long                mFileOffset;
+        unsigned long long                mNextSequence;
+        unsigned long long                mNextWrite;
+        bool                              mWriting;
+        bool                              mRunning;
+
+        std::atomic<unsigned long long>   mBytesIn;
+        std::atomic<unsigned long long>   mBytesOut;
+        std::atomic<long long>            mWriteErrors;
+
+        std::vector<std::thread>          mThreads;
+        std::mutex                        mLock;
+        std::condition_variable           mWork;
+        std::condition_variable           mFreed;
+    };
+
+    //== Random access reader for chunked zlib streams.  Reads locate their chunk with a binary
+    //== search of the index and decompress only the chunks they touch; the last chunk is cached ==--
+
+    class cZipChunkReader
+    {
+    public:
+        cZipChunkReader() : mSize( 0 ), mCached( -1 ) { }
+
+        bool Open( const char *Filename )
+        {
+            Close();
+
+            if( !mFile.Open( Filename ) || mFile.Size() < sizeof( sZipStreamHeader ) )
+            {
+                return false;
+            }
+
+            memcpy( &mHeader, mFile.Data(), sizeof( mHeader ) );
+            if( mHeader.Magic != kZipStreamMagic || mHeader.Version < 1 || mHeader.Version > kZipStreamVersion )
+            {
+                Close();
+                return false;
+            }
+
+            if( !LoadIndex() )
+            {
+                RebuildIndex();
+            }
+
+            mSize = mIndex.empty() ? 0 : mIndex.back().UncompressedOffset + mIndex.back().UncompressedSize;
+
+            mFile.Advise( Core::cMemoryMappedFile::AccessRandom );
+            return true;
+        }
+
+        void Close()
+        {
+            mFile.Close();
+            mIndex.clear();
+            mSize   = 0;
+            mCached = -1;
+        }
+
+        unsigned long long      Size()       const { return mSize; }
+        int                     ChunkCount() const { return (int) mIndex.size(); }
+        const sZipChunkIndex &  Chunk( int Index ) const { return mIndex[ Index ]; }
+
+        //== Chunk holding an uncompressed offset, or -1 ==--
+
+        int FindChunk( unsigned long long Offset ) const
+        {
+            std::vector<sZipChunkIndex>::const_iterator it = std::upper_bound( mIndex.begin(), mIndex.end(), Offset,
+                []( unsigned long long value, const sZipChunkIndex &chunk ) { return value < chunk.UncompressedOffset; } );
+
+            if( it == mIndex.begin() || Offset >= mSize )
+            {
+                return -1;
+            }
+            return (int) ( it - mIndex.begin() ) - 1;
+        }
+
+        //== Decompress one chunk into caller memory of at least Chunk( Index ).UncompressedSize
+        //== bytes.  Thread safe, chunks can be decompressed in parallel ==--
+
+        bool DecompressChunk( int Index, unsigned char *Buffer ) const
+        {
+            if( Index < 0 || Index >= (int) mIndex.size() )
+            {
+                return false;
+            }
+
+            const sZipChunkIndex &chunk = mIndex[ Index ];
+            const sZipChunkHeader *header = (const sZipChunkHeader*) ( mFile.Data() + chunk.FileOffset );
+
+            uLongf size = chunk.UncompressedSize;
+            if( header->Magic == kZipChunkStoredMagic )
+            {
+                if( chunk.CompressedSize != chunk.UncompressedSize )
+                {
+                    return false;
+                }
+                memcpy( Buffer, header + 1, size );
+            }
+            else if( header->Magic != kZipChunkMagic
+                || uncompress( Buffer, &size, (const Bytef*) ( header + 1 ), chunk.CompressedSize ) != Z_OK
+                || size != chunk.UncompressedSize )
+            {
+                return false;
+            }
+
+            return adler32( adler32( 0, Z_NULL, 0 ), Buffer, (uInt) size ) == header->Checksum;
+        }
+
+        //== Read uncompressed bytes from any offset, returns the number of bytes read ==--
+
+        size_t Read( unsigned long long Offset, unsigned char *Buffer, size_t Size )
+        {
+            size_t total = 0;
+            int    index = FindChunk( Offset );
+
+            while( total < Size && index >= 0 && index < (int) mIndex.size() )
+            {
+                if( index != mCached )
+                {
+                    mCache.resize( mIndex[ index ].UncompressedSize );
+                    if( mCache.empty() || !DecompressChunk( index, &mCache[ 0 ] ) )
+                    {
+                        mCached = -1;
+                        break;
+                    }
+                    mCached = index;
+                }
+
+                const sZipChunkIndex &chunk = mIndex[ index ];
+                size_t start = (size_t) ( Offset - chunk.UncompressedOffset );
+                size_t count = std::min( Size - total, (size_t) chunk.UncompressedSize - start );
+
+                memcpy( Buffer + total, &mCache[ start ], count );
+                total  += count;
+                Offset += count;
+                index++;
+            }
+
+            return total;
+        }
+
+    private:
+        bool LoadIndex()
+        {
+            const unsigned long long size = mFile.Size();
+            if( size < sizeof( sZipStreamHeader ) + sizeof( sZipStreamTrailer ) )
+            {
+                return false;
+            }
+
+            sZipStreamTrailer trailer;
+            memcpy( &trailer, mFile.Data() + size - sizeof( trailer ), sizeof( trailer ) );
+
+            if( trailer.Magic != kZipStreamMagic || trailer.IndexOffset < sizeof( sZipStreamHeader )
+                || trailer.IndexOffset > size - sizeof( trailer )
+                || trailer.ChunkCount * sizeof( sZipChunkIndex ) != size - sizeof( trailer ) - trailer.IndexOffset )
+            {
+                return false;
+            }
+
+            mIndex.resize( (size_t) trailer.ChunkCount );
+            if( !mIndex.empty() )
+            {
+                memcpy( &mIndex[ 0 ], mFile.Data() + trailer.IndexOffset, mIndex.size() * sizeof( sZipChunkIndex ) );
+            }
+
+            for( size_t i = 0; i < mIndex.size(); i++ )
+            {
+                if( mIndex[ i ].FileOffset + sizeof( sZipChunkHeader ) + mIndex[ i ].CompressedSize > trailer.IndexOffset )
+                {
+                    mIndex.clear();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void RebuildIndex()
+        {
+            const unsigned long long size = mFile.Size();
+            unsigned long long offset = sizeof( sZipStreamHeader );
+            unsigned long long uncompressed = 0;
+
+            mIndex.clear();
+
+            while( offset + sizeof( sZipChunkHeader ) <= size )
+            {
+                sZipChunkHeader header;
+                memcpy( &header, mFile.Data() + offset, sizeof( header ) );
+
+                if( ( header.Magic != kZipChunkMagic && header.Magic != kZipChunkStoredMagic ) || header.UncompressedOffset != uncompressed
+                    || header.CompressedSize > size - offset - sizeof( header ) )
+                {
+                    break;
+                }
+
+                sZipChunkIndex entry;
+                entry.FileOffset         = offset;
+                entry.UncompressedOffset = header.UncompressedOffset;
+                entry.CompressedSize     = header.CompressedSize;
+                entry.UncompressedSize   = header.UncompressedSize;
+                mIndex.push_back( entry );
+
+                offset       += sizeof( header ) + header.CompressedSize;
+                uncompressed += header.UncompressedSize;
+            }
+        }
+
+        Core::cMemoryMappedFile           mFile;
+        sZipStreamHeader                  mHeader;
+        std::vector<sZipChunkIndex>       mIndex;
+        unsigned long long                mSize;
+
+        std::vector<unsigned char>        mCache;
+        int                               mCached;
+    };
+}
+
+#endif
+
+#endif